@@ -18,8 +18,53 @@ index="fingerprint"
 lucene="$index"
 url="https://$es_user:$es_password@$es_host:$es_port/$lucene"
 
-if curl -k -u "$es_user:$es_password" -X GET "https://$es_host:$es_port/_cat/indices?v" | grep -q "$index"; then
+id_scheme="song_id:hash"
+
+# documents written before ids were derived from song_id and hash have random ids and default routing,
+# they are copied out under their new ids, cleared and copied back once, run it while the service is stopped
+# a migration index left behind holds a complete copy, a rerun carries on from it instead of copying again
+migrate_ids() {
+  local staging="https://$es_user:$es_password@$es_host:$es_port/${index}_migration"
+  local to_staging="{\"source\": {\"index\": \"$index\"}, \"dest\": {\"index\": \"${index}_migration\"}, \"script\": {\"lang\": \"painless\", \"source\": \"ctx._id = ctx._source.song_id + ':' + ctx._source.hash; ctx._routing = String.valueOf(ctx._source.song_id)\"}}"
+  local from_staging="{\"source\": {\"index\": \"${index}_migration\"}, \"dest\": {\"index\": \"$index\"}}"
+
+  if ! curl -k -u "$es_user:$es_password" -X GET "https://$es_host:$es_port/_cat/indices?v" | grep -q " ${index}_migration "; then
+    if ! curl -k -u "$es_user:$es_password" -H "Content-Type: application/json" -X PUT -d "{\"settings\" : {\"number_of_shards\" : $shard_count, \"number_of_replicas\" : 0}, \"mappings\": $mapping_query}" "$staging" | grep -q "acknowledged"; then
+      echo "Failed to create the migration index"
+      exit 1
+    fi
+    # rows written twice get the same id, the copy keeps one of them
+    if ! curl -k -u "$es_user:$es_password" -H "Content-Type: application/json" -X POST -d "$to_staging" "https://$es_host:$es_port/_reindex?refresh=true" | grep -q "\"failures\":\[\]"; then
+      echo "Failed to copy documents to the migration index"
+      curl -k -u "$es_user:$es_password" -X DELETE "$staging" > /dev/null
+      exit 1
+    fi
+  fi
+  if ! curl -k -u "$es_user:$es_password" -H "Content-Type: application/json" -X POST -d "{\"query\": {\"match_all\": {}}}" "$url/_delete_by_query?conflicts=proceed&refresh=true" | grep -q "\"failures\":\[\]"; then
+    echo "Failed to clear documents with random ids, the migration index is kept"
+    exit 1
+  fi
+  # the routing of every copy is carried back with it
+  if ! curl -k -u "$es_user:$es_password" -H "Content-Type: application/json" -X POST -d "$from_staging" "https://$es_host:$es_port/_reindex?refresh=true" | grep -q "\"failures\":\[\]"; then
+    echo "Failed to copy documents back, the migration index is kept"
+    exit 1
+  fi
+  curl -k -u "$es_user:$es_password" -X DELETE "$staging" > /dev/null
+
+  if ! curl -k -u "$es_user:$es_password" -H "Content-Type: application/json" -X PUT -d "{\"_meta\": {\"id_scheme\": \"$id_scheme\"}}" "$url/_mapping" | grep -q "acknowledged"; then
+    echo "Failed to record the id scheme"
+    exit 1
+  fi
+  echo "Document ids migrated successfully"
+}
+
+mapping_query="{\"_meta\": {\"id_scheme\": \"$id_scheme\"}, \"properties\": {\"hash\":{\"type\": \"keyword\"},\"timestamp\": {\"type\": \"unsigned_long\"},\"song_id\":{\"type\": \"unsigned_long\"}}}"
+
+if curl -k -u "$es_user:$es_password" -X GET "https://$es_host:$es_port/_cat/indices?v" | grep -q " $index "; then
   echo "Index exists"
+  if ! curl -k -u "$es_user:$es_password" -X GET "$url/_mapping" | grep -q "\"id_scheme\":\"$id_scheme\""; then
+    migrate_ids
+  fi
   exit 0
 fi
 
@@ -32,8 +77,6 @@ else
   exit 1
 fi
 
-mapping_query="{\"properties\": {\"hash\":{\"type\": \"keyword\"},\"timestamp\": {\"type\": \"unsigned_long\"},\"song_id\":{\"type\": \"unsigned_long\"}}}"
-
 if curl -k -u "$es_user:$es_password" -H "Content-Type: application/json" -X PUT -d "$mapping_query" "$url/_mapping" | grep -q "acknowledged"; then
   echo "Mapping created successfully"
 fi
@@ -11,6 +11,8 @@ db_name=${POSTGRES_DB_NAME}
 pg_host=${POSTGRES_HOST}
 table_name="fingerprint"
 index_name="fp_index"
+registry_name="song_registry"
+manifest_name="song_manifest"
 
 test_db_sql="SELECT 1 FROM pg_database WHERE datname = '${db_name}'"
 create_db_sql="CREATE DATABASE ${db_name}"
@@ -30,18 +32,33 @@ CREATE_TABLE_SQL="CREATE TABLE IF NOT EXISTS ${table_name} (
 
 CREATE_INDEX_SQL="CREATE UNIQUE INDEX IF NOT EXISTS ${index_name} ON ${table_name} USING btree(hash, song_id) WITH (fillfactor=100);"
 
-CREATE_FUNCTION_SQL='CREATE OR REPLACE FUNCTION find_song_id(incoming_song_id INTEGER) RETURNS BOOLEAN AS $$
-                     DECLARE
-                       exists BOOLEAN;
-                          BEGIN
-                             LOCK TABLE fingerprint IN ROW EXCLUSIVE MODE;
-                             SELECT EXISTS (SELECT 1 from fingerprint WHERE song_id = incoming_song_id) INTO exists;
-                     IF NOT exists THEN
-                             INSERT INTO fingerprint(hash, song_id, timestamp) VALUES (-1, incoming_song_id, -1);
-                     END IF;
-                            RETURN exists;
-                          END;
-                          $$
-                     LANGUAGE plpgsql;'
-
-PGPASSWORD="${POSTGRES_PASSWORD}" psql -d "host=$pg_host port=${POSTGRES_PORT} dbname=${db_name} user=${POSTGRES_USER}" -c "${CREATE_TABLE_SQL}" -c "${CREATE_INDEX_SQL}" -c "${CREATE_FUNCTION_SQL}"
+# state: 0 claimed, 1 loading, 2 ready, 3 deleting
+CREATE_REGISTRY_SQL="CREATE TABLE IF NOT EXISTS ${registry_name} (
+                     song_id            BIGINT PRIMARY KEY,
+                     state              SMALLINT NOT NULL,
+                     updated_at         TIMESTAMPTZ NOT NULL DEFAULT now()
+                     );"
+
+# songs loaded before the registry existed are registered once, claims used to be sentinel rows in the fingerprint table
+MIGRATE_REGISTRY_SQL="INSERT INTO ${registry_name}(song_id, state)
+                      SELECT DISTINCT song_id, 2 FROM ${table_name}
+                      WHERE NOT (hash = -1 AND timestamp = -1) AND NOT EXISTS (SELECT 1 FROM ${registry_name})
+                      ON CONFLICT (song_id) DO NOTHING;"
+DROP_SENTINELS_SQL="DELETE FROM ${table_name} WHERE hash = -1 AND timestamp = -1;"
+# the hashes of every song, clustered by song so that song-keyed reads and deletes go through fp_index instead of scanning
+CREATE_MANIFEST_SQL="CREATE TABLE IF NOT EXISTS ${manifest_name} (
+                     song_id            BIGINT,
+                     hash               NUMERIC(20),
+                     PRIMARY KEY (song_id, hash)
+                     );"
+
+MIGRATE_MANIFEST_SQL="INSERT INTO ${manifest_name}(song_id, hash)
+                      SELECT song_id, hash FROM ${table_name}
+                      WHERE NOT EXISTS (SELECT 1 FROM ${manifest_name})
+                      ON CONFLICT DO NOTHING;"
+
+DROP_FUNCTION_SQL="DROP FUNCTION IF EXISTS find_song_id(INTEGER);"
+
+PGPASSWORD="${POSTGRES_PASSWORD}" psql -d "host=$pg_host port=${POSTGRES_PORT} dbname=${db_name} user=${POSTGRES_USER}" -c "${CREATE_TABLE_SQL}" -c "${CREATE_INDEX_SQL}" \
+  -c "${CREATE_REGISTRY_SQL}" -c "${MIGRATE_REGISTRY_SQL}" -c "${DROP_SENTINELS_SQL}" -c "${DROP_FUNCTION_SQL}" \
+  -c "${CREATE_MANIFEST_SQL}" -c "${MIGRATE_MANIFEST_SQL}"
@@ -0,0 +1,144 @@
+#include "admission_controller.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../common/common.h"
+
+namespace siren::cloud
+{
+    // the short average reacts within a few dozen calls, the long one remembers the last few hundred
+    static constexpr double ShortLatencyWeight = 0.1;
+    static constexpr double LongLatencyWeight = 0.005;
+    static constexpr double LatencyTolerance = 1.5;
+    static constexpr double MinGradient = 0.5;
+
+    static AdmissionPolicy loadPolicy()
+    {
+        AdmissionPolicy policy;
+
+        std::string initialLimitStr = siren::getenv("ADMISSION_INITIAL_LIMIT");
+        if (!initialLimitStr.empty())
+        {
+            policy.initialLimit = std::stoul(initialLimitStr);
+        }
+
+        std::string minLimitStr = siren::getenv("ADMISSION_MIN_LIMIT");
+        if (!minLimitStr.empty())
+        {
+            policy.minLimit = std::stoul(minLimitStr);
+        }
+
+        std::string maxLimitStr = siren::getenv("ADMISSION_MAX_LIMIT");
+        if (!maxLimitStr.empty())
+        {
+            policy.maxLimit = std::stoul(maxLimitStr);
+        }
+
+        auto budgets = splitList(siren::getenv("ADMISSION_QUEUE_BUDGET_MS"));
+        for (size_t i = 0; i < PriorityLevelCount && i < budgets.size(); i++)
+        {
+            policy.queueBudget[i] = std::chrono::milliseconds(std::stoul(budgets[i]));
+        }
+
+        std::string fallbackShareStr = siren::getenv("ADMISSION_FALLBACK_SHARE");
+        if (!fallbackShareStr.empty())
+        {
+            policy.fallbackShare = std::stod(fallbackShareStr);
+        }
+        return policy;
+    }
+
+    AdmissionController::AdmissionController(const AdmissionPolicy& policy)
+        : m_policy(policy)
+    {
+        m_policy.minLimit = std::max<size_t>(m_policy.minLimit, 1);
+        m_policy.maxLimit = std::max(m_policy.maxLimit, m_policy.minLimit);
+        m_limit = std::clamp(m_policy.initialLimit, m_policy.minLimit, m_policy.maxLimit);
+    }
+
+    AdmissionController& AdmissionController::instance()
+    {
+        static AdmissionController controller(loadPolicy());
+        return controller;
+    }
+
+    bool AdmissionController::tryAcquire(TaskPriority priority, const CancellationToken& cancellation, std::chrono::steady_clock::time_point receivedAt)
+    {
+        // a call that has queued past its budget is likely to miss its deadline anyway, it is better refused early
+        bool isStale = receivedAt != std::chrono::steady_clock::time_point{}
+                       && std::chrono::steady_clock::now() - receivedAt > m_policy.queueBudget[toLevel(priority)];
+
+        std::lock_guard lock(m_mtx);
+        if (isStale || cancellation.isCancelled() || m_inFlightCount >= static_cast<size_t>(m_limit))
+        {
+            m_rejectedCount++;
+            return false;
+        }
+        m_inFlightCount++;
+        return true;
+    }
+
+    void AdmissionController::release(TaskPriority priority, std::chrono::nanoseconds latency)
+    {
+        std::lock_guard lock(m_mtx);
+        m_inFlightCount--;
+        // background work is slow by nature and would read as congestion
+        if (priority == TaskPriority::Interactive)
+        {
+            updateLimit(std::max<double>(latency.count(), 1));
+        }
+    }
+
+    void AdmissionController::updateLimit(double latency)
+    {
+        if (m_longLatency == 0)
+        {
+            m_shortLatency = latency;
+            m_longLatency = latency;
+            return;
+        }
+        m_shortLatency += (latency - m_shortLatency) * ShortLatencyWeight;
+        m_longLatency += (latency - m_longLatency) * LongLatencyWeight;
+
+        // after a sustained shift the long average lags far behind, let it catch up so the limit can recover
+        if (m_longLatency / m_shortLatency > 2)
+        {
+            m_longLatency *= 0.95;
+        }
+
+        // a half idle limit says nothing about how much more the backends could take
+        if (m_inFlightCount < m_limit / 2)
+        {
+            return;
+        }
+
+        double gradient = std::clamp(LatencyTolerance * m_longLatency / m_shortLatency, MinGradient, 1.0);
+        double newLimit = m_limit * gradient + std::sqrt(m_limit);
+        newLimit = m_limit * (1 - m_policy.smoothing) + newLimit * m_policy.smoothing;
+        m_limit = std::clamp(newLimit, static_cast<double>(m_policy.minLimit), static_cast<double>(m_policy.maxLimit));
+    }
+
+    bool AdmissionController::isSheddingFallbacks() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_inFlightCount >= m_limit * m_policy.fallbackShare;
+    }
+
+    size_t AdmissionController::getLimit() const
+    {
+        std::lock_guard lock(m_mtx);
+        return static_cast<size_t>(m_limit);
+    }
+
+    size_t AdmissionController::getInFlightCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_inFlightCount;
+    }
+
+    size_t AdmissionController::getRejectedCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_rejectedCount;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <mutex>
+#include "../thread_pool/primitives/cancellation.h"
+#include "../thread_pool/primitives/priority.h"
+
+namespace siren::cloud
+{
+    struct AdmissionPolicy
+    {
+        size_t initialLimit{64};
+        size_t minLimit{8};
+        size_t maxLimit{512};
+
+        // how long a call of each level may have been queued since it was received before it is refused
+        std::array<std::chrono::milliseconds, PriorityLevelCount> queueBudget{
+            std::chrono::milliseconds{10}, std::chrono::milliseconds{200}, std::chrono::milliseconds{50}};
+
+        // once this share of the limit is in flight, lookups that missed the cache stop falling back to primary storage
+        double fallbackShare{0.75};
+
+        // weight of a freshly computed limit against the current one
+        double smoothing{0.2};
+    };
+
+    /*
+     * Bounds the number of calls in flight with a limit that follows observed latency.
+     * Interactive calls feed a short and a long latency average, a short average growing past the long one
+     * means requests have started to queue somewhere downstream and the limit is cut proportionally,
+     * otherwise it grows by roughly its square root.
+     */
+    class AdmissionController
+    {
+    public:
+        explicit AdmissionController(const AdmissionPolicy& policy = {});
+
+        AdmissionController(const AdmissionController& other) = delete;
+        AdmissionController& operator=(const AdmissionController& other) = delete;
+
+        // configured from the environment
+        static AdmissionController& instance();
+
+        // never waits, a call is refused once the limit is reached, its token is cancelled or it was received longer ago than its budget allows,
+        // without receivedAt it counts as received just now
+        bool tryAcquire(TaskPriority priority, const CancellationToken& cancellation = {}, std::chrono::steady_clock::time_point receivedAt = {});
+
+        // latency is the time the call spent being served, excluding the wait for admission
+        void release(TaskPriority priority, std::chrono::nanoseconds latency);
+
+        bool isSheddingFallbacks() const;
+
+        size_t getLimit() const;
+        size_t getInFlightCount() const;
+        size_t getRejectedCount() const;
+
+    private:
+        void updateLimit(double latency);
+
+    private:
+        AdmissionPolicy m_policy;
+        mutable std::mutex m_mtx;
+        double m_limit;
+        size_t m_inFlightCount{0};
+        size_t m_rejectedCount{0};
+        double m_shortLatency{0};
+        double m_longLatency{0};
+    };
+}
@@ -1,7 +1,9 @@
 #pragma once
 #include "find_track.h"
 #include "load_track.h"
+#include "load_job_status.h"
 #include "delete_track.h"
+#include "bulk_load_mode.h"
 #include "../grpc/server.h"
 
 namespace siren::cloud
@@ -9,7 +11,9 @@ namespace siren::cloud
     using ServerImpl = SirenServer<
                                 SirenFingerprint,
                                 LoadTrackByUrlCallData,
+                                GetLoadJobStatusCallData,
                                 FindTrackByFingerprintCallData,
-                                DeleteTrackByIdCallData
+                                DeleteTrackByIdCallData,
+                                SetBulkLoadModeCallData
                                 >;
 }
\ No newline at end of file
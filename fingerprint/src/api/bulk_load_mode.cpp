@@ -0,0 +1,54 @@
+#include "bulk_load_mode.h"
+
+namespace siren::cloud
+{
+    SetBulkLoadModeCallData::SetBulkLoadModeCallData(EnginePtr& engine, SirenFingerprint::AsyncService* service, const CompletionQueuePtr& completionQueue, WeakCollectorPtr collection)
+        : CallData(engine, service, completionQueue, collection)
+    {
+        this->proceed();
+    }
+
+    void SetBulkLoadModeCallData::addNext()
+    {
+        if (auto sharedCollector = m_collector.lock())
+        {
+            sharedCollector->createNewCallData<SetBulkLoadModeCallData>(m_engine, m_service, m_completionQueue);
+        }
+        else
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "sharedCollectorPtr has expired");
+        }
+    }
+
+    void SetBulkLoadModeCallData::waitForRequest()
+    {
+        m_service->RequestSetBulkLoadMode(&m_serverContext, &m_request, &m_responder, m_completionQueue.get(), m_completionQueue.get(), this);
+    }
+
+    TaskPriority SetBulkLoadModeCallData::getPriority() const
+    {
+        // leaving rebuilds fp_index, which holds its thread far longer than anything serving lookups
+        return TaskPriority::Maintenance;
+    }
+
+    coro::Task<void> SetBulkLoadModeCallData::handleRequest()
+    {
+        auto& req = getRequest();
+        auto& reply = getReply();
+
+        std::stringstream msg;
+        msg << (req.enabled() ? "Entering" : "Leaving") << " bulk load mode";
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+
+        BulkLoadReport report;
+        reply.set_success(m_engine->setBulkLoadMode(req.enabled(), report));
+        reply.set_enabled(m_engine->isBulkLoading());
+        reply.set_primary_row_count(report.primaryRowCount);
+        reply.set_manifest_row_count(report.manifestRowCount);
+        reply.set_cache_row_count(report.cacheRowCount);
+        reply.set_expected_cache_row_count(report.expectedCacheRowCount);
+        reply.set_consistent(report.isConsistent);
+        reply.set_error(report.error);
+        co_return;
+    }
+}
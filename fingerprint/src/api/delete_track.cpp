@@ -1,9 +1,34 @@
 #include "delete_track.h"
-#include "../thread_pool/async_manager.h"
 #include "../common/request_manager.h"
 
 namespace siren::cloud
 {
+    namespace detail
+    {
+        // arguments are taken by value, the call data is recycled long before the purge completes
+        static coro::Task<void> purgeTrack(Engine* engine, SongIdType songId, std::string metadataAddr, bool useSsl)
+        {
+            if (!co_await engine->purgeFingerprintBySongIdAsync(songId))
+            {
+                std::stringstream err;
+                err << "Failed to delete fingerprint by song id " << songId;
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, err.str());
+                co_return;
+            }
+
+            std::string url = metadataAddr + "/api/records/do_delete/" + std::to_string(songId);
+            HttpResponse metadataRes = RequestManager::Delete(url, {}, "Content-Type: application/json", {}, useSsl);
+
+            if (metadataRes.status_code != 204)
+            {
+                std::stringstream err;
+                err << "Failed to delete song metadata for song with id " << songId << ", Metadata returned code "
+                    << metadataRes.status_code << " with error " << metadataRes.error.message;
+                Logger::log(LogLevel::FATAL, __FILE__, __FUNCTION__, __LINE__, err.str());
+            }
+        }
+    }// namespace detail
+
     DeleteTrackByIdCallData::DeleteTrackByIdCallData(EnginePtr& engine, SirenFingerprint::AsyncService* service, const CompletionQueuePtr& completionQueue, WeakCollectorPtr collection)
         : CallData(engine, service, completionQueue, collection)
     {
@@ -27,7 +52,12 @@ namespace siren::cloud
         m_service->RequestDeleteTrackById(&m_serverContext, &m_request, &m_responder, m_completionQueue.get(), m_completionQueue.get(), this);
     }
 
-    void DeleteTrackByIdCallData::handleRequest()
+    TaskPriority DeleteTrackByIdCallData::getPriority() const
+    {
+        return TaskPriority::Maintenance;
+    }
+
+    coro::Task<void> DeleteTrackByIdCallData::handleRequest()
     {
         auto& req = getRequest();
         auto& reply = getReply();
@@ -39,28 +69,9 @@ namespace siren::cloud
         msg << "Deleting fingerprint of song with id " << req.song_id();
         Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
 
-        SongIdType songId = req.song_id();
-        AsyncManager::instance().submitTask([this, songId, useSsl] {
-            if (!m_engine->purgeFingerprintBySongId(songId))
-            {
-                std::stringstream err;
-                err << "Failed to delete fingerprint by song id " << songId;
-                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, err.str());
-                return;
-            }
-
-            std::string url = m_metadataAddr + "/api/records/do_delete/" + std::to_string(songId);
-            HttpResponse metadataRes = RequestManager::Delete(url, {}, "Content-Type: application/json", {}, useSsl);
-
-            if (metadataRes.status_code != 204)
-            {
-                std::stringstream err;
-                err << "Failed to delete song metadata for song with id " << songId << ", Metadata returned code "
-                    << metadataRes.status_code << " with error " << metadataRes.error.message;
-                Logger::log(LogLevel::FATAL, __FILE__, __FUNCTION__, __LINE__, err.str());
-            }
-        });
+        m_engine->spawn(detail::purgeTrack(m_engine.get(), req.song_id(), m_metadataAddr, useSsl));
 
         reply.set_success(true);
+        co_return;
     }
 }
\ No newline at end of file
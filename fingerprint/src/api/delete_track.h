@@ -18,6 +18,7 @@ namespace siren::cloud
     private:
         void addNext() override;
         void waitForRequest() override;
-        void handleRequest() override;
+        coro::Task<void> handleRequest() override;
+        TaskPriority getPriority() const override;
     };
 }
\ No newline at end of file
@@ -71,7 +71,12 @@ namespace siren::cloud
         m_service->RequestFindTrackByFingerprint(&m_serverContext, &m_request, &m_responder, m_completionQueue.get(), m_completionQueue.get(), this);
     }
 
-    void FindTrackByFingerprintCallData::handleRequest()
+    TaskPriority FindTrackByFingerprintCallData::getPriority() const
+    {
+        return TaskPriority::Interactive;
+    }
+
+    coro::Task<void> FindTrackByFingerprintCallData::handleRequest()
     {
         auto& req = getRequest();
         auto& reply = getReply();
@@ -82,25 +87,38 @@ namespace siren::cloud
         std::string useSslStr = siren::getenv("USE_SSL");
         bool useSsl = !useSslStr.empty() ? std::stoi(useSslStr) : 1;
 
-        bool isSuccess = false;
-        auto engineRes = m_engine->findSongIdByFingerprint(isSuccess, std::move(fingerprint));
+        FindResult findResult = co_await m_engine->findSongIdByFingerprintAsync(std::move(fingerprint), m_cancellation);
+        if (m_cancellation.isCancelled())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Client has gone away or the deadline has passed, dropping the request");
+            co_return;
+        }
+        if (findResult.isShed)
+        {
+            m_replyStatus = Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is overloaded");
+            co_return;
+        }
+
+        const HistReturnType& engineRes = findResult.hist;
         if (engineRes.getStatus() != HistStatus::OK)
         {
             auto error = reply.add_errors();
             error->set_message(R"({"errors":{"detail":"Not Found"}})");
             Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "Could not find a song by provided fingerprint");
-            return;
+            co_return;
         }
 
         std::string url = m_metadataAddr + "/api/records/" + std::to_string(engineRes.getSongId());
-        HttpResponse metadataRes = RequestManager::Get(url, {}, "Content-Type: application/json", {}, useSsl);
+        HttpRequest metadataReq = RequestManager::MakeRequest("GET", url, {}, "Content-Type: application/json", {}, useSsl);
+        metadataReq.cancellation = m_cancellation;
+        HttpResponse metadataRes = co_await RequestManager::SendAsync(std::move(metadataReq), getPriority());
 
         if (metadataRes.status_code != 200)
         {
             auto error = reply.add_errors();
             error->set_message(R"({"errors":{"detail":"Internal server error"}})");
             Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to obtain song metadata");
-            return;
+            co_return;
         }
 
         Json metadataJson = Json::parse(metadataRes.text)["data"];
@@ -109,7 +127,7 @@ namespace siren::cloud
             auto error = reply.add_errors();
             error->set_message(R"({"errors":{"detail":"Internal server error"}})");
             Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Metadata serv returned an invalid json response");
-            return;
+            co_return;
         }
 
         reply.set_name(metadataJson["name"]);
@@ -0,0 +1,69 @@
+#include "load_job_status.h"
+
+namespace siren::cloud
+{
+    static fingerprint::LoadJobState toProto(JobState state)
+    {
+        switch (state)
+        {
+            case JobState::Queued:
+                return fingerprint::LOAD_JOB_STATE_QUEUED;
+            case JobState::Downloading:
+                return fingerprint::LOAD_JOB_STATE_DOWNLOADING;
+            case JobState::Fingerprinting:
+                return fingerprint::LOAD_JOB_STATE_FINGERPRINTING;
+            case JobState::Storing:
+                return fingerprint::LOAD_JOB_STATE_STORING;
+            case JobState::Done:
+                return fingerprint::LOAD_JOB_STATE_DONE;
+            case JobState::Failed:
+                return fingerprint::LOAD_JOB_STATE_FAILED;
+        }
+        return fingerprint::LOAD_JOB_STATE_UNSPECIFIED;
+    }
+
+    GetLoadJobStatusCallData::GetLoadJobStatusCallData(EnginePtr& engine, SirenFingerprint::AsyncService* service, const CompletionQueuePtr& completionQueue, WeakCollectorPtr collection)
+        : CallData(engine, service, completionQueue, collection)
+    {
+        this->proceed();
+    }
+
+    void GetLoadJobStatusCallData::addNext()
+    {
+        if (auto sharedCollector = m_collector.lock())
+        {
+            sharedCollector->createNewCallData<GetLoadJobStatusCallData>(m_engine, m_service, m_completionQueue);
+        }
+        else
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "sharedCollectorPtr has expired");
+        }
+    }
+
+    void GetLoadJobStatusCallData::waitForRequest()
+    {
+        m_service->RequestGetLoadJobStatus(&m_serverContext, &m_request, &m_responder, m_completionQueue.get(), m_completionQueue.get(), this);
+    }
+
+    TaskPriority GetLoadJobStatusCallData::getPriority() const
+    {
+        // cheap to answer, but must not pull the latency that sizes the limit for recognitions down
+        return TaskPriority::Background;
+    }
+
+    coro::Task<void> GetLoadJobStatusCallData::handleRequest()
+    {
+        auto& req = getRequest();
+        auto& reply = getReply();
+
+        std::optional<JobStatus> status = m_engine->getLoadStatus(req.job_id());
+        if (!status)
+        {
+            m_replyStatus = Status(grpc::StatusCode::NOT_FOUND, "Load job is unknown or finished too long ago");
+            co_return;
+        }
+        reply.set_state(toProto(status->state));
+        reply.set_song_id(status->songId);
+        reply.set_error(status->error);
+    }
+}
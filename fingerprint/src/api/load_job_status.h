@@ -0,0 +1,23 @@
+#pragma once
+#include "../grpc/collector.h"
+#include "../grpc/server.h"
+#include "fingerprint.grpc.pb.h"
+
+namespace siren::cloud
+{
+    using fingerprint::SirenFingerprint;
+    using fingerprint::GetLoadJobStatusRequest;
+    using fingerprint::GetLoadJobStatusResponse;
+
+    class GetLoadJobStatusCallData: public CallData<SirenFingerprint, GetLoadJobStatusRequest, GetLoadJobStatusResponse, WeakCollectorPtr>
+    {
+    public:
+        GetLoadJobStatusCallData(EnginePtr& engine, SirenFingerprint::AsyncService* service, const CompletionQueuePtr& completionQueue, WeakCollectorPtr collection);
+
+    private:
+        void addNext() override;
+        void waitForRequest() override;
+        coro::Task<void> handleRequest() override;
+        TaskPriority getPriority() const override;
+    };
+}
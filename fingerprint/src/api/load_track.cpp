@@ -25,15 +25,30 @@ namespace siren::cloud
         m_service->RequestLoadTrackByUrl(&m_serverContext, &m_request, &m_responder, m_completionQueue.get(), m_completionQueue.get(), this);
     }
 
-    void LoadTrackByUrlCallData::handleRequest()
+    TaskPriority LoadTrackByUrlCallData::getPriority() const
+    {
+        return TaskPriority::Background;
+    }
+
+    coro::Task<void> LoadTrackByUrlCallData::handleRequest()
     {
         auto& req = getRequest();
         auto& reply = getReply();
 
+        // the load runs as a job, the call only waits for the song to be claimed and queued
+        JobIdType jobId = 0;
+        LoadSubmission submission = m_engine->submitLoad(jobId, req.url(), req.song_id(), req.is_caching());
+        if (submission == LoadSubmission::Overloaded)
+        {
+            m_replyStatus = Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Ingestion queue is full");
+            co_return;
+        }
+
         std::stringstream msg;
-        msg << "Loading song with id " << req.song_id();
-        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+        msg << "Queued load job " << jobId << " for song with id " << req.song_id();
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, submission == LoadSubmission::Accepted ? msg.str() : "Refused to load song");
 
-        reply.set_success(m_engine->loadTrackByUrl(req.url(), req.song_id(), req.is_caching()));
+        reply.set_success(submission == LoadSubmission::Accepted);
+        reply.set_job_id(jobId);
     }
 }
\ No newline at end of file
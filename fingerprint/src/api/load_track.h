@@ -7,9 +7,9 @@ namespace siren::cloud
 {
     using fingerprint::SirenFingerprint;
     using fingerprint::LoadTrackByUrlRequest;
-    using fingerprint::BasicIsSuccessResponse;
+    using fingerprint::LoadTrackByUrlResponse;
 
-    class LoadTrackByUrlCallData: public CallData<SirenFingerprint, LoadTrackByUrlRequest, BasicIsSuccessResponse, WeakCollectorPtr>
+    class LoadTrackByUrlCallData: public CallData<SirenFingerprint, LoadTrackByUrlRequest, LoadTrackByUrlResponse, WeakCollectorPtr>
     {
     public:
         LoadTrackByUrlCallData(EnginePtr& engine, SirenFingerprint::AsyncService* service, const CompletionQueuePtr& completionQueue, WeakCollectorPtr collection);
@@ -17,6 +17,7 @@ namespace siren::cloud
     private:
         void addNext() override;
         void waitForRequest() override;
-        void handleRequest() override;
+        coro::Task<void> handleRequest() override;
+        TaskPriority getPriority() const override;
     };
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "common.h"
+#include <sstream>
 
 namespace siren::cloud
 {
@@ -15,4 +16,24 @@ namespace siren::cloud
         }
         return false;
     }
+
+    uint64_t mixBits(uint64_t value)
+    {
+        value += 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    std::vector<std::string> splitList(const std::string& str)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(str);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            items.push_back(item);
+        }
+        return items;
+    }
 }
\ No newline at end of file
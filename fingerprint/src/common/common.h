@@ -15,4 +15,10 @@ namespace siren::cloud
     using Json              =  nlohmann::json;
 
     bool generateUniqueFilePath(std::string path, std::string& res);
+
+    // splitmix64 finalizer, spreads every input bit over the whole result
+    uint64_t mixBits(uint64_t value);
+
+    // comma separated lists in environment variables
+    std::vector<std::string> splitList(const std::string& str);
 }
\ No newline at end of file
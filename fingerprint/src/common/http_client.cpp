@@ -0,0 +1,521 @@
+#include "http_client.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstring>
+#include "../logger/logger.h"
+#include "common.h"
+
+namespace siren::cloud
+{
+    struct HttpTransfer
+    {
+        HttpTransfer(HttpRequest&& request, HttpClient::Callback&& onComplete)
+            : request(std::move(request))
+            , onComplete(std::move(onComplete))
+        {
+        }
+
+        ~HttpTransfer()
+        {
+            if (headers)
+            {
+                curl_slist_free_all(headers);
+            }
+            if (easy)
+            {
+                curl_easy_cleanup(easy);
+            }
+        }
+
+        void complete()
+        {
+            if (onComplete)
+            {
+                onComplete(std::move(response));
+                onComplete = nullptr;
+            }
+        }
+
+        void fail(CURLcode code, const std::string& message)
+        {
+            response.status_code = 0;
+            response.error = cpr::Error(code, std::string(message));
+            complete();
+        }
+
+        HttpRequest request;
+        HttpClient::Callback onComplete;
+        HttpResponse response;
+        CURL* easy{nullptr};
+        curl_slist* headers{nullptr};
+        char errorBuffer[CURL_ERROR_SIZE]{};
+    };
+
+    static size_t onWrite(char* data, size_t size, size_t count, void* userp)
+    {
+        auto transfer = static_cast<HttpTransfer*>(userp);
+        size_t length = size * count;
+        if (transfer->request.onData)
+        {
+            // the body belongs to the last response whose headers arrived, redirects are not passed on
+            long statusCode = 0;
+            curl_easy_getinfo(transfer->easy, CURLINFO_RESPONSE_CODE, &statusCode);
+            // returning a short count makes libcurl abort with CURLE_WRITE_ERROR
+            return transfer->request.onData(statusCode, std::string_view(data, length)) ? length : 0;
+        }
+        transfer->response.text.append(data, length);
+        return length;
+    }
+
+    static size_t onHeader(char* data, size_t size, size_t count, void* userp)
+    {
+        auto transfer = static_cast<HttpTransfer*>(userp);
+        size_t length = size * count;
+        std::string_view line(data, length);
+        transfer->response.raw_header.append(line);
+
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+        {
+            line.remove_suffix(1);
+        }
+        if (line.substr(0, 5) == "HTTP/")
+        {
+            // a new status line starts the headers of the next response after a redirect or a 100-continue
+            transfer->response.header.clear();
+            transfer->response.status_line = std::string(line);
+            size_t codeEnd = line.find(' ', line.find(' ') + 1);
+            transfer->response.reason = codeEnd != std::string_view::npos ? std::string(line.substr(codeEnd + 1)) : std::string{};
+            return length;
+        }
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos)
+        {
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ')
+            {
+                value.remove_prefix(1);
+            }
+            transfer->response.header[std::string(line.substr(0, colon))] = std::string(value);
+        }
+        return length;
+    }
+
+    static bool prepareTransfer(HttpTransfer& transfer)
+    {
+        CURL* easy = curl_easy_init();
+        if (!easy)
+        {
+            return false;
+        }
+        transfer.easy = easy;
+        const HttpRequest& request = transfer.request;
+
+        curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, &transfer);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, transfer.errorBuffer);
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, onWrite);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer);
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, onHeader);
+        curl_easy_setopt(easy, CURLOPT_HEADERDATA, &transfer);
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, request.isVerifying ? 1L : 0L);
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, request.isVerifying ? 2L : 0L);
+        // same redirect behaviour as cpr sessions
+        curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(easy, CURLOPT_MAXREDIRS, 50L);
+
+        if (!request.body.empty())
+        {
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request.body.data());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body.size()));
+        }
+        if (request.method == "GET" && request.body.empty())
+        {
+            curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+        }
+        else if (request.method != "POST" || request.body.empty())
+        {
+            // also covers GET with a body, which ES search endpoints rely on
+            curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+        }
+
+        if (!request.auth.user.empty() || !request.auth.password.empty())
+        {
+            curl_easy_setopt(easy, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+            curl_easy_setopt(easy, CURLOPT_USERNAME, request.auth.user.c_str());
+            curl_easy_setopt(easy, CURLOPT_PASSWORD, request.auth.password.c_str());
+        }
+        for (const auto& header: request.headers)
+        {
+            transfer.headers = curl_slist_append(transfer.headers, header.c_str());
+        }
+        if (transfer.headers)
+        {
+            curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer.headers);
+        }
+        if (request.connectTimeout.count() > 0)
+        {
+            curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(request.connectTimeout.count()));
+        }
+        std::chrono::milliseconds timeout = request.timeout;
+        if (request.cancellation.hasDeadline())
+        {
+            auto remaining = std::max(request.cancellation.getRemaining(timeout), std::chrono::milliseconds{1});
+            timeout = timeout.count() > 0 ? std::min(timeout, remaining) : remaining;
+        }
+        if (timeout.count() > 0)
+        {
+            curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+        }
+        return true;
+    }
+
+    static void finalizeResponse(HttpTransfer& transfer, CURLcode result)
+    {
+        HttpResponse& response = transfer.response;
+
+        long statusCode = 0;
+        curl_easy_getinfo(transfer.easy, CURLINFO_RESPONSE_CODE, &statusCode);
+        double elapsed = 0;
+        curl_easy_getinfo(transfer.easy, CURLINFO_TOTAL_TIME, &elapsed);
+        char* effectiveUrl = nullptr;
+        curl_easy_getinfo(transfer.easy, CURLINFO_EFFECTIVE_URL, &effectiveUrl);
+
+        response.elapsed = elapsed;
+        response.url = cpr::Url{effectiveUrl ? effectiveUrl : transfer.request.url};
+        if (result != CURLE_OK)
+        {
+            std::string message = transfer.errorBuffer[0] != '\0' ? transfer.errorBuffer : curl_easy_strerror(result);
+            response.error = cpr::Error(result, std::move(message));
+            response.status_code = 0;
+            return;
+        }
+        response.status_code = statusCode;
+    }
+
+    HttpReactor::HttpReactor(size_t maxConnections)
+    {
+        m_multi = curl_multi_init();
+        m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (!m_multi || m_epollFd < 0 || m_wakeFd < 0)
+        {
+            Logger::log(LogLevel::FATAL, __FILE__, __FUNCTION__, __LINE__, "Failed to initialize HttpReactor");
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = m_wakeFd;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+        curl_multi_setopt(m_multi, CURLMOPT_SOCKETFUNCTION, onSocket);
+        curl_multi_setopt(m_multi, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(m_multi, CURLMOPT_TIMERFUNCTION, onTimer);
+        curl_multi_setopt(m_multi, CURLMOPT_TIMERDATA, this);
+        if (maxConnections != 0)
+        {
+            // transfers beyond the limit wait inside libcurl for a free connection
+            curl_multi_setopt(m_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(maxConnections));
+        }
+
+        m_thread = std::thread([this] { run(); });
+    }
+
+    HttpReactor::~HttpReactor()
+    {
+        m_isStopping = true;
+        wake();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        abortAll();
+        curl_multi_cleanup(m_multi);
+        close(m_wakeFd);
+        close(m_epollFd);
+    }
+
+    void HttpReactor::submit(std::unique_ptr<HttpTransfer>&& transfer)
+    {
+        if (m_isStopping)
+        {
+            transfer->fail(CURLE_ABORTED_BY_CALLBACK, "HttpReactor is shutting down");
+            return;
+        }
+        if (transfer->request.cancellation.isCancelled())
+        {
+            transfer->fail(CURLE_ABORTED_BY_CALLBACK, "Request was cancelled before it was sent");
+            return;
+        }
+        if (!prepareTransfer(*transfer))
+        {
+            transfer->fail(CURLE_FAILED_INIT, "Failed to create a curl handle");
+            return;
+        }
+        m_inFlightCount++;
+        {
+            std::lock_guard lock(m_pendingMtx);
+            m_pending.emplace_back(std::move(transfer));
+        }
+        wake();
+    }
+
+    size_t HttpReactor::getInFlightCount() const
+    {
+        return m_inFlightCount;
+    }
+
+    void HttpReactor::wake()
+    {
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(m_wakeFd, &one, sizeof(one));
+    }
+
+    int HttpReactor::onSocket([[maybe_unused]] CURL* easy, curl_socket_t socket, int action, void* userp, [[maybe_unused]] void* socketp)
+    {
+        auto reactor = static_cast<HttpReactor*>(userp);
+        if (action == CURL_POLL_REMOVE)
+        {
+            // the socket may already be closed, in which case epoll has dropped it on its own
+            epoll_ctl(reactor->m_epollFd, EPOLL_CTL_DEL, socket, nullptr);
+            return 0;
+        }
+
+        epoll_event event{};
+        event.data.fd = socket;
+        if (action == CURL_POLL_IN || action == CURL_POLL_INOUT)
+        {
+            event.events |= EPOLLIN;
+        }
+        if (action == CURL_POLL_OUT || action == CURL_POLL_INOUT)
+        {
+            event.events |= EPOLLOUT;
+        }
+        if (epoll_ctl(reactor->m_epollFd, EPOLL_CTL_MOD, socket, &event) != 0 && errno == ENOENT)
+        {
+            epoll_ctl(reactor->m_epollFd, EPOLL_CTL_ADD, socket, &event);
+        }
+        return 0;
+    }
+
+    int HttpReactor::onTimer([[maybe_unused]] CURLM* multi, long timeoutMs, void* userp)
+    {
+        auto reactor = static_cast<HttpReactor*>(userp);
+        reactor->m_hasDeadline = timeoutMs >= 0;
+        reactor->m_deadline = Clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0L));
+        return 0;
+    }
+
+    void HttpReactor::run()
+    {
+        static constexpr int MaxEvents = 64;
+        epoll_event events[MaxEvents];
+        int runningCount = 0;
+
+        while (!m_isStopping)
+        {
+            int timeout = -1;
+            if (m_hasDeadline)
+            {
+                auto remaining = std::chrono::ceil<std::chrono::milliseconds>(m_deadline - Clock::now());
+                timeout = static_cast<int>(std::max<int64_t>(remaining.count(), 0));
+            }
+            if (m_cancellableCount > 0)
+            {
+                timeout = timeout < 0 ? CancellationPollMs : std::min(timeout, CancellationPollMs);
+            }
+
+            int count = epoll_wait(m_epollFd, events, MaxEvents, timeout);
+            if (count < 0)
+            {
+                if (errno != EINTR)
+                {
+                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, std::string("epoll_wait failed: ") + std::strerror(errno));
+                }
+                continue;
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                int fd = events[i].data.fd;
+                if (fd == m_wakeFd)
+                {
+                    uint64_t value;
+                    [[maybe_unused]] auto bytesRead = read(m_wakeFd, &value, sizeof(value));
+                    drainPending();
+                    continue;
+                }
+                int flags = 0;
+                if (events[i].events & EPOLLIN)
+                {
+                    flags |= CURL_CSELECT_IN;
+                }
+                if (events[i].events & EPOLLOUT)
+                {
+                    flags |= CURL_CSELECT_OUT;
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    flags |= CURL_CSELECT_ERR;
+                }
+                curl_multi_socket_action(m_multi, fd, flags, &runningCount);
+            }
+
+            // the deadline is absolute, so busy sockets cannot postpone libcurl's timeouts
+            if (m_hasDeadline && Clock::now() >= m_deadline)
+            {
+                m_hasDeadline = false;
+                curl_multi_socket_action(m_multi, CURL_SOCKET_TIMEOUT, 0, &runningCount);
+            }
+            completeFinished();
+            abortCancelled();
+        }
+    }
+
+    void HttpReactor::drainPending()
+    {
+        std::vector<std::unique_ptr<HttpTransfer>> pending;
+        {
+            std::lock_guard lock(m_pendingMtx);
+            pending.swap(m_pending);
+        }
+        for (auto& transfer: pending)
+        {
+            CURL* easy = transfer->easy;
+            CURLMcode code = curl_multi_add_handle(m_multi, easy);
+            if (code != CURLM_OK)
+            {
+                m_inFlightCount--;
+                transfer->fail(CURLE_FAILED_INIT, curl_multi_strerror(code));
+                continue;
+            }
+            if (transfer->request.cancellation.isCancellable())
+            {
+                m_cancellableCount++;
+            }
+            m_active.emplace(easy, std::move(transfer));
+        }
+    }
+
+    void HttpReactor::completeFinished()
+    {
+        int queued = 0;
+        while (CURLMsg* message = curl_multi_info_read(m_multi, &queued))
+        {
+            if (message->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+            CURL* easy = message->easy_handle;
+            CURLcode result = message->data.result;
+            curl_multi_remove_handle(m_multi, easy);
+
+            auto it = m_active.find(easy);
+            if (it == m_active.end())
+            {
+                continue;
+            }
+            std::unique_ptr<HttpTransfer> transfer = std::move(it->second);
+            m_active.erase(it);
+            if (transfer->request.cancellation.isCancellable())
+            {
+                m_cancellableCount--;
+            }
+
+            finalizeResponse(*transfer, result);
+            m_inFlightCount--;
+            transfer->complete();
+        }
+    }
+
+    void HttpReactor::abortCancelled()
+    {
+        if (m_cancellableCount == 0)
+        {
+            return;
+        }
+        for (auto it = m_active.begin(); it != m_active.end();)
+        {
+            HttpTransfer& transfer = *it->second;
+            if (!transfer.request.cancellation.isCancelled())
+            {
+                it++;
+                continue;
+            }
+            std::unique_ptr<HttpTransfer> cancelled = std::move(it->second);
+            it = m_active.erase(it);
+            curl_multi_remove_handle(m_multi, cancelled->easy);
+            m_cancellableCount--;
+            m_inFlightCount--;
+            cancelled->fail(CURLE_ABORTED_BY_CALLBACK, "Request was cancelled");
+        }
+    }
+
+    void HttpReactor::abortAll()
+    {
+        drainPending();
+        for (auto& [easy, transfer]: m_active)
+        {
+            curl_multi_remove_handle(m_multi, easy);
+            m_inFlightCount--;
+            transfer->fail(CURLE_ABORTED_BY_CALLBACK, "HttpReactor is shutting down");
+        }
+        m_active.clear();
+    }
+
+    HttpClient::HttpClient(size_t reactorCount, size_t maxConnections)
+    {
+        static std::once_flag curlInitFlag;
+        std::call_once(curlInitFlag, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+        reactorCount = std::max<size_t>(reactorCount, 1);
+        size_t connectionsPerReactor = maxConnections != 0 ? std::max<size_t>(maxConnections / reactorCount, 1) : 0;
+        for (size_t i = 0; i < reactorCount; i++)
+        {
+            m_reactors.emplace_back(std::make_unique<HttpReactor>(connectionsPerReactor));
+        }
+    }
+
+    HttpClient::~HttpClient() = default;
+
+    HttpClient& HttpClient::instance()
+    {
+        static HttpClient client = [] {
+            std::string reactorCountStr = siren::getenv("HTTP_REACTOR_THREADS");
+            size_t reactorCount = !reactorCountStr.empty() ? std::stoul(reactorCountStr) : 1;
+
+            std::string maxConnectionsStr = siren::getenv("HTTP_MAX_CONNECTIONS");
+            size_t maxConnections = !maxConnectionsStr.empty() ? std::stoul(maxConnectionsStr) : 64;
+
+            return HttpClient(reactorCount, maxConnections);
+        }();
+        return client;
+    }
+
+    void HttpClient::send(HttpRequest&& request, Callback&& onComplete)
+    {
+        size_t index = m_next.fetch_add(1, std::memory_order_relaxed) % m_reactors.size();
+        m_reactors[index]->submit(std::make_unique<HttpTransfer>(std::move(request), std::move(onComplete)));
+    }
+
+    std::future<HttpResponse> HttpClient::send(HttpRequest&& request)
+    {
+        auto promise = std::make_shared<std::promise<HttpResponse>>();
+        auto future = promise->get_future();
+        send(std::move(request), [promise](HttpResponse&& response) {
+            promise->set_value(std::move(response));
+        });
+        return future;
+    }
+
+    size_t HttpClient::getInFlightCount() const
+    {
+        size_t count = 0;
+        for (const auto& reactor: m_reactors)
+        {
+            count += reactor->getInFlightCount();
+        }
+        return count;
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cpr/cpr.h>
+#include <curl/curl.h>
+#include "../thread_pool/primitives/cancellation.h"
+
+namespace siren::cloud
+{
+    using HttpResponse = cpr::Response;
+
+    struct Auth
+    {
+        std::string user{};
+        std::string password{};
+    };
+
+    struct HttpRequest
+    {
+        std::string method{"GET"};
+        std::string url;
+        std::string body;
+
+        // full header lines, e.g. "Content-Type: application/json"
+        std::vector<std::string> headers;
+        Auth auth;
+        bool isVerifying{true};
+
+        // 0 leaves the libcurl default in place
+        std::chrono::milliseconds connectTimeout{0};
+        std::chrono::milliseconds timeout{0};
+
+        // when set, the body is streamed here along with its status instead of being buffered into HttpResponse::text,
+        // returning false aborts the transfer
+        std::function<bool(long statusCode, std::string_view chunk)> onData;
+
+        // the transfer is aborted once the token is cancelled, its deadline caps timeout
+        CancellationToken cancellation;
+    };
+
+    struct HttpTransfer;
+
+    /*
+     * Single thread driving a curl multi handle through epoll.
+     * Completion callbacks run on the reactor thread and must stay cheap.
+     */
+    class HttpReactor
+    {
+    public:
+        explicit HttpReactor(size_t maxConnections);
+        ~HttpReactor();
+
+        HttpReactor(const HttpReactor& other) = delete;
+        HttpReactor(HttpReactor&& other) = delete;
+        HttpReactor& operator=(const HttpReactor& other) = delete;
+        HttpReactor& operator=(HttpReactor&& other) = delete;
+
+        void submit(std::unique_ptr<HttpTransfer>&& transfer);
+        size_t getInFlightCount() const;
+
+    private:
+        void run();
+        void wake();
+        void drainPending();
+        void completeFinished();
+        void abortCancelled();
+        void abortAll();
+
+        static int onSocket(CURL* easy, curl_socket_t socket, int action, void* userp, void* socketp);
+        static int onTimer(CURLM* multi, long timeoutMs, void* userp);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // how often in-flight transfers are checked for cancellation, expired deadlines are left to libcurl's own timeout
+        static constexpr int CancellationPollMs = 20;
+
+        CURLM* m_multi{nullptr};
+        int m_epollFd{-1};
+        int m_wakeFd{-1};
+        bool m_hasDeadline{false};
+        Clock::time_point m_deadline;
+        std::unordered_map<CURL*, std::unique_ptr<HttpTransfer>> m_active;
+        size_t m_cancellableCount{0};
+        std::vector<std::unique_ptr<HttpTransfer>> m_pending;
+        std::mutex m_pendingMtx;
+        std::atomic<bool> m_isStopping{false};
+        std::atomic<size_t> m_inFlightCount{0};
+        std::thread m_thread;
+    };
+
+    class HttpClient
+    {
+    public:
+        using Callback = std::function<void(HttpResponse&&)>;
+
+        HttpClient(size_t reactorCount, size_t maxConnections);
+        ~HttpClient();
+
+        HttpClient(const HttpClient& other) = delete;
+        HttpClient(HttpClient&& other) = delete;
+        HttpClient& operator=(const HttpClient& other) = delete;
+        HttpClient& operator=(HttpClient&& other) = delete;
+
+        static HttpClient& instance();
+
+        void send(HttpRequest&& request, Callback&& onComplete);
+        std::future<HttpResponse> send(HttpRequest&& request);
+
+        // co_await client.request(...) resumes on a reactor thread, hop back onto the pool before doing real work
+        auto request(HttpRequest&& request)
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<> handle)
+                {
+                    client->send(std::move(request), [this, handle](HttpResponse&& result) {
+                        response = std::move(result);
+                        handle.resume();
+                    });
+                }
+
+                HttpResponse await_resume()
+                {
+                    return std::move(response);
+                }
+
+                HttpClient* client;
+                HttpRequest request;
+                HttpResponse response;
+            };
+            return Awaiter{this, std::move(request), {}};
+        }
+
+        size_t getInFlightCount() const;
+
+    private:
+        std::vector<std::unique_ptr<HttpReactor>> m_reactors;
+        std::atomic<size_t> m_next{0};
+    };
+}
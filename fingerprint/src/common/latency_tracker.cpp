@@ -0,0 +1,48 @@
+#include "latency_tracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace siren::cloud
+{
+    LatencyTracker::LatencyTracker(size_t capacity, size_t minSampleCount)
+        : m_capacity(std::max<size_t>(capacity, 1))
+        , m_minSampleCount(std::min(minSampleCount, m_capacity))
+    {
+        m_samples.reserve(m_capacity);
+    }
+
+    void LatencyTracker::record(std::chrono::nanoseconds latency)
+    {
+        std::lock_guard lock(m_mtx);
+        if (m_samples.size() < m_capacity)
+        {
+            m_samples.push_back(latency);
+            return;
+        }
+        m_samples[m_next] = latency;
+        m_next = (m_next + 1) % m_capacity;
+    }
+
+    std::chrono::milliseconds LatencyTracker::getPercentile(double percentile, std::chrono::milliseconds fallback) const
+    {
+        std::vector<std::chrono::nanoseconds> samples;
+        {
+            std::lock_guard lock(m_mtx);
+            if (m_samples.empty() || m_samples.size() < m_minSampleCount)
+            {
+                return fallback;
+            }
+            samples = m_samples;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(std::clamp(percentile, 0.0, 1.0) * samples.size()));
+        auto nth = samples.begin() + std::clamp<size_t>(rank, 1, samples.size()) - 1;
+        std::nth_element(samples.begin(), nth, samples.end());
+        return std::chrono::ceil<std::chrono::milliseconds>(*nth);
+    }
+
+    size_t LatencyTracker::getSampleCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_samples.size();
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace siren::cloud
+{
+    /*
+     * Keeps the most recent latency samples in a ring buffer and answers percentile queries over them,
+     * so the estimate follows the current behaviour of a backend rather than its whole history.
+     */
+    class LatencyTracker
+    {
+    public:
+        explicit LatencyTracker(size_t capacity = 512, size_t minSampleCount = 32);
+
+        void record(std::chrono::nanoseconds latency);
+
+        // fallback until enough samples have been recorded for the percentile to mean anything
+        std::chrono::milliseconds getPercentile(double percentile, std::chrono::milliseconds fallback) const;
+
+        size_t getSampleCount() const;
+
+    private:
+        mutable std::mutex m_mtx;
+        std::vector<std::chrono::nanoseconds> m_samples;
+        size_t m_next{0};
+        size_t m_capacity;
+        size_t m_minSampleCount;
+    };
+}
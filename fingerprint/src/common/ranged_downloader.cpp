@@ -0,0 +1,319 @@
+#include "ranged_downloader.h"
+#include "common.h"
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+
+namespace siren::cloud
+{
+    using Clock = std::chrono::steady_clock;
+
+    // how often a running download is checked against its deadline and throughput floor
+    static constexpr std::chrono::milliseconds ProgressCheckInterval{50};
+    static constexpr size_t UnboundedEnd = std::numeric_limits<size_t>::max();
+
+    namespace
+    {
+        // [begin, end) still to be fetched
+        struct ByteRange
+        {
+            size_t begin;
+            size_t end;
+            size_t attempts{0};
+            bool isProbe{false};
+        };
+
+        struct Completion
+        {
+            ByteRange range;
+            size_t written;
+            HttpResponse response;
+        };
+
+        struct DownloadState
+        {
+            std::mutex mtx;
+            std::condition_variable cv;
+            std::deque<Completion> completions;
+            std::atomic<size_t> receivedCount{0};
+            CancellationToken cancellation;
+        };
+    }
+
+    static std::optional<std::string> findHeader(const HttpResponse& response, std::string_view name)
+    {
+        for (const auto& [key, value]: response.header)
+        {
+            if (key.size() == name.size() && std::equal(key.begin(), key.end(), name.begin(), [](char a, char b) { return std::tolower(a) == std::tolower(b); }))
+            {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // "bytes 0-1023/4096" -> 4096, nullopt when the size is unknown
+    static std::optional<size_t> parseTotalSize(const HttpResponse& response)
+    {
+        std::optional<std::string> contentRange = findHeader(response, "Content-Range");
+        if (!contentRange)
+        {
+            return std::nullopt;
+        }
+        size_t slash = contentRange->rfind('/');
+        if (slash == std::string::npos || slash + 1 >= contentRange->size() || (*contentRange)[slash + 1] == '*')
+        {
+            return std::nullopt;
+        }
+        try
+        {
+            return std::stoull(contentRange->substr(slash + 1));
+        }
+        catch (const std::exception&)
+        {
+            return std::nullopt;
+        }
+    }
+
+    // status of the last response whose headers arrived, also known when the transfer broke off in the body
+    static long getHeaderStatus(const HttpResponse& response)
+    {
+        size_t statusLine = response.raw_header.rfind("HTTP/");
+        if (statusLine == std::string::npos)
+        {
+            return 0;
+        }
+        size_t space = response.raw_header.find(' ', statusLine);
+        if (space == std::string::npos)
+        {
+            return 0;
+        }
+        return std::strtol(response.raw_header.c_str() + space + 1, nullptr, 10);
+    }
+
+    static HttpResponse makeFailure(const std::string& message)
+    {
+        HttpResponse response;
+        response.status_code = 0;
+        response.error = cpr::Error(CURLE_OPERATION_TIMEDOUT, std::string(message));
+        return response;
+    }
+
+    DownloadPolicy::DownloadPolicy()
+    {
+        std::string parallelismStr = siren::getenv("DOWNLOAD_PARALLELISM");
+        if (!parallelismStr.empty())
+        {
+            parallelism = std::max<size_t>(std::stoul(parallelismStr), 1);
+        }
+
+        std::string rangeSizeStr = siren::getenv("DOWNLOAD_RANGE_SIZE");
+        if (!rangeSizeStr.empty())
+        {
+            rangeSize = std::max<size_t>(std::stoul(rangeSizeStr), 1);
+        }
+
+        std::string maxRetriesStr = siren::getenv("DOWNLOAD_MAX_RETRIES");
+        if (!maxRetriesStr.empty())
+        {
+            maxRetries = std::stoul(maxRetriesStr);
+        }
+
+        std::string deadlineStr = siren::getenv("DOWNLOAD_DEADLINE_MS");
+        if (!deadlineStr.empty())
+        {
+            deadline = std::chrono::milliseconds(std::stoul(deadlineStr));
+        }
+
+        std::string minThroughputStr = siren::getenv("DOWNLOAD_MIN_THROUGHPUT");
+        if (!minThroughputStr.empty())
+        {
+            minThroughput = std::stoul(minThroughputStr);
+        }
+
+        std::string throughputGraceStr = siren::getenv("DOWNLOAD_THROUGHPUT_GRACE_MS");
+        if (!throughputGraceStr.empty())
+        {
+            throughputGrace = std::chrono::milliseconds(std::stoul(throughputGraceStr));
+        }
+
+        std::string connectTimeoutStr = siren::getenv("THIRDPARTY_API_TIMEOUT_MS");
+        if (!connectTimeoutStr.empty())
+        {
+            connectTimeout = std::chrono::milliseconds(std::stoul(connectTimeoutStr));
+        }
+
+        std::string useSslStr = siren::getenv("USE_SSL");
+        if (!useSslStr.empty())
+        {
+            isVerifying = std::stoi(useSslStr);
+        }
+    }
+
+    RangedDownloader::RangedDownloader(const DownloadPolicy& policy)
+        : m_policy(policy)
+    {
+    }
+
+    HttpResponse RangedDownloader::download(const std::string& url, const DownloadSink& sink) const
+    {
+        auto state = std::make_shared<DownloadState>();
+        auto start = Clock::now();
+        state->cancellation = CancellationToken::create(start + m_policy.deadline);
+
+        auto launch = [&](ByteRange range) {
+            HttpRequest request;
+            request.url = url;
+            request.isVerifying = m_policy.isVerifying;
+            request.connectTimeout = m_policy.connectTimeout;
+            request.cancellation = state->cancellation;
+            std::stringstream header;
+            header << "Range: bytes=" << range.begin << '-' << range.end - 1;
+            request.headers.push_back(header.str());
+
+            // the probe may be answered with the whole body, any other range must not spill into its neighbours
+            size_t end = range.isProbe ? UnboundedEnd : range.end;
+            auto written = std::make_shared<size_t>(0);
+            request.onData = [state, &sink, begin = range.begin, end, written, isProbe = range.isProbe](long statusCode, std::string_view chunk) {
+                // only a 206, or a 200 to the probe, carries the bytes that were asked for
+                if (statusCode != 206 && !(isProbe && statusCode == 200))
+                {
+                    // an error page is dropped so its status still comes back, the whole file sent for a range is cut off
+                    return statusCode >= 400;
+                }
+                size_t offset = begin + *written;
+                bool isOverrun = chunk.size() > end - offset;
+                if (isOverrun)
+                {
+                    chunk = chunk.substr(0, end - offset);
+                }
+                if (!chunk.empty() && !sink.write(offset, chunk))
+                {
+                    return false;
+                }
+                *written += chunk.size();
+                state->receivedCount += chunk.size();
+                return !isOverrun;
+            };
+
+            HttpClient::instance().send(std::move(request), [state, range, written](HttpResponse&& response) {
+                {
+                    std::lock_guard lock(state->mtx);
+                    state->completions.push_back(Completion{range, *written, std::move(response)});
+                }
+                state->cv.notify_one();
+            });
+        };
+
+        std::deque<ByteRange> pending;
+        size_t inFlightCount = 0;
+        std::optional<HttpResponse> result;
+
+        launch(ByteRange{0, m_policy.rangeSize, 0, true});
+        inFlightCount++;
+
+        while (inFlightCount > 0)
+        {
+            std::deque<Completion> completions;
+            {
+                std::unique_lock lock(state->mtx);
+                state->cv.wait_for(lock, ProgressCheckInterval, [&state] { return !state->completions.empty(); });
+                completions.swap(state->completions);
+            }
+
+            for (auto& [range, written, response]: completions)
+            {
+                inFlightCount--;
+                if (result)
+                {
+                    continue;
+                }
+
+                if (range.isProbe && response.status_code == 200)
+                {
+                    // no range support, the probe has brought the whole body
+                    result = std::move(response);
+                    continue;
+                }
+
+                // a broken off 206 is resumed, anything else the server sent is not part of the file
+                long status = response.status_code != 0 ? response.status_code : getHeaderStatus(response);
+                bool isPartial = status == 206;
+                if (!range.isProbe && status >= 200 && status < 300 && !isPartial)
+                {
+                    // the range was ignored once the file turned out to be ranged, asking again will not help
+                    result = makeFailure("A range was answered with status " + std::to_string(status));
+                    continue;
+                }
+                if (range.isProbe && isPartial)
+                {
+                    std::optional<size_t> totalSize = parseTotalSize(response);
+                    if (!totalSize || !sink.reserve(*totalSize))
+                    {
+                        result = makeFailure("Could not tell the size of the file from its first range");
+                        continue;
+                    }
+                    range.isProbe = false;
+                    range.end = std::min(range.end, *totalSize);
+                    for (size_t begin = range.end; begin < *totalSize; begin += m_policy.rangeSize)
+                    {
+                        pending.push_back(ByteRange{begin, std::min(begin + m_policy.rangeSize, *totalSize)});
+                    }
+                }
+
+                if (isPartial)
+                {
+                    range.begin += written;
+                }
+                if (range.begin >= range.end)
+                {
+                    continue;
+                }
+                // a client error will not go away by asking again
+                bool isClientError = response.status_code >= 400 && response.status_code < 500;
+                if (isClientError || ++range.attempts > m_policy.maxRetries)
+                {
+                    // only an error status is handed back as is, a range that never came is not a successful download
+                    result = response.status_code >= 400 ? std::move(response)
+                                                          : makeFailure("A range could not be fetched: " + (response.error.message.empty() ? "status " + std::to_string(status) : response.error.message));
+                    continue;
+                }
+                pending.push_front(range);
+            }
+
+            if (!result && state->cancellation.isCancelled())
+            {
+                result = makeFailure("The download ran past its deadline");
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+            if (!result && m_policy.minThroughput > 0 && elapsed > m_policy.throughputGrace
+                && state->receivedCount * 1000 < m_policy.minThroughput * static_cast<size_t>(elapsed.count()))
+            {
+                result = makeFailure("The download fell below the throughput floor");
+            }
+            if (result)
+            {
+                // transfers still running write into the sink, they are drained before it goes away
+                state->cancellation.cancel();
+                pending.clear();
+                continue;
+            }
+
+            while (inFlightCount < m_policy.parallelism && !pending.empty())
+            {
+                launch(pending.front());
+                pending.pop_front();
+                inFlightCount++;
+            }
+        }
+
+        if (!result)
+        {
+            result = HttpResponse();
+            result->status_code = 200;
+        }
+        return std::move(*result);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include "http_client.h"
+
+namespace siren::cloud
+{
+    // where a download lands, written from reactor threads
+    struct DownloadSink
+    {
+        // called with the full size once the server has told it, before any range past the first is written
+        std::function<bool(size_t)> reserve;
+        // called for disjoint offsets from several transfers at once
+        std::function<bool(size_t, std::string_view)> write;
+    };
+
+    struct DownloadPolicy
+    {
+        DownloadPolicy();
+
+        // ranges fetched at once
+        size_t parallelism{4};
+        size_t rangeSize{8 * 1024 * 1024};
+        // attempts a range gets after its first one, each resuming where the last stopped
+        size_t maxRetries{3};
+        // for the whole download, ranges and retries included
+        std::chrono::milliseconds deadline{600000};
+        // bytes per second below which the download is given up, 0 turns the floor off
+        size_t minThroughput{64 * 1024};
+        // the floor is only checked once the download has run this long
+        std::chrono::milliseconds throughputGrace{10000};
+        std::chrono::milliseconds connectTimeout{30000};
+        bool isVerifying{true};
+    };
+
+    /*
+     * Fetches a file as byte ranges over several connections at once.
+     * The first range doubles as the probe, a 206 reply tells the size and that ranges are served,
+     * a server without range support answers it with the whole body, which is then all there is to fetch.
+     */
+    class RangedDownloader
+    {
+    public:
+        explicit RangedDownloader(const DownloadPolicy& policy = {});
+
+        // blocks until the body is in the sink or the download has failed, status 200 means the sink holds all of it
+        HttpResponse download(const std::string& url, const DownloadSink& sink) const;
+
+    private:
+        DownloadPolicy m_policy;
+    };
+}
@@ -1,42 +1,50 @@
 #include "request_manager.h"
+#include "../thread_pool/async_manager.h"
 
 namespace siren::cloud
 {
 
+    HttpRequest RequestManager::MakeRequest(const std::string& method, const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying)
+    {
+        HttpRequest request;
+        request.method = method;
+        request.url = url;
+        request.body = std::string(body);
+        request.headers.emplace_back("Content-Type: " + contentType);
+        request.auth = auth;
+        request.isVerifying = isVerifying;
+        return request;
+    }
+
     HttpResponse RequestManager::Get(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying)
     {
-        return cpr::Get(cpr::Url{url}, cpr::VerifySsl(isVerifying),
-                        cpr::Body{body}, cpr::Authentication{auth.user, auth.password, cpr::AuthMode::BASIC},
-                        cpr::Header{{"Content-Type", contentType}});
+        return HttpClient::instance().send(MakeRequest("GET", url, body, contentType, auth, isVerifying)).get();
     }
 
     HttpResponse RequestManager::Post(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying)
     {
-        return cpr::Post(cpr::Url{url}, cpr::VerifySsl(isVerifying),
-                         cpr::Body{body}, cpr::Authentication{auth.user, auth.password, cpr::AuthMode::BASIC},
-                         cpr::Header{{"Content-Type", contentType}});
+        return HttpClient::instance().send(MakeRequest("POST", url, body, contentType, auth, isVerifying)).get();
     }
 
     HttpResponse RequestManager::Put(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying)
     {
-        return cpr::Put(cpr::Url{url}, cpr::VerifySsl(isVerifying),
-                        cpr::Body{body}, cpr::Authentication{auth.user, auth.password, cpr::AuthMode::BASIC},
-                        cpr::Header{{"Content-Type", contentType}});
+        return HttpClient::instance().send(MakeRequest("PUT", url, body, contentType, auth, isVerifying)).get();
     }
 
     HttpResponse RequestManager::Delete(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying)
     {
-       return cpr::Delete(cpr::Url{url}, cpr::VerifySsl(isVerifying),
-                           cpr::Body{body}, cpr::Authentication{auth.user, auth.password, cpr::AuthMode::BASIC},
-                           cpr::Header{{"Content-Type", contentType}});
+        return HttpClient::instance().send(MakeRequest("DELETE", url, body, contentType, auth, isVerifying)).get();
+    }
+
+    HttpResponse RequestManager::DownloadFile(const std::string& url, const DownloadSink& sink, const DownloadPolicy& policy)
+    {
+        return RangedDownloader(policy).download(url, sink);
     }
 
-    HttpResponse RequestManager::DownloadFile(const std::string& url, std::ofstream& ofstream, int timeout, bool isVerifying)
+    coro::Task<HttpResponse> RequestManager::SendAsync(HttpRequest request, TaskPriority priority)
     {
-       cpr::Session session;
-       session.SetConnectTimeout(timeout);
-       session.SetUrl(cpr::Url{url});
-       session.SetVerifySsl(isVerifying);
-       return session.Download(ofstream);
+        HttpResponse response = co_await HttpClient::instance().request(std::move(request));
+        co_await AsyncManager::instance().schedule(priority);
+        co_return response;
     }
-}
\ No newline at end of file
+}
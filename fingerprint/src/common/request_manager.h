@@ -1,17 +1,12 @@
 #pragma once
-#include <cpr/cpr.h>
-#include <fstream>
+#include <functional>
+#include "http_client.h"
+#include "ranged_downloader.h"
+#include "../thread_pool/coro/task.h"
+#include "../thread_pool/primitives/priority.h"
 
 namespace siren::cloud
 {
-    using HttpResponse = cpr::Response;
-
-    struct Auth
-    {
-        std::string user{};
-        std::string password{};
-    };
-
     class RequestManager
     {
     public:
@@ -24,9 +19,15 @@ namespace siren::cloud
         static HttpResponse Post(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying=true);
         static HttpResponse Put(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying=true);
         static HttpResponse Delete(const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying=true);
-        static HttpResponse DownloadFile(const std::string& url, std::ofstream& stream, int timeout, bool isVerifying=true);
+        // fetches the file in ranges over parallel connections when the server allows it, see RangedDownloader
+        static HttpResponse DownloadFile(const std::string& url, const DownloadSink& sink, const DownloadPolicy& policy={});
+
+        static HttpRequest MakeRequest(const std::string& method, const std::string& url, std::string_view body, const std::string& contentType, const Auth& auth, bool isVerifying=true);
+
+        // the request is multiplexed on the shared HttpClient, the coroutine is resumed on a pool thread with the given priority
+        static coro::Task<HttpResponse> SendAsync(HttpRequest request, TaskPriority priority=TaskPriority::Interactive);
 
     private:
         RequestManager() = default;
     };
-}
\ No newline at end of file
+}
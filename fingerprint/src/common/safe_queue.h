@@ -85,8 +85,8 @@ using SafeQueuePtr = std::shared_ptr<SafeQueue<T>>;
 
 struct QueueCompare
 {
-    template <typename T>
-    bool operator()(const SafeQueuePtr<T>& lhs, const SafeQueuePtr<T>& rhs) const
+    template <typename QueuePtr>
+    bool operator()(const QueuePtr& lhs, const QueuePtr& rhs) const
     {
         if (lhs->getCurrentSize() != rhs->getCurrentSize())
         {
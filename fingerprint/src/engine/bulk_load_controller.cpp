@@ -0,0 +1,245 @@
+#include "bulk_load_controller.h"
+#include "../logger/logger.h"
+
+namespace siren::cloud
+{
+    static constexpr const char* IndexName = "fp_index";
+    static constexpr const char* ManifestKeyName = "song_manifest_pkey";
+
+    BulkLoadPolicy::BulkLoadPolicy()
+    {
+        std::string indexMemoryStr = siren::getenv("BULK_LOAD_INDEX_MEMORY");
+        std::string storeBatchSizeStr = siren::getenv("BULK_LOAD_STORE_BATCH_SIZE");
+
+        if (!indexMemoryStr.empty())
+        {
+            indexMemory = indexMemoryStr;
+        }
+        if (!storeBatchSizeStr.empty())
+        {
+            storeBatchSize = std::max<size_t>(std::stoul(storeBatchSizeStr), 1);
+        }
+    }
+
+    BulkLoadController::BulkLoadController(DBConnectionPoolPtr primaryPool, DBConnectionPoolPtr cachePool, const BulkLoadPolicy& policy)
+        : m_primaryPool(std::move(primaryPool))
+        , m_cachePool(std::move(cachePool))
+        , m_policy(policy)
+    {
+    }
+
+    bool BulkLoadController::restore()
+    {
+        std::stringstream sql;
+        sql << "SELECT 1 AS present FROM pg_indexes WHERE indexname = '" << IndexName << "'";
+
+        Query query;
+        query.emplace("query", sql.str());
+
+        DBConnectionPtr connection = m_primaryPool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(query));
+        bool isSuccess = command->execute();
+        m_primaryPool->releaseConnection(std::move(connection));
+        if (!isSuccess)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to check whether a bulk load was left unfinished");
+            return false;
+        }
+        if (command->isEmpty())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "fp_index is missing, carrying on with an unfinished bulk load until it is left");
+            m_state = BulkLoadState::Loading;
+        }
+        return true;
+    }
+
+    bool BulkLoadController::enter()
+    {
+        std::lock_guard lock(m_mtx);
+        if (m_state == BulkLoadState::Loading)
+        {
+            return true;
+        }
+
+        if (!updateCacheSettings(R"({"index": {"refresh_interval": "-1", "number_of_replicas": 0}})"))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to suspend refreshes and replicas of the cache index");
+            return false;
+        }
+
+        // the manifest key is kept up row by row just like fp_index, both are rebuilt once the load is over
+        std::stringstream dropIndex, dropManifestKey;
+        dropIndex << "DROP INDEX IF EXISTS " << IndexName;
+        dropManifestKey << "ALTER TABLE song_manifest DROP CONSTRAINT IF EXISTS " << ManifestKeyName;
+        if (!executePrimary({dropIndex.str(), dropManifestKey.str()}))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to drop fp_index and the manifest key, staying out of bulk load mode");
+            restoreCacheSettings();
+            return false;
+        }
+
+        m_state = BulkLoadState::Loading;
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "Entered bulk load mode");
+        return true;
+    }
+
+    bool BulkLoadController::leave(BulkLoadReport& report)
+    {
+        std::lock_guard lock(m_mtx);
+
+        std::stringstream setMaintenanceMemory, setWorkMemory, createIndex, dropManifestKey, addManifestKey;
+        setMaintenanceMemory << "SET LOCAL maintenance_work_mem = '" << m_policy.indexMemory << "'";
+        setWorkMemory << "SET LOCAL work_mem = '" << m_policy.indexMemory << "'";
+        createIndex << "CREATE UNIQUE INDEX IF NOT EXISTS " << IndexName << " ON fingerprint USING btree(hash, song_id) WITH (fillfactor=100)";
+        // dropping it first makes adding it again safe when a load was restored with the key still in place
+        dropManifestKey << "ALTER TABLE song_manifest DROP CONSTRAINT IF EXISTS " << ManifestKeyName;
+        addManifestKey << "ALTER TABLE song_manifest ADD CONSTRAINT " << ManifestKeyName << " PRIMARY KEY (song_id, hash)";
+        // nothing stops a row from being written twice without the index, a replayed write does it on purpose
+        std::string dropDuplicates = "DELETE FROM fingerprint WHERE ctid IN (SELECT ctid FROM (SELECT ctid, row_number() OVER (PARTITION BY hash, song_id) AS copy "
+                                     "FROM fingerprint) copies WHERE copy > 1)";
+        std::string dropManifestDuplicates = "DELETE FROM song_manifest WHERE ctid IN (SELECT ctid FROM (SELECT ctid, row_number() OVER (PARTITION BY song_id, hash) AS copy "
+                                             "FROM song_manifest) copies WHERE copy > 1)";
+
+        // both indexes are built in one sorted pass instead of row by row
+        bool isIndexed = m_state == BulkLoadState::Serving
+                         || executePrimary({setMaintenanceMemory.str(), setWorkMemory.str(), dropDuplicates, createIndex.str(), dropManifestDuplicates,
+                                            dropManifestKey.str(), addManifestKey.str(), "ANALYZE fingerprint", "ANALYZE song_manifest"});
+
+        // the cache goes back to serving either way, it does not depend on the index
+        bool isRestored = restoreCacheSettings();
+        if (!isIndexed)
+        {
+            m_state = BulkLoadState::Failed;
+            report.error = "Failed to rebuild fp_index and the manifest key, primary storage stays unsearchable until bulk load mode is left again";
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, report.error);
+            return false;
+        }
+        m_state = BulkLoadState::Serving;
+
+        // documents written since the refreshes were suspended are only counted once they are searchable
+        Query refresh;
+        refresh.emplace("lucene", "fingerprint/_refresh");
+        refresh.emplace("query", "");
+        refresh.emplace("request_type", "POST");
+        DBConnectionPtr connection = m_cachePool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(refresh));
+        bool isRefreshed = command->execute();
+        m_cachePool->releaseConnection(std::move(connection));
+
+        bool isCounted = countPrimary(report) && isRefreshed && countCache(report);
+        report.isConsistent = isCounted && report.primaryRowCount == report.manifestRowCount
+                              && (report.expectedCacheRowCount == 0 || report.cacheRowCount == report.expectedCacheRowCount);
+
+        std::stringstream msg;
+        msg << "Left bulk load mode, primary holds " << report.primaryRowCount << " rows listed by " << report.manifestRowCount
+            << " manifest rows, cache holds " << report.cacheRowCount << " rows";
+        Logger::log(report.isConsistent ? LogLevel::INFO : LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, msg.str());
+        return isRestored && isCounted;
+    }
+
+    bool BulkLoadController::isActive() const
+    {
+        return m_state == BulkLoadState::Loading;
+    }
+
+    bool BulkLoadController::isIndexMissing() const
+    {
+        return m_state != BulkLoadState::Serving;
+    }
+
+    BulkLoadState BulkLoadController::getState() const
+    {
+        return m_state;
+    }
+
+    const BulkLoadPolicy& BulkLoadController::getPolicy() const
+    {
+        return m_policy;
+    }
+
+    bool BulkLoadController::executePrimary(const std::vector<std::string>& statements)
+    {
+        QueryCollection queryCollection;
+        queryCollection.reserve(statements.size());
+        for (const auto& statement: statements)
+        {
+            Query query;
+            query.emplace("query", statement);
+            queryCollection.insertQuery(std::move(query));
+        }
+
+        DBConnectionPtr connection = m_primaryPool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(queryCollection));
+        bool isSuccess = command->execute();
+        m_primaryPool->releaseConnection(std::move(connection));
+        return isSuccess;
+    }
+
+    bool BulkLoadController::restoreCacheSettings()
+    {
+        // the refresh interval goes back to the ES default, replicas to what the index was created with
+        std::string replicaCount = siren::getenv("REPLICA_COUNT");
+        std::stringstream settings;
+        settings << R"({"index": {"refresh_interval": null, "number_of_replicas": )" << (!replicaCount.empty() ? replicaCount : "1") << "}}";
+        if (!updateCacheSettings(settings.str()))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to restore refreshes and replicas of the cache index");
+            return false;
+        }
+        return true;
+    }
+
+    bool BulkLoadController::updateCacheSettings(const std::string& settings)
+    {
+        Query query;
+        query.emplace("lucene", "fingerprint/_settings");
+        query.emplace("query", settings);
+        query.emplace("request_type", "PUT");
+
+        DBConnectionPtr connection = m_cachePool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(query));
+        bool isSuccess = command->execute();
+        m_cachePool->releaseConnection(std::move(connection));
+        return isSuccess;
+    }
+
+    bool BulkLoadController::countPrimary(BulkLoadReport& report)
+    {
+        // one snapshot for both, rows and their manifest are written in the same transaction
+        Query query;
+        query.emplace("query", "SELECT (SELECT count(*) FROM fingerprint) AS row_count, (SELECT count(*) FROM song_manifest) AS manifest_count");
+
+        DBConnectionPtr connection = m_primaryPool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(query));
+        bool isSuccess = command->execute();
+        m_primaryPool->releaseConnection(std::move(connection));
+
+        isSuccess = isSuccess && command->fetchNext() && command->asUint64("row_count", report.primaryRowCount)
+                    && command->asUint64("manifest_count", report.manifestRowCount);
+        if (!isSuccess)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to count the rows of primary storage");
+        }
+        return isSuccess;
+    }
+
+    bool BulkLoadController::countCache(BulkLoadReport& report)
+    {
+        Query query;
+        query.emplace("lucene", "fingerprint/_count");
+        query.emplace("query", "");
+        query.emplace("request_type", "GET");
+
+        DBConnectionPtr connection = m_cachePool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(query));
+        bool isSuccess = command->execute();
+        m_cachePool->releaseConnection(std::move(connection));
+
+        isSuccess = isSuccess && command->fetchNext() && command->asUint64("count", report.cacheRowCount);
+        if (!isSuccess)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to count the rows of the cache");
+        }
+        return isSuccess;
+    }
+}
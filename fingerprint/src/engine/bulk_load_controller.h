@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "../common/common.h"
+#include "../storage/connection_pool.h"
+
+namespace siren::cloud
+{
+    struct BulkLoadPolicy
+    {
+        BulkLoadPolicy();
+
+        // memory postgres may sort with while fp_index is rebuilt
+        std::string indexMemory{"1GB"};
+        // songs written per transaction while a bulk load is on
+        size_t storeBatchSize{128};
+    };
+
+    enum class BulkLoadState
+    {
+        Serving,
+        Loading,
+        // the load is over but fp_index could not be rebuilt, leaving again retries it
+        Failed
+    };
+
+    // what both tiers hold once a bulk load is over
+    struct BulkLoadReport
+    {
+        uint64_t primaryRowCount{0};
+        // rows the song manifests list, equal to primaryRowCount unless a write went astray
+        uint64_t manifestRowCount{0};
+        uint64_t cacheRowCount{0};
+        // rows the cache is expected to hold, 0 when that is not known
+        uint64_t expectedCacheRowCount{0};
+        bool isConsistent{false};
+        // why leaving failed, empty when it did not
+        std::string error;
+    };
+
+    /*
+     * Switches both tiers between serving and bulk loading a catalogue.
+     * While a bulk load is on, ES neither refreshes nor replicates the index and fp_index and the song_manifest key are dropped,
+     * so rows are appended without index maintenance. Leaving drops rows written twice, rebuilds both in one pass each,
+     * restores the ES settings and counts what each tier holds. Anything that needs fp_index has to wait while it is missing.
+     */
+    class BulkLoadController
+    {
+    public:
+        BulkLoadController(DBConnectionPoolPtr primaryPool, DBConnectionPoolPtr cachePool, const BulkLoadPolicy& policy = {});
+
+        BulkLoadController(const BulkLoadController& other) = delete;
+        BulkLoadController& operator=(const BulkLoadController& other) = delete;
+
+        // a process that died during a bulk load finds fp_index missing and carries on in bulk load mode
+        bool restore();
+        bool enter();
+        // ends the load even when the index cannot be rebuilt, the controller is then left failed and says why in the report
+        bool leave(BulkLoadReport& report);
+
+        bool isActive() const;
+        // true while loading and after a failed rebuild, primary storage must not be searched or purged by hash
+        bool isIndexMissing() const;
+        BulkLoadState getState() const;
+        const BulkLoadPolicy& getPolicy() const;
+
+    private:
+        bool executePrimary(const std::vector<std::string>& statements);
+        bool updateCacheSettings(const std::string& settings);
+        bool restoreCacheSettings();
+        bool countPrimary(BulkLoadReport& report);
+        bool countCache(BulkLoadReport& report);
+
+    private:
+        DBConnectionPoolPtr m_primaryPool;
+        DBConnectionPoolPtr m_cachePool;
+        BulkLoadPolicy m_policy;
+        // entering and leaving take a while, they must not interleave
+        std::mutex m_mtx;
+        std::atomic<BulkLoadState> m_state{BulkLoadState::Serving};
+    };
+}
@@ -0,0 +1,292 @@
+#include "cache_manager.h"
+#include <algorithm>
+#include <bit>
+
+namespace siren::cloud
+{
+    CachePolicy::CachePolicy()
+    {
+        std::string rowBudgetStr = siren::getenv("CACHE_ROW_BUDGET");
+        if (!rowBudgetStr.empty())
+        {
+            rowBudget = std::stoul(rowBudgetStr);
+        }
+
+        std::string sketchWidthStr = siren::getenv("CACHE_SKETCH_WIDTH");
+        if (!sketchWidthStr.empty())
+        {
+            sketchWidth = std::max<size_t>(std::stoul(sketchWidthStr), 1);
+        }
+
+        std::string sampleSizeStr = siren::getenv("CACHE_SKETCH_SAMPLE_SIZE");
+        if (!sampleSizeStr.empty())
+        {
+            sampleSize = std::stoul(sampleSizeStr);
+        }
+    }
+
+    FrequencySketch::FrequencySketch(size_t width, size_t sampleSize)
+        : m_counters(Depth * std::bit_ceil(std::max<size_t>(width, 1)), 0)
+        , m_mask(std::bit_ceil(std::max<size_t>(width, 1)) - 1)
+        , m_sampleSize(sampleSize ? sampleSize : 10 * (m_mask + 1))
+    {
+    }
+
+    size_t FrequencySketch::getIndex(uint64_t key, size_t row) const
+    {
+        // a differently offset key per row gives every row an independent looking index
+        return row * (m_mask + 1) + (mixBits(key + row * 0x9E3779B97F4A7C15ULL) & m_mask);
+    }
+
+    void FrequencySketch::increment(uint64_t key)
+    {
+        // only the smallest counters grow, which keeps collisions from inflating a rarely seen key
+        uint8_t current = estimate(key);
+        if (current == MaxCount)
+        {
+            return;
+        }
+        for (size_t row = 0; row < Depth; row++)
+        {
+            uint8_t& counter = m_counters[getIndex(key, row)];
+            if (counter == current)
+            {
+                counter++;
+            }
+        }
+        if (++m_additions >= m_sampleSize)
+        {
+            age();
+        }
+    }
+
+    uint8_t FrequencySketch::estimate(uint64_t key) const
+    {
+        uint8_t result = MaxCount;
+        for (size_t row = 0; row < Depth; row++)
+        {
+            result = std::min(result, m_counters[getIndex(key, row)]);
+        }
+        return result;
+    }
+
+    void FrequencySketch::age()
+    {
+        for (uint8_t& counter: m_counters)
+        {
+            counter >>= 1;
+        }
+        m_additions /= 2;
+    }
+
+    CacheManager::CacheManager(const CachePolicy& policy)
+        : m_policy(policy)
+        , m_sketch(policy.sketchWidth, policy.sampleSize)
+    {
+    }
+
+    void CacheManager::recordAccess(SongIdType songId)
+    {
+        std::lock_guard lock(m_mtx);
+        m_sketch.increment(songId);
+        auto it = m_residents.find(songId);
+        if (it != m_residents.end())
+        {
+            m_recency.splice(m_recency.begin(), m_recency, it->second.position);
+        }
+    }
+
+    bool CacheManager::admit(SongIdType songId, size_t rowCount)
+    {
+        std::lock_guard lock(m_mtx);
+        if (m_residents.contains(songId))
+        {
+            return true;
+        }
+        size_t budget = m_policy.rowBudget;
+        if (budget == 0 || m_usedRows + rowCount <= budget)
+        {
+            insert(songId, rowCount, true);
+            return true;
+        }
+        if (rowCount > budget)
+        {
+            return false;
+        }
+
+        // the song has to be wanted more than every song it would push out, otherwise one-off lookups churn the tier
+        uint8_t frequency = m_sketch.estimate(songId);
+        size_t freedRows = 0;
+        size_t victimCount = 0;
+        for (auto it = m_recency.rbegin(); it != m_recency.rend() && m_usedRows - freedRows + rowCount > budget; it++)
+        {
+            if (m_sketch.estimate(*it) >= frequency)
+            {
+                return false;
+            }
+            freedRows += m_residents.at(*it).rowCount;
+            victimCount++;
+        }
+
+        std::vector<Displaced> displaced;
+        for (size_t i = 0; i < victimCount; i++)
+        {
+            displaced.push_back(evictColdest());
+        }
+        insert(songId, rowCount, true);
+        if (!displaced.empty())
+        {
+            m_displaced[songId] = std::move(displaced);
+        }
+        return true;
+    }
+
+    void CacheManager::restore(SongIdType songId, size_t rowCount)
+    {
+        std::lock_guard lock(m_mtx);
+        if (!m_residents.contains(songId))
+        {
+            // nothing is known about how recently it was used, so it goes first when room is needed
+            insert(songId, rowCount, false);
+        }
+    }
+
+    void CacheManager::forget(SongIdType songId)
+    {
+        std::lock_guard lock(m_mtx);
+        auto it = m_residents.find(songId);
+        if (it != m_residents.end())
+        {
+            m_usedRows -= it->second.rowCount;
+            m_recency.erase(it->second.position);
+            m_residents.erase(it);
+        }
+        std::erase(m_evictions, songId);
+        dropDisplaced(songId);
+
+        // the room the song was given is not handed back, so what it displaced goes as if it had been committed
+        auto displaced = m_displaced.find(songId);
+        if (displaced != m_displaced.end())
+        {
+            for (const Displaced& victim: displaced->second)
+            {
+                m_evictions.push_back(victim.songId);
+            }
+            m_displaced.erase(displaced);
+        }
+    }
+
+    void CacheManager::commit(SongIdType songId)
+    {
+        std::lock_guard lock(m_mtx);
+        auto displaced = m_displaced.find(songId);
+        if (displaced == m_displaced.end())
+        {
+            return;
+        }
+        for (const Displaced& victim: displaced->second)
+        {
+            m_evictions.push_back(victim.songId);
+        }
+        m_displaced.erase(displaced);
+    }
+
+    void CacheManager::revoke(SongIdType songId)
+    {
+        std::lock_guard lock(m_mtx);
+        auto it = m_residents.find(songId);
+        if (it == m_residents.end())
+        {
+            return;
+        }
+        m_usedRows -= it->second.rowCount;
+        m_recency.erase(it->second.position);
+        m_residents.erase(it);
+        m_evictions.push_back(songId);
+
+        auto displaced = m_displaced.find(songId);
+        if (displaced == m_displaced.end())
+        {
+            return;
+        }
+        // victims went coldest first, putting them back in reverse keeps their order
+        std::vector<Displaced> victims = std::move(displaced->second);
+        m_displaced.erase(displaced);
+        for (auto victim = victims.rbegin(); victim != victims.rend(); victim++)
+        {
+            insert(victim->songId, victim->rowCount, false);
+        }
+    }
+
+    std::vector<SongIdType> CacheManager::takeEvictions()
+    {
+        std::lock_guard lock(m_mtx);
+        // displacements of admissions still being written are left alone, they may yet be revoked
+        while (m_policy.rowBudget != 0 && m_usedRows > m_policy.rowBudget && !m_recency.empty())
+        {
+            m_evictions.push_back(evictColdest().songId);
+        }
+        return std::exchange(m_evictions, {});
+    }
+
+    void CacheManager::insert(SongIdType songId, size_t rowCount, bool isHot)
+    {
+        auto position = isHot ? m_recency.insert(m_recency.begin(), songId) : m_recency.insert(m_recency.end(), songId);
+        m_residents.emplace(songId, Resident{rowCount, position});
+        m_usedRows += rowCount;
+        std::erase(m_evictions, songId);
+        dropDisplaced(songId);
+    }
+
+    CacheManager::Displaced CacheManager::evictColdest()
+    {
+        SongIdType songId = m_recency.back();
+        m_recency.pop_back();
+        auto it = m_residents.find(songId);
+        Displaced displaced{songId, it->second.rowCount};
+        m_usedRows -= it->second.rowCount;
+        m_residents.erase(it);
+        return displaced;
+    }
+
+    void CacheManager::dropDisplaced(SongIdType songId)
+    {
+        for (auto& [admitted, victims]: m_displaced)
+        {
+            std::erase_if(victims, [songId](const Displaced& victim) { return victim.songId == songId; });
+        }
+    }
+
+    void CacheManager::markComplete()
+    {
+        m_isComplete.store(true, std::memory_order_release);
+    }
+
+    bool CacheManager::isComplete() const
+    {
+        return m_isComplete.load(std::memory_order_acquire);
+    }
+
+    bool CacheManager::isBounded() const
+    {
+        return m_policy.rowBudget != 0;
+    }
+
+    bool CacheManager::isResident(SongIdType songId) const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_residents.contains(songId);
+    }
+
+    size_t CacheManager::getUsedRows() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_usedRows;
+    }
+
+    size_t CacheManager::getResidentCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_residents.size();
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "../common/common.h"
+
+namespace siren::cloud
+{
+    struct CachePolicy
+    {
+        CachePolicy();
+
+        // fingerprint rows the cache tier may hold, 0 leaves it unbounded
+        size_t rowBudget{0};
+        // counters per row of the frequency sketch, rounded up to a power of two
+        size_t sketchWidth{1 << 16};
+        // accesses after which every frequency is halved, 0 means ten per counter
+        size_t sampleSize{0};
+    };
+
+    /*
+     * Approximate access counts in a fixed amount of memory. Counts saturate at 15 and are halved once per sample,
+     * so a song that used to be popular does not keep its place forever.
+     */
+    class FrequencySketch
+    {
+    public:
+        static constexpr uint8_t MaxCount = 15;
+
+        explicit FrequencySketch(size_t width, size_t sampleSize=0);
+
+        void increment(uint64_t key);
+        uint8_t estimate(uint64_t key) const;
+
+    private:
+        static constexpr size_t Depth = 4;
+
+        size_t getIndex(uint64_t key, size_t row) const;
+        void age();
+
+    private:
+        std::vector<uint8_t> m_counters;
+        size_t m_mask;
+        size_t m_sampleSize;
+        size_t m_additions{0};
+    };
+
+    /*
+     * Knows which songs the cache tier holds and decides which ones it should hold. A song is let in while the tier is within its budget,
+     * and once it is full only if it is accessed more often than the least recently used songs it would displace.
+     * The songs an admission displaces are held back until the admitter commits it once the newcomer is written,
+     * only then they are handed out by takeEvictions and are expected to be deleted from the tier.
+     */
+    class CacheManager
+    {
+    public:
+        explicit CacheManager(const CachePolicy& policy = {});
+
+        CacheManager(const CacheManager& other) = delete;
+        CacheManager& operator=(const CacheManager& other) = delete;
+
+        void recordAccess(SongIdType songId);
+        // true when the song may be written into the tier, its rows are accounted for right away
+        bool admit(SongIdType songId, size_t rowCount);
+        // a song found in the tier without being admitted, e.g. written before a restart
+        void restore(SongIdType songId, size_t rowCount);
+        // the song is no longer in the tier
+        void forget(SongIdType songId);
+        // the song was admitted and has been written, the songs it displaced are evicted
+        void commit(SongIdType songId);
+        // the song was admitted but could not be written, the songs it displaced stay and whatever got written of it is evicted
+        void revoke(SongIdType songId);
+        // songs to delete from the tier, those displaced by committed admissions and any needed to get back within the budget
+        std::vector<SongIdType> takeEvictions();
+
+        // every song in the tier has been restored, so isResident can be trusted when it says no
+        void markComplete();
+        bool isComplete() const;
+        bool isBounded() const;
+        bool isResident(SongIdType songId) const;
+        size_t getUsedRows() const;
+        size_t getResidentCount() const;
+
+    private:
+        struct Resident
+        {
+            size_t rowCount;
+            std::list<SongIdType>::iterator position;
+        };
+
+        struct Displaced
+        {
+            SongIdType songId;
+            size_t rowCount;
+        };
+
+        void insert(SongIdType songId, size_t rowCount, bool isHot);
+        Displaced evictColdest();
+        // the song is no longer held back by any admission
+        void dropDisplaced(SongIdType songId);
+
+    private:
+        CachePolicy m_policy;
+        mutable std::mutex m_mtx;
+        FrequencySketch m_sketch;
+        std::unordered_map<SongIdType, Resident> m_residents;
+        // most recently used first
+        std::list<SongIdType> m_recency;
+        std::vector<SongIdType> m_evictions;
+        // songs pushed out by each admission that is neither committed nor revoked yet
+        std::unordered_map<SongIdType, std::vector<Displaced>> m_displaced;
+        size_t m_usedRows{0};
+        std::atomic<bool> m_isComplete{false};
+    };
+}
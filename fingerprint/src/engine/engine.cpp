@@ -1,7 +1,9 @@
 #include "engine.h"
+#include "../admission/admission_controller.h"
 #include "../thread_pool/async_manager.h"
 #include "../common/request_manager.h"
 #include "../common/common.h"
+#include "../storage/elastic/bulk_body_writer.h"
 #include <filesystem>
 #include <regex>
 
@@ -58,50 +60,205 @@ namespace siren::cloud
         elasticConnString = elastic.str();
     }
 
-    Engine::Engine(const DBConnectionPoolPtr& primaryPool, const DBConnectionPoolPtr& cachePool, const SirenCorePtr& corePtr)
-       : m_sirenCore(corePtr)
+    TierPolicy::TierPolicy()
+    {
+        std::string modeStr = siren::getenv("FIND_TIER_MODE");
+        if (modeStr == "hedged")
+        {
+            mode = TierMode::Hedged;
+        }
+        else if (modeStr == "parallel")
+        {
+            mode = TierMode::Parallel;
+        }
+        else if (!modeStr.empty() && modeStr != "sequential")
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Unknown tier mode " + modeStr + ", falling back to sequential");
+        }
+
+        std::string hedgeDelayStr = siren::getenv("FIND_HEDGE_MIN_DELAY_MS");
+        if (!hedgeDelayStr.empty())
+        {
+            minHedgeDelay = std::chrono::milliseconds(std::stoul(hedgeDelayStr));
+        }
+
+        std::string percentileStr = siren::getenv("FIND_HEDGE_PERCENTILE");
+        if (!percentileStr.empty())
+        {
+            hedgePercentile = std::stod(percentileStr);
+        }
+
+        std::string missRateStr = siren::getenv("FIND_PREDICTED_MISS_RATE");
+        if (!missRateStr.empty())
+        {
+            predictedMissRate = std::stod(missRateStr);
+        }
+    }
+
+    CompactionPolicy::CompactionPolicy()
+    {
+        std::string intervalStr = siren::getenv("COMPACTION_INTERVAL_MS");
+        if (!intervalStr.empty())
+        {
+            interval = std::chrono::milliseconds(std::max<size_t>(std::stoul(intervalStr), 1));
+        }
+
+        std::string batchSizeStr = siren::getenv("COMPACTION_BATCH_SIZE");
+        if (!batchSizeStr.empty())
+        {
+            batchSize = std::stoul(batchSizeStr);
+        }
+
+        std::string maxLoadStr = siren::getenv("COMPACTION_MAX_LOAD");
+        if (!maxLoadStr.empty())
+        {
+            maxLoad = std::stod(maxLoadStr);
+        }
+    }
+
+    Engine::Engine(const DBConnectionPoolPtr& primaryPool, const DBConnectionPoolPtr& cachePool, const SirenCorePoolPtr& corePool)
+       : m_corePool(corePool)
        , m_primaryPool(primaryPool)
        , m_cachePool(cachePool)
+       , m_registry(primaryPool)
+       , m_bulkLoad(primaryPool, cachePool)
+       , m_stopping(CancellationToken::create())
+       , m_ingestion(std::array<IngestionManager::BatchStage, IngestionStageCount>{
+             IngestionManager::forEachJob([this](IngestionJob& job) { return downloadTrack(job); }),
+             IngestionManager::forEachJob([this](IngestionJob& job) { return fingerprintTrack(job); }),
+             [this](const std::vector<IngestionJob*>& jobs) { return storeTracks(jobs); }
+         })
+       , m_promotions([this](const std::vector<SongIdType>& songIds) { return cacheFingerprintsBySongIds(songIds); })
     {
+        // songs cached before a restart count against the budget, and promotions ask the cache until they are known
+        spawn(runOnPool(TaskPriority::Maintenance, [this] { return restoreCacheResidents(); }));
+        spawn(compactAsync());
+        m_storeBatchSize = m_ingestion.getBatchSize(IngestionStage::Store);
+        if (m_bulkLoad.restore() && m_bulkLoad.isActive())
+        {
+            m_ingestion.setBatchSize(IngestionStage::Store, m_bulkLoad.getPolicy().storeBatchSize);
+        }
+        replayJournal();
     }
 
     Engine::~Engine()
     {
-        std::unique_lock lock(m_mtx);
-        m_cv.wait(lock, [&]{ return m_asyncCount == 0; });
+        // loads in progress are finished rather than dropped, they hold claims
+        m_ingestion.join();
+        // compaction notices at the end of its current wait
+        m_stopping.cancel();
+        m_scope.join();
+        m_promotions.join();
     }
 
-    void Engine::markAsyncStart()
+    coro::Task<bool> Engine::runOnPool(TaskPriority priority, std::function<bool()> job, CancellationToken cancellation)
     {
-        m_asyncCount++;
+        co_await AsyncManager::instance().schedule(priority);
+        if (cancellation.isCancelled())
+        {
+            // dropped while still queued, nobody is waiting for the result anymore
+            co_return false;
+        }
+        co_return job();
     }
 
-    void Engine::markAsyncEnd()
+    std::vector<SongIdType> Engine::findSongIdsMissingFromCache(bool& isSuccess, const std::vector<SongIdType>& songIds)
     {
-        m_asyncCount--;
-        m_cv.notify_one();
+        // the counts are sent concurrently and come back in the order of the queries
+        QueryCollection queries;
+        queries.reserve(songIds.size());
+        for (SongIdType songId: songIds)
+        {
+            std::stringstream stream;
+            stream << R"({"query": {"term": {"song_id": )" << songId << "}}}";
+
+            Query query;
+            query.emplace("lucene", "fingerprint/_count");
+            query.emplace("query", stream.str());
+            query.emplace("request_type", "GET");
+            queries.insertQuery(std::move(query));
+        }
+
+        DBConnectionPtr connection = m_cachePool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(queries));
+        isSuccess = command->execute() && command->getSize() == songIds.size();
+        m_cachePool->releaseConnection(std::move(connection));
+        if (!isSuccess)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to check whether songs are in cache");
+            return {};
+        }
+
+        std::vector<SongIdType> missing;
+        for (SongIdType songId: songIds)
+        {
+            size_t count{0};
+            if (!command->fetchNext() || !command->asSize("count", count))
+            {
+                isSuccess = false;
+                return {};
+            }
+            if (count == 0)
+            {
+                missing.push_back(songId);
+            }
+        }
+        return missing;
     }
 
-    bool Engine::cacheFingerprintBySongId(SongIdType songId)
+    bool Engine::cacheFingerprintsBySongIds(const std::vector<SongIdType>& requested)
     {
-        bool exists;
-        bool isOk = isSongIdInCache(exists, songId);
+        // a song deleted since it was requested is about to be removed from storage altogether
+        std::vector<SongIdType> songIds;
+        auto tombstones = m_tombstones.getSnapshot();
+        std::copy_if(requested.begin(), requested.end(), std::back_inserter(songIds), [&tombstones](SongIdType songId) {
+            return !tombstones->contains(songId);
+        });
+        if (songIds.empty())
+        {
+            return true;
+        }
 
-        if (!isOk)
+        std::vector<SongIdType> missing;
+        if (m_cacheManager.isComplete())
         {
-            return false;
+            std::copy_if(songIds.begin(), songIds.end(), std::back_inserter(missing), [this](SongIdType songId) {
+                return !m_cacheManager.isResident(songId);
+            });
         }
-        if (exists)
+        else
         {
-            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Tried to cache a song already in cache");
-            return false;
+            // the cache has not been listed yet, so it has to be asked
+            bool isOk = false;
+            missing = findSongIdsMissingFromCache(isOk, songIds);
+            if (!isOk)
+            {
+                return false;
+            }
+        }
+        if (missing.size() != songIds.size())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Tried to cache songs already in cache");
+        }
+        if (missing.empty())
+        {
+            return true;
         }
 
-        DBConnectionPtr postgresConnection = m_primaryPool->getConnection();
+        // the manifest lists the hashes of each song, so every row is reached through fp_index instead of a scan
+        std::stringstream sql;
+        sql << "SELECT f.hash, f.timestamp, f.song_id FROM song_manifest m "
+            << "JOIN fingerprint f ON f.hash = m.hash AND f.song_id = m.song_id WHERE m.song_id IN (";
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            sql << (i ? "," : "") << missing[i];
+        }
+        sql << ')';
+
         Query postgresReq;
-        std::string sql = "SELECT hash, timestamp, song_id FROM fingerprint WHERE song_id = " + std::to_string(songId);
-        postgresReq.emplace("query", sql);
+        postgresReq.emplace("query", sql.str());
 
+        DBConnectionPtr postgresConnection = m_primaryPool->getConnection();
         DBCommandPtr postgresCommand = postgresConnection->createCommand(std::move(postgresReq));
         if (!postgresCommand->execute() || postgresCommand->isEmpty())
         {
@@ -110,45 +267,185 @@ namespace siren::cloud
             return false;
         }
 
-        QueryCollection elasticQueries;
-        elasticQueries.reserve(postgresCommand->getSize());
-
-        std::stringstream ss;
+        // rows are grouped by song first, a song is cached as a whole or not at all
+        std::unordered_map<SongIdType, std::vector<std::pair<HashType, TimestampType>>> songRows;
         while (postgresCommand->fetchNext())
         {
-            Query elasticQuery;
-            elasticQuery.emplace("lucene", "fingerprint/_bulk");
-            elasticQuery.emplace("request_type", "POST");
-            elasticQuery.emplace("header", "{\"index\": {}}");
-
             HashType hash;
             TimestampType ts;
+            SongIdType songId;
             postgresCommand->asUint64("hash", hash);
             postgresCommand->asInt32("timestamp", ts);
+            postgresCommand->asUint64("song_id", songId);
+            songRows[songId].emplace_back(hash, ts);
+        }
+        m_primaryPool->releaseConnection(std::move(postgresConnection));
 
-            ss << "{\"hash\": " << hash << ',';
-            ss << "\"song_id\": " << songId << ',';
-            ss << "\"timestamp\": " << ts << '}';
+        // rows of every admitted song in the batch go out in the same bulk requests
+        elastic::BulkBodyWriter writer;
+        writer.reserve(postgresCommand->getSize());
+        std::vector<SongIdType> admitted;
+        for (const auto& [songId, rows]: songRows)
+        {
+            if (!m_cacheManager.admit(songId, rows.size()))
+            {
+                continue;
+            }
+            admitted.push_back(songId);
+            for (const auto& [hash, ts]: rows)
+            {
+                writer.index(hash, ts, songId);
+            }
+        }
+        if (admitted.empty())
+        {
+            Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "None of the songs are accessed often enough to be cached");
+            return true;
+        }
 
-            elasticQuery.emplace("query", ss.str());
-            elasticQueries.insertQuery(std::move(elasticQuery));
+        DBConnectionPtr elasticConnection = m_cachePool->getConnection();
+        DBCommandPtr elasticCommand = elasticConnection->createCommand(writer.takeQueries("fingerprint/_bulk"));
+        bool isSuccess = elasticCommand->execute();
+        m_cachePool->releaseConnection(std::move(elasticConnection));
+        // the songs displaced to make room are only deleted once their replacements are in, otherwise they stay
+        for (SongIdType songId: admitted)
+        {
+            if (isSuccess)
+            {
+                m_cacheManager.commit(songId);
+            }
+            else
+            {
+                m_cacheManager.revoke(songId);
+            }
+        }
+        evictFromCache(m_cacheManager.takeEvictions());
+
+        std::stringstream msg;
+        msg << "Promoted " << admitted.size() << " of " << missing.size() << " songs into cache";
+        Logger::log(isSuccess ? LogLevel::INFO : LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, isSuccess ? msg.str() : "Failed to promote songs into cache");
+        return isSuccess;
+    }
+
+    bool Engine::restoreCacheResidents()
+    {
+        std::string pageSizeStr = siren::getenv("CACHE_RESTORE_PAGE_SIZE");
+        size_t pageSize = !pageSizeStr.empty() ? std::max<size_t>(std::stoul(pageSizeStr), 1) : 10000;
+
+        // composite buckets come back ordered by song id, so each page starts after the last song of the previous one
+        std::optional<SongIdType> lastSongId;
+        size_t songCount = 0;
+        while (true)
+        {
+            std::stringstream stream;
+            stream << R"({"size": 0, "aggs": {"songs": {"composite": {"size": )" << pageSize
+                   << R"(, "sources": [{"song_id": {"terms": {"field": "song_id"}}}])";
+            if (lastSongId)
+            {
+                stream << R"(, "after": {"song_id": )" << *lastSongId << '}';
+            }
+            stream << "}}}}";
 
-            ss.clear();
-            ss.str({});
+            Query query;
+            query.emplace("lucene", "fingerprint/_search");
+            query.emplace("query", stream.str());
+            query.emplace("request_type", "GET");
+
+            DBConnectionPtr connection = m_cachePool->getConnection();
+            DBCommandPtr command = connection->createCommand(std::move(query));
+            bool isSuccess = command->execute();
+            m_cachePool->releaseConnection(std::move(connection));
+            if (!isSuccess)
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to find out which songs are in cache");
+                return false;
+            }
+
+            size_t pageCount = 0;
+            while (command->fetchNext())
+            {
+                SongIdType songId;
+                size_t rowCount;
+                if (!command->asUint64("key", songId) || !command->asSize("doc_count", rowCount))
+                {
+                    return false;
+                }
+                m_cacheManager.restore(songId, rowCount);
+                lastSongId = songId;
+                pageCount++;
+            }
+            songCount += pageCount;
+            if (pageCount < pageSize)
+            {
+                break;
+            }
         }
+        m_cacheManager.markComplete();
 
-        DBConnectionPtr elasticConnection = m_cachePool->getConnection();
-        DBCommandPtr elasticCommand = elasticConnection->createCommand(std::move(elasticQueries));
+        std::stringstream msg;
+        msg << "Found " << songCount << " songs in cache, " << m_cacheManager.getUsedRows() << " rows in total";
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+        return evictFromCache(m_cacheManager.takeEvictions());
+    }
 
-        bool isSuccess = elasticCommand->execute();
+    bool Engine::evictFromCache(const std::vector<SongIdType>& songIds)
+    {
+        if (songIds.empty())
+        {
+            return true;
+        }
 
-        m_cachePool->releaseConnection(std::move(elasticConnection));
+        // an evicted song stays in primary storage, its manifest names every document it has in cache
+        std::stringstream sql;
+        sql << "SELECT song_id, hash FROM song_manifest WHERE song_id IN (";
+        for (size_t i = 0; i < songIds.size(); i++)
+        {
+            sql << (i ? "," : "") << songIds[i];
+        }
+        sql << ')';
+
+        Query postgresReq;
+        postgresReq.emplace("query", sql.str());
+
+        DBConnectionPtr postgresConnection = m_primaryPool->getConnection();
+        DBCommandPtr postgresCommand = postgresConnection->createCommand(std::move(postgresReq));
+        bool isListed = postgresCommand->execute();
         m_primaryPool->releaseConnection(std::move(postgresConnection));
 
+        elastic::BulkBodyWriter writer;
+        writer.reserve(postgresCommand->getSize());
+        while (isListed && postgresCommand->fetchNext())
+        {
+            HashType hash;
+            SongIdType songId;
+            isListed = postgresCommand->asUint64("hash", hash) && postgresCommand->asUint64("song_id", songId);
+            if (isListed)
+            {
+                writer.remove(hash, songId);
+            }
+        }
+
+        bool isSuccess = true;
+        if (!isListed)
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Could not list the documents of cold songs, deleting them by query");
+            isSuccess = purgeTrackFingerprintFromCache(songIds);
+        }
+        else if (!writer.empty())
+        {
+            DBConnectionPtr connection = m_cachePool->getConnection();
+            DBCommandPtr command = connection->createCommand(writer.takeQueries("fingerprint/_bulk"));
+            isSuccess = command->execute();
+            m_cachePool->releaseConnection(std::move(connection));
+        }
+
+        std::stringstream msg;
+        msg << (isSuccess ? "Evicted " : "Failed to evict ") << songIds.size() << " cold songs from cache";
+        Logger::log(isSuccess ? LogLevel::INFO : LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, msg.str());
         return isSuccess;
     }
 
-    DBCommandPtr Engine::fetchFingerprintsFromCache(bool& isSuccess, const FingerprintType& snippet)
+    coro::Task<DBCommandPtr> Engine::fetchFingerprintsFromCacheAsync(const FingerprintType& snippet, const CancellationToken& cancellation)
     {
         std::string batchSize = siren::getenv("ELASTIC_BATCH_SIZE");
         size_t optimalBatchSize = !batchSize.empty() ? std::stoul(batchSize) : 500;
@@ -226,21 +523,21 @@ namespace siren::cloud
             }
         }
 
+        // the searches are in flight on the HttpClient reactor, no pool thread waits for them
         DBConnectionPtr elasticConnection = m_cachePool->getConnection();
         DBCommandPtr elasticCommand = elasticConnection->createCommand(std::move(queryCollection));
-        bool success = elasticCommand->execute();
+        elasticCommand->setCancellationToken(cancellation);
+        bool success = co_await elasticCommand->executeAsync(TaskPriority::Interactive);
         m_cachePool->releaseConnection(std::move(elasticConnection));
         if (!success)
         {
             Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not fetch data from cache");
-            isSuccess = false;
-            return {};
+            co_return nullptr;
         }
-        isSuccess = true;
-        return elasticCommand;
+        co_return elasticCommand;
     }
 
-    DBCommandPtr Engine::fetchFingerprintsFromPrimary(bool& isSuccess, const FingerprintType& snippet)
+    coro::Task<DBCommandPtr> Engine::fetchFingerprintsFromPrimaryAsync(const FingerprintType& snippet, const CancellationToken& cancellation)
     {
         const auto& hashes = snippet.get_hashes();
         std::stringstream stream;
@@ -260,277 +557,639 @@ namespace siren::cloud
         Query query;
         query.emplace("query", stream.str());
 
+        // the connection stays borrowed while the query is in flight, but no pool thread waits on it
         DBConnectionPtr postgresConnection = m_primaryPool->getConnection();
         DBCommandPtr postgresCommand = postgresConnection->createCommand(std::move(query));
-        bool success = postgresCommand->execute();
+        postgresCommand->setCancellationToken(cancellation);
+        bool success = co_await postgresCommand->executeAsync(TaskPriority::Interactive);
         m_primaryPool->releaseConnection(std::move(postgresConnection));
         if (!success)
         {
             Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not fetch data from primary storage");
-            isSuccess = false;
-            return {};
+            co_return nullptr;
+        }
+        co_return postgresCommand;
+    }
+
+    HistReturnType Engine::findSongIdByFingerprint(bool& isSuccess, FingerprintType&& fingerprint, const CancellationToken& cancellation)
+    {
+        FindResult result = coro::syncWait(findSongIdByFingerprintAsync(std::move(fingerprint), cancellation));
+        isSuccess = result.isSuccess;
+        return result.hist;
+    }
+
+    coro::Task<FindResult> Engine::findSongIdByFingerprintAsync(FingerprintType fingerprint, CancellationToken cancellation)
+    {
+        FindResultCache::Digest digest = FindResultCache::makeDigest(fingerprint);
+        auto cached = m_resultCache.lookup(digest);
+        if (cached && !(cached->isSuccess && m_tombstones.contains(cached->hist.getSongId())))
+        {
+            recordSongAccess(*cached);
+            co_return *cached;
+        }
+
+        bool isLeader = false;
+        FindResultCache::FlightPtr flight = m_resultCache.join(digest, isLeader);
+        if (!isLeader)
+        {
+            // the joiner gives up on its own cancellation, the flight goes on for everyone else
+            FindResult shared = co_await m_resultCache.wait(std::move(flight), cancellation);
+            recordSongAccess(shared);
+            co_return shared;
+        }
+
+        // the lookup serves every request that joins it, so one client going away must not stop it, only the deadline does
+        CancellationToken flightCancellation = CancellationToken::create();
+        if (cancellation.hasDeadline())
+        {
+            flightCancellation.setDeadline(CancellationToken::Clock::now() + cancellation.getRemaining({}));
+        }
+
+        std::optional<FindResult> result;
+        try
+        {
+            result.emplace(co_await findInTiersAsync(std::move(fingerprint), flightCancellation));
+        }
+        catch (...)
+        {
+            m_resultCache.complete(digest, flight, FindResult{false, HistReturnType{HistStatus::Uncertain}, false, true}, false);
+            throw;
         }
-        isSuccess = true;
-        return postgresCommand;
+        bool isCacheable = !result->isShed && !result->isFailed && !flightCancellation.isCancelled();
+        m_resultCache.complete(digest, flight, *result, isCacheable);
+        recordSongAccess(*result);
+        co_return *result;
     }
 
-    HistReturnType Engine::findSongIdByFingerprint(bool& isSuccess, FingerprintType&& fingerprint)
+    coro::Task<FindResult> Engine::findInTiersAsync(FingerprintType fingerprint, CancellationToken cancellation)
     {
-        bool isElasticSuccess = false;
-        DBCommandPtr elasticCommand = fetchFingerprintsFromCache(isElasticSuccess, fingerprint);
-        if (!isElasticSuccess)
+        // racing only pays off when primary storage has room for lookups that may turn out to be wasted
+        if (m_tierPolicy.mode == TierMode::Sequential || AdmissionController::instance().isSheddingFallbacks() || m_bulkLoad.isIndexMissing())
         {
-            isSuccess = false;
-            return HistReturnType{HistStatus::Uncertain};
+            co_return co_await findSequentiallyAsync(std::move(fingerprint), std::move(cancellation));
         }
+        co_return co_await raceTiersAsync(std::move(fingerprint), std::move(cancellation));
+    }
 
-        Histogram elasticHistogram(elasticCommand, fingerprint);
+    coro::Task<FindResult> Engine::findInCacheAsync(const FingerprintType& snippet, CancellationToken cancellation)
+    {
+        auto start = std::chrono::steady_clock::now();
+        DBCommandPtr elasticCommand = co_await fetchFingerprintsFromCacheAsync(snippet, cancellation);
+        if (!elasticCommand)
+        {
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}, false, true};
+        }
+
+        auto tombstones = m_tombstones.getSnapshot();
+        Histogram elasticHistogram(elasticCommand, snippet, *tombstones);
         HistReturnType elasticHist = elasticHistogram.findDominantPeak();
-        if (elasticHist)
+        m_cacheLatency.record(std::chrono::steady_clock::now() - start);
+        recordCacheOutcome(static_cast<bool>(elasticHist));
+        if (!elasticHist)
         {
-            isSuccess = true;
-            return elasticHist;
+            Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "Failed to deduce song id from cache data");
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}};
         }
-        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "Failed to deduce song id from cache data");
+        co_return FindResult{true, elasticHist};
+    }
 
-        bool isPostgresSuccess = false;
-        DBCommandPtr postgresCommand = fetchFingerprintsFromPrimary(isPostgresSuccess, fingerprint);
-        if (!isPostgresSuccess)
+    coro::Task<FindResult> Engine::findInPrimaryAsync(const FingerprintType& snippet, CancellationToken cancellation)
+    {
+        DBCommandPtr postgresCommand = co_await fetchFingerprintsFromPrimaryAsync(snippet, cancellation);
+        if (!postgresCommand)
         {
-            isSuccess = false;
-            return HistReturnType{HistStatus::Uncertain};
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}, false, true};
         }
 
-        Histogram postgresHistogram(postgresCommand, fingerprint);
+        auto tombstones = m_tombstones.getSnapshot();
+        Histogram postgresHistogram(postgresCommand, snippet, *tombstones);
         HistReturnType postgresHist = postgresHistogram.findDominantPeak();
+        if (postgresHist && cancellation.isCancelled())
+        {
+            // an abandoned request is most likely a sign of overload, promoting now would only add to it
+            co_return FindResult{true, postgresHist};
+        }
         if (postgresHist)
         {
-            isSuccess = true;
-            AsyncManager::instance().submitTask([&]
+            // concurrent misses on a trending song all land here, only the first of them queues a copy
+            // a bulk load leaves primary storage without fp_index, copying a song out of it then means scanning the table
+            if (!m_bulkLoad.isIndexMissing())
             {
-                markAsyncStart();
-                if (!cacheFingerprintBySongId(postgresHist.getSongId()))
-                {
-                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to cache data");
-                }
-                markAsyncEnd();
-            });
-            return postgresHist;
+                m_promotions.request(postgresHist.getSongId());
+            }
+            co_return FindResult{true, postgresHist};
         }
         Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Failed to deduce song id from primary storage data");
-        isSuccess = false;
-        return HistReturnType{HistStatus::Uncertain};
+        co_return FindResult{false, HistReturnType{HistStatus::Uncertain}};
     }
 
-    bool Engine::isSongIdInPrimary(bool& exists, SongIdType songId, bool shouldClaim)
+    coro::Task<FindResult> Engine::findSequentiallyAsync(FingerprintType fingerprint, CancellationToken cancellation)
     {
-        Query query;
-        std::stringstream sql;
-        if (shouldClaim)
+        FindResult cacheResult = co_await findInCacheAsync(fingerprint, cancellation);
+        if (cacheResult.isFailed || cacheResult.isSuccess)
         {
-            sql << "SELECT \"find_song_id\"(" << songId << ")";
+            co_return cacheResult;
         }
-        else
+
+        if (cancellation.isCancelled())
         {
-            sql << "SELECT EXISTS (SELECT 1 from fingerprint WHERE song_id = " << songId << ')'
-                << "AS \"find_song_id\";";
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Request was cancelled before falling back to primary storage");
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}};
         }
+        if (AdmissionController::instance().isSheddingFallbacks())
+        {
+            // a fallback costs several times a cache hit, dropping it first keeps hits fast under overload
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Server is overloaded, shedding the primary storage fallback");
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}, true};
+        }
+        if (m_bulkLoad.isIndexMissing())
+        {
+            // every lookup by hash would scan the whole table, the cache alone serves until fp_index is back
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "fp_index is missing, shedding the primary storage fallback");
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}, true};
+        }
+        co_return co_await findInPrimaryAsync(fingerprint, cancellation);
+    }
 
-        query.emplace("query", sql.str());
-
-        DBConnectionPtr connection = m_primaryPool->getConnection();
-        DBCommandPtr command = connection->createCommand(std::move(query));
+    coro::Task<FindResult> Engine::raceTiersAsync(FingerprintType fingerprint, CancellationToken cancellation)
+    {
+        auto snippet = std::make_shared<const FingerprintType>(std::move(fingerprint));
+        CancellationToken cacheCancellation = cancellation.createChild();
+        CancellationToken primaryCancellation = cancellation.createChild();
+        auto isShed = std::make_shared<std::atomic<bool>>(false);
+        // set once the cache has missed, so that the primary tier does not sit out the rest of the hedge delay
+        coro::TimedEvent isCacheDone;
+
+        // the losing tier outlives this coroutine, tracking it keeps the engine alive until it has wound down
+        std::vector<coro::Task<FindResult>> tiers;
+        tiers.emplace_back(m_scope.track(raceCacheTierAsync(snippet, cacheCancellation, isCacheDone)));
+        tiers.emplace_back(m_scope.track(racePrimaryTierAsync(snippet, primaryCancellation, getHedgeDelay(), isShed, isCacheDone)));
+
+        auto [winner, result] = co_await coro::whenAny(std::move(tiers), [](const FindResult& tierResult) {
+            return tierResult.isSuccess;
+        });
+        // frees the loser's connection and stops whatever backend work it has not started yet
+        cacheCancellation.cancel();
+        primaryCancellation.cancel();
+        isCacheDone.set();
+
+        if (!result.isSuccess)
+        {
+            result.isShed = isShed->load();
+        }
+        else if (winner == 1)
+        {
+            Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "Primary storage answered before the cache");
+        }
+        co_return result;
+    }
 
-        if (!command->execute() || !command->asBool("find_song_id", exists))
+    coro::Task<FindResult> Engine::raceCacheTierAsync(std::shared_ptr<const FingerprintType> snippet, CancellationToken cancellation,
+                                                      coro::TimedEvent isDone)
+    {
+        co_await AsyncManager::instance().schedule(TaskPriority::Interactive);
+        FindResult result = co_await findInCacheAsync(*snippet, cancellation);
+        if (!result.isSuccess)
         {
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to check whether song is in primary storage");
-            m_primaryPool->releaseConnection(std::move(connection));
-            return false;
+            isDone.set();
         }
-        m_primaryPool->releaseConnection(std::move(connection));
-        return true;
+        co_return result;
     }
 
-    bool Engine::isSongIdInCache(bool& exists, SongIdType songId)
+    coro::Task<FindResult> Engine::racePrimaryTierAsync(std::shared_ptr<const FingerprintType> snippet, CancellationToken cancellation,
+                                                        std::chrono::milliseconds delay, std::shared_ptr<std::atomic<bool>> isShed,
+                                                        coro::TimedEvent isCacheDone)
     {
-        Query query;
-        std::stringstream stream;
-        stream << R"({"query": {"match": {"song_id":)" << songId << "}}}";
+        co_await isCacheDone.wait(delay, TaskPriority::Interactive);
+        if (cancellation.isCancelled())
+        {
+            // the cache has answered in time, which is the common case
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}};
+        }
+        if (AdmissionController::instance().isSheddingFallbacks())
+        {
+            isShed->store(true);
+            co_return FindResult{false, HistReturnType{HistStatus::Uncertain}};
+        }
+        co_return co_await findInPrimaryAsync(*snippet, cancellation);
+    }
 
-        query.emplace("lucene", "fingerprint/_count");
-        query.emplace("query", stream.str());
-        query.emplace("request_type", "GET");
+    std::chrono::milliseconds Engine::getHedgeDelay() const
+    {
+        if (m_tierPolicy.mode == TierMode::Parallel || m_cacheMissRate.load(std::memory_order_relaxed) > m_tierPolicy.predictedMissRate)
+        {
+            return std::chrono::milliseconds{0};
+        }
+        auto percentile = m_cacheLatency.getPercentile(m_tierPolicy.hedgePercentile, m_tierPolicy.minHedgeDelay);
+        return std::max(percentile, m_tierPolicy.minHedgeDelay);
+    }
 
-        DBConnectionPtr connection = m_cachePool->getConnection();
-        DBCommandPtr command = connection->createCommand(std::move(query));
+    void Engine::recordCacheOutcome(bool isHit)
+    {
+        // decays over roughly the last hundred lookups
+        static constexpr double Weight = 0.02;
+        double sample = isHit ? 0.0 : 1.0;
+        double current = m_cacheMissRate.load(std::memory_order_relaxed);
+        while (!m_cacheMissRate.compare_exchange_weak(current, current + (sample - current) * Weight, std::memory_order_relaxed))
+        {
+        }
+    }
 
-        size_t count{0};
-        if (!command->execute() || !command->asSize("count", count))
+    void Engine::recordSongAccess(const FindResult& result)
+    {
+        // every request counts, including those answered without reaching storage
+        if (result.isSuccess)
         {
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to check whether song is in cache");
-            m_cachePool->releaseConnection(std::move(connection));
-            return false;
+            m_cacheManager.recordAccess(result.hist.getSongId());
         }
-        m_cachePool->releaseConnection(std::move(connection));
-        exists = count > 0;
-        return true;
     }
 
-    bool Engine::loadFingerprintIntoPrimary(const FingerprintType& fingerprint, SongIdType songId)
+    bool Engine::loadFingerprintsIntoPrimary(const std::vector<std::pair<SongIdType, const FingerprintType*>>& fingerprints)
     {
         QueryCollection queryCollection;
-        queryCollection.reserve(fingerprint.get_size());
+        queryCollection.reserve(2 * fingerprints.size());
 
         std::stringstream stream;
-        for (auto it = fingerprint.cbegin(); it != fingerprint.cend(); it++)
+        for (const auto& [songId, fingerprint]: fingerprints)
         {
-            Query query;
+            // a song goes in as one statement over its arrays, a statement per row costs a round trip and a plan each
+            std::stringstream hashes, timestamps;
+            bool isFirst = true;
+            for (auto it = fingerprint->cbegin(); it != fingerprint->cend(); it++)
+            {
+                hashes << (isFirst ? "" : ",") << it->first;
+                timestamps << (isFirst ? "" : ",") << it->second;
+                isFirst = false;
+            }
 
-            stream << "INSERT INTO fingerprint(hash, song_id, timestamp) VALUES (";
-            stream << it->first << ',' << songId << ',' << it->second << ')';
+            stream << "INSERT INTO fingerprint(hash, song_id, timestamp) SELECT entry.hash, " << songId << ", entry.timestamp FROM unnest('{"
+                   << hashes.str() << "}'::numeric[], '{" << timestamps.str() << "}'::int[]) AS entry(hash, timestamp)";
 
+            Query query;
             query.emplace("query", stream.str());
             queryCollection.insertQuery(std::move(query));
 
             stream.clear();
             stream.str({});
-        }
 
-        bool isSuccess;
-        DBConnectionPtr connection = m_primaryPool->getConnection();
-        {
-            DBCommandPtr command = connection->createCommand(std::move(queryCollection));
-            isSuccess = command->execute();
-        }
+            // written in the same transaction as the rows it lists
+            stream << "INSERT INTO song_manifest(song_id, hash) SELECT " << songId << ", unnest('{" << hashes.str() << "}'::numeric[]) ON CONFLICT DO NOTHING";
 
-        // cleaning up in case there is a claiming row for this song_id
-        Query cleanUpQuery;
-        stream << "DELETE FROM fingerprint WHERE hash=-1 AND timestamp=-1 AND song_id=" << songId;
-        cleanUpQuery.emplace("query", stream.str());
+            Query manifestQuery;
+            manifestQuery.emplace("query", stream.str());
+            queryCollection.insertQuery(std::move(manifestQuery));
 
-        DBCommandPtr command = connection->createCommand(std::move(cleanUpQuery));
-        command->execute();
+            stream.clear();
+            stream.str({});
+        }
 
+        DBConnectionPtr connection = m_primaryPool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(queryCollection));
+        bool isSuccess = command->execute();
         m_primaryPool->releaseConnection(std::move(connection));
         return isSuccess;
     }
 
-    bool Engine::loadFingerprintIntoCache(const FingerprintType& fingerprint, SongIdType songId)
+    bool Engine::loadFingerprintsIntoCache(const std::vector<std::pair<SongIdType, const FingerprintType*>>& fingerprints)
     {
-        QueryCollection queries;
-        queries.reserve(fingerprint.get_size());
-
-        std::stringstream stream;
-        for (auto it = fingerprint.cbegin(); it != fingerprint.cend(); it++)
+        elastic::BulkBodyWriter writer;
+        size_t rowCount = 0;
+        for (const auto& [songId, fingerprint]: fingerprints)
         {
-            Query currentQuery;
-
-            stream << "{\"hash\": " << it->first << ',';
-            stream << "\"song_id\": " << songId << ',';
-            stream << "\"timestamp\": " << it->second << '}';
-
-            currentQuery.emplace("lucene", "fingerprint/_bulk");
-            currentQuery.emplace("query", stream.str());
-            currentQuery.emplace("request_type", "POST");
-            currentQuery.emplace("header", "{\"index\": {}}");
+            rowCount += fingerprint->get_size();
+        }
+        writer.reserve(rowCount);
 
-            queries.insertQuery(std::move(currentQuery));
-            stream.clear();
-            stream.str({});
+        for (const auto& [songId, fingerprint]: fingerprints)
+        {
+            for (auto it = fingerprint->cbegin(); it != fingerprint->cend(); it++)
+            {
+                writer.index(it->first, it->second, songId);
+            }
         }
         DBConnectionPtr connection = m_cachePool->getConnection();
-        DBCommandPtr command = connection->createCommand(std::move(queries));
+        DBCommandPtr command = connection->createCommand(writer.takeQueries("fingerprint/_bulk"));
         bool isSuccess = command->execute();
         m_cachePool->releaseConnection(std::move(connection));
         return isSuccess;
     }
 
-    bool Engine::loadTrackByUrl(const std::string& url, SongIdType songId, bool isCaching)
+    LoadSubmission Engine::submitLoad(JobIdType& jobId, std::string url, SongIdType songId, bool isCaching)
     {
-        if (!isSongIdValid(songId))
+        bool isClaimed = false;
+        if (!m_registry.claim(isClaimed, songId))
+        {
+            return LoadSubmission::Failed;
+        }
+        if (!isClaimed)
         {
             Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Tried to load a song already in storage");
-            return false;
+            return LoadSubmission::AlreadyLoaded;
         }
 
-        std::string dir = "/tmp";
-        std::string filePath;
-        if (!generateUniqueFilePath(dir, filePath))
+        std::optional<JobIdType> submitted = m_ingestion.submit(std::move(url), songId, isCaching);
+        if (!submitted)
         {
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to generate a unique file name");
-            return false;
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Ingestion queue is full, refusing the load");
+            m_registry.release(songId);
+            return LoadSubmission::Overloaded;
+        }
+        jobId = *submitted;
+        return LoadSubmission::Accepted;
+    }
+
+    std::optional<JobStatus> Engine::getLoadStatus(JobIdType jobId) const
+    {
+        return m_ingestion.getStatus(jobId);
+    }
+
+    bool Engine::setBulkLoadMode(bool isEnabled, BulkLoadReport& report)
+    {
+        if (isEnabled)
+        {
+            if (!m_bulkLoad.enter())
+            {
+                return false;
+            }
+            // songs piling up behind the store stage go into fewer, larger transactions
+            m_ingestion.setBatchSize(IngestionStage::Store, m_bulkLoad.getPolicy().storeBatchSize);
+            return true;
+        }
+
+        report.expectedCacheRowCount = m_cacheManager.getUsedRows();
+        bool isSuccess = m_bulkLoad.leave(report);
+        if (!m_bulkLoad.isActive())
+        {
+            m_ingestion.setBatchSize(IngestionStage::Store, m_storeBatchSize);
         }
+        return isSuccess;
+    }
 
-        std::string useSslStr = siren::getenv("USE_SSL");
-        bool useSsl = !useSslStr.empty() ? std::stoi(useSslStr) : 1;
+    bool Engine::isBulkLoading() const
+    {
+        return m_bulkLoad.isActive();
+    }
 
-        std::string strTimeout = siren::getenv("THIRDPARTY_API_TIMEOUT_MS");
-        int timeout = !strTimeout.empty() ? std::stoi(strTimeout) : 30000;
+    // a stage that throws skips its own failure paths, which release the claims of the jobs they fail
+    struct ClaimGuard
+    {
+        ~ClaimGuard()
+        {
+            if (std::uncaught_exceptions() > exceptionCount)
+            {
+                abandon();
+            }
+        }
 
-        std::ofstream ofstream(filePath, std::ios::binary);
-        const HttpResponse& res = RequestManager::DownloadFile(url, ofstream, timeout, useSsl);
+        std::function<void()> abandon;
+        int exceptionCount{std::uncaught_exceptions()};
+    };
 
-        if (res.status_code == 0)
+    void Engine::abandonLoad(SongIdType songId)
+    {
+        try
+        {
+            discardLoad(songId);
+        }
+        catch (const std::exception& ex)
+        {
+            // the claim is left to time out
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, std::string("Failed to release an abandoned claim: ") + ex.what());
+        }
+    }
+
+    bool Engine::discardLoad(SongIdType songId)
+    {
+        if (m_bulkLoad.isIndexMissing())
+        {
+            // purging by hash would scan the table, the song is deleted like any other and compaction waits for the index
+            if (!m_registry.markDeleting(songId))
+            {
+                return false;
+            }
+            m_tombstones.add(songId);
+            return true;
+        }
+        // rows written before the failure must not outlive the claim
+        if (!purgeTrackFingerprintFromPrimary(songId))
         {
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, res.error.message);
             return false;
         }
-        if (res.status_code >= 400)
+        m_registry.release(songId);
+        return true;
+    }
+
+    bool Engine::downloadTrack(IngestionJob& job)
+    {
+        ClaimGuard guard{[this, &job] { abandonLoad(job.songId); }};
+        // the track is kept in memory, the core reads it through its descriptor and nothing is left behind on disk
+        if (!job.track.open("track-" + std::to_string(job.songId)))
+        {
+            job.error = "Failed to create an in-memory file for the track";
+            m_registry.release(job.songId);
+            return false;
+        }
+
+        DownloadSink sink{
+            [&job](size_t size) { return job.track.reserve(size); },
+            [&job](size_t offset, std::string_view chunk) { return job.track.writeAt(offset, chunk); }
+        };
+        HttpResponse res = RequestManager::DownloadFile(job.url, sink, m_downloadPolicy);
+
+        if (res.status_code == 0 || res.status_code >= 400)
         {
             std::stringstream err;
-            err << "Error ["<< res.status_code <<"] making request: " << res.text;
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, err.str());
+            if (res.status_code == 0)
+            {
+                err << res.error.message;
+            }
+            else
+            {
+                err << "Error [" << res.status_code << "] making request: " << res.text;
+            }
+            job.error = err.str();
+            job.track.close();
+            m_registry.release(job.songId);
             return false;
         }
+        return true;
+    }
 
-        const CoreReturnType& coreResult = m_sirenCore->make_fingerprint(filePath);
+    bool Engine::fingerprintTrack(IngestionJob& job)
+    {
+        ClaimGuard guard{[this, &job] { abandonLoad(job.songId); }};
+        // each worker of the stage fingerprints on a core of its own, held until the result has been copied out of it
+        SirenCorePool::Lease core = m_corePool->acquire();
+        const CoreReturnType& coreResult = core->make_fingerprint(job.track.getPath());
+        // the download is of no use once it has been fingerprinted, or has failed to be
+        job.track.close();
         if (coreResult.code != siren::CoreStatus::OK)
         {
             std::stringstream err;
             err << "Could not fingerprint the track, status: " << (int)coreResult.code;
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, err.str());
+            job.error = err.str();
+            m_registry.release(job.songId);
             return false;
         }
 
         std::stringstream msg;
-        msg << "Created a fingerprint of size " << coreResult.fingerprint.get_size() << " for track with id " << songId;
+        msg << "Created a fingerprint of size " << coreResult.fingerprint.get_size() << " for track with id " << job.songId;
         Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
 
-        {
-            AsyncManager::instance().submitTask([this, fpt = coreResult.fingerprint, songId] {
-                 markAsyncStart();
-                 if (!loadFingerprintIntoPrimary(fpt, songId))
-                 {
-                     Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to load fingerprint into primary");
-                 }
-                 markAsyncEnd();
-            });
+        job.fingerprint = std::make_shared<const FingerprintType>(coreResult.fingerprint);
+        return true;
+    }
 
-            if (!isCaching)
+    std::vector<bool> Engine::storeTracks(const std::vector<IngestionJob*>& jobs)
+    {
+        std::vector<bool> results(jobs.size(), false);
+        // a job that has failed says why, one that is stored has its result, every other one is still ours to give up
+        ClaimGuard guard{[this, &jobs, &results] {
+            for (size_t i = 0; i < jobs.size(); i++)
             {
-                return true;
+                if (!results[i] && jobs[i]->error.empty())
+                {
+                    abandonLoad(jobs[i]->songId);
+                }
             }
-
-            AsyncManager::instance().submitTask([this, fpt = coreResult.fingerprint, songId] {
-                markAsyncStart();
-                if (!loadFingerprintIntoCache(fpt, songId))
+        }};
+        // indices of the jobs whose rows are written
+        std::vector<size_t> loading;
+        std::vector<JournalEntry> entries;
+        std::vector<SongIdType> settled;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            IngestionJob* job = jobs[i];
+            if (!job->isRecovered)
+            {
+                if (!m_registry.advance(job->songId, SongState::Claimed, SongState::Loading))
                 {
-                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to load fingerprint into cache");
+                    job->error = "The claim has expired and was taken over";
+                    continue;
                 }
-                markAsyncEnd();
-            });
+                entries.push_back(JournalEntry{job->songId, job->isCaching, job->fingerprint});
+            }
+            // a replayed song is still loading, and part of its rows may have been written before the crash
+            else if (!m_registry.advance(job->songId, SongState::Loading, SongState::Loading))
+            {
+                job->error = "The song was deleted or taken over before its write was replayed";
+                settled.push_back(job->songId);
+                continue;
+            }
+            // without fp_index the rows are written again as they are, the copies are dropped when the index is rebuilt
+            else if (!m_bulkLoad.isIndexMissing() && !purgeTrackFingerprintFromPrimary(job->songId))
+            {
+                job->error = "Failed to clear the rows of an interrupted write";
+                continue;
+            }
+            loading.push_back(i);
         }
-        return true;
+
+        // one sync makes the whole batch durable, a crash from here on replays it instead of losing it
+        if (!entries.empty() && m_journal.isOpen() && !m_journal.appendPending(entries))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to journal fingerprints, a crash before they are stored loses them");
+        }
+
+        std::vector<std::pair<SongIdType, const FingerprintType*>> fingerprints;
+        fingerprints.reserve(loading.size());
+        for (size_t i: loading)
+        {
+            fingerprints.emplace_back(jobs[i]->songId, jobs[i]->fingerprint.get());
+        }
+
+        // the batch is a single transaction, once it fails the songs are written one by one so a bad one fails alone
+        bool isBatchStored = loading.size() > 1 && loadFingerprintsIntoPrimary(fingerprints);
+        std::vector<std::pair<SongIdType, const FingerprintType*>> toCache;
+        for (size_t i = 0; i < loading.size(); i++)
+        {
+            IngestionJob& job = *jobs[loading[i]];
+            SongIdType songId = job.songId;
+            settled.push_back(songId);
+            if (!isBatchStored && !loadFingerprintsIntoPrimary({fingerprints[i]}))
+            {
+                job.error = "Failed to load fingerprint into primary";
+                discardLoad(songId);
+                continue;
+            }
+            if (!m_registry.advance(songId, SongState::Loading, SongState::Ready))
+            {
+                job.error = "Song was deleted while it was being loaded";
+                continue;
+            }
+            results[loading[i]] = true;
+
+            // a full cache only makes room for songs that have been asked for, it will be promoted once it is
+            if (job.isCaching && m_cacheManager.admit(songId, job.fingerprint->get_size()))
+            {
+                toCache.push_back(fingerprints[i]);
+            }
+        }
+        if (!settled.empty() && m_journal.isOpen())
+        {
+            m_journal.appendDone(settled);
+        }
+
+        // the songs can be found through primary storage from here on, a failure to cache them does not fail the jobs
+        bool isCached = toCache.empty() || loadFingerprintsIntoCache(toCache);
+        if (!isCached)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to load fingerprints into cache");
+        }
+        for (const auto& [songId, fingerprint]: toCache)
+        {
+            if (isCached)
+            {
+                m_cacheManager.commit(songId);
+            }
+            else
+            {
+                m_cacheManager.revoke(songId);
+            }
+        }
+        evictFromCache(m_cacheManager.takeEvictions());
+        return results;
     }
 
-    bool Engine::purgeTrackFingerprintFromCache(SongIdType songId)
+    void Engine::replayJournal()
     {
-        std::stringstream stream;
+        std::string path = siren::getenv("INGESTION_JOURNAL_PATH");
+        if (path.empty())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "INGESTION_JOURNAL_PATH is not set, fingerprints are lost if the process dies before they are stored");
+            return;
+        }
+
+        std::vector<JournalEntry> recovered;
+        if (!m_journal.open(path, recovered))
+        {
+            return;
+        }
+        for (auto& entry: recovered)
+        {
+            IngestionJob job{0, {}, entry.songId, entry.isCaching};
+            job.fingerprint = std::move(entry.fingerprint);
+            job.isRecovered = true;
+            m_ingestion.resume(std::move(job), IngestionStage::Store);
+        }
+    }
+
+    bool Engine::purgeTrackFingerprintFromCache(const std::vector<SongIdType>& songIds)
+    {
+        // documents are routed by song, only the shards holding these songs are searched
+        std::stringstream stream, lucene;
         Query query;
 
-        stream << R"({"query": {"term": {"song_id": )" << songId << "}}}";
+        lucene << "fingerprint/_delete_by_query?routing=";
+        stream << R"({"query": {"terms": {"song_id": [)";
+        for (size_t i = 0; i < songIds.size(); i++)
+        {
+            lucene << (i ? "," : "") << songIds[i];
+            stream << (i ? "," : "") << songIds[i];
+        }
+        stream << "]}}}";
 
-        query.emplace("lucene", "fingerprint/_delete_by_query");
+        query.emplace("lucene", lucene.str());
         query.emplace("query", stream.str());
         query.emplace("request_type", "POST");
 
@@ -544,53 +1203,158 @@ namespace siren::cloud
 
     bool Engine::purgeTrackFingerprintFromPrimary(SongIdType songId)
     {
+        // both statements run in one transaction, the rows are found through the manifest rather than by scanning
         std::stringstream sql;
-        Query query;
+        QueryCollection queries;
 
-        sql << "DELETE FROM fingerprint WHERE song_id=" << songId;
-        query.emplace("query", sql.str());
+        Query fingerprintQuery;
+        sql << "DELETE FROM fingerprint f USING song_manifest m "
+            << "WHERE m.song_id = " << songId << " AND f.song_id = m.song_id AND f.hash = m.hash";
+        fingerprintQuery.emplace("query", sql.str());
+        queries.insertQuery(std::move(fingerprintQuery));
+
+        sql.clear();
+        sql.str({});
+
+        Query manifestQuery;
+        sql << "DELETE FROM song_manifest WHERE song_id = " << songId;
+        manifestQuery.emplace("query", sql.str());
+        queries.insertQuery(std::move(manifestQuery));
 
         DBConnectionPtr connection = m_primaryPool->getConnection();
-        DBCommandPtr command = connection->createCommand(std::move(query));
+        DBCommandPtr command = connection->createCommand(std::move(queries));
 
         bool isSuccess = command->execute();
-        m_cachePool->releaseConnection(std::move(connection));
+        m_primaryPool->releaseConnection(std::move(connection));
         return isSuccess;
     }
 
     bool Engine::purgeFingerprintBySongId(SongIdType songId)
     {
-        bool isPostgresSuccess = false;
-        bool isElasticSuccess = false;
+        return coro::syncWait(purgeFingerprintBySongIdAsync(songId));
+    }
+
+    coro::Task<bool> Engine::purgeFingerprintBySongIdAsync(SongIdType songId)
+    {
+        // the id stays taken and the song hidden from lookups until compaction has removed its rows
+        bool isMarked = co_await runOnPool(TaskPriority::Maintenance, [this, songId] {
+            return m_registry.markDeleting(songId);
+        });
+        if (!isMarked)
         {
-            WaitableFuture postgresFuture = AsyncManager::instance().submitTask([&]{
-                markAsyncStart();
-                isPostgresSuccess = purgeTrackFingerprintFromPrimary(songId);
-                markAsyncEnd();
-                if (!isPostgresSuccess)
+            co_return false;
+        }
+        m_tombstones.add(songId);
+        m_cacheManager.forget(songId);
+        m_resultCache.evictSong(songId);
+        co_return true;
+    }
+
+    coro::Task<void> Engine::compactAsync()
+    {
+        while (true)
+        {
+            co_await AsyncManager::instance().scheduleAfter(m_compactionPolicy.interval, TaskPriority::Maintenance);
+            if (m_stopping.isCancelled())
+            {
+                co_return;
+            }
+
+            try
+            {
+                bool isSuccess = false;
+                std::vector<SongIdType> songIds = refreshTombstones(isSuccess);
+
+                // deleting rows is heavy on both tiers, it waits until serving lookups leaves room for it and fp_index is back
+                const AdmissionController& admission = AdmissionController::instance();
+                if (!isSuccess || songIds.empty() || m_bulkLoad.isIndexMissing()
+                    || admission.getInFlightCount() > admission.getLimit() * m_compactionPolicy.maxLoad)
                 {
-                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to delete fingerprint from primary");
+                    continue;
                 }
-            }, true);
 
-            WaitableFuture elasticFuture = AsyncManager::instance().submitTask([&]{
-                markAsyncStart();
-                isElasticSuccess = purgeTrackFingerprintFromCache(songId);
-                markAsyncEnd();
-                if (!isElasticSuccess)
+                size_t removedCount = 0;
+                for (size_t i = 0; i < std::min(songIds.size(), m_compactionPolicy.batchSize) && !m_stopping.isCancelled(); i++)
                 {
-                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to delete fingerprint from cache");
+                    if (co_await removeDeletedSongAsync(songIds[i]))
+                    {
+                        removedCount++;
+                    }
                 }
-            }, true);
+
+                std::stringstream msg;
+                msg << "Compaction removed " << removedCount << " of " << songIds.size() << " deleted songs from storage";
+                Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+            }
+            catch (const std::exception& ex)
+            {
+                // the next pass starts over from the registry
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, std::string("Compaction pass failed: ") + ex.what());
+            }
         }
-        return isPostgresSuccess && isElasticSuccess;
     }
 
-    bool Engine::isSongIdValid(SongIdType songId)
+    std::vector<SongIdType> Engine::refreshTombstones(bool& isSuccess)
     {
-        bool primaryCheck;
-        bool isPrimaryOk = isSongIdInPrimary(primaryCheck, songId, true);
-        return isPrimaryOk && !primaryCheck;
+        // songs deleted by other processes are picked up here, and songs compacted by them are let go
+        uint64_t generation = m_tombstones.beginRefresh();
+        std::unordered_set<SongIdType> deleting = m_registry.getDeleting(isSuccess);
+        if (!isSuccess)
+        {
+            return {};
+        }
+        std::vector<SongIdType> songIds(deleting.begin(), deleting.end());
+        auto previous = m_tombstones.getSnapshot();
+        m_tombstones.completeRefresh(generation, std::move(deleting));
+
+        // hits remembered before the delete are only hidden by the tombstone, they must not outlive it
+        auto current = m_tombstones.getSnapshot();
+        for (SongIdType songId: *previous)
+        {
+            if (!current->contains(songId))
+            {
+                m_resultCache.evictSong(songId);
+            }
+        }
+        return songIds;
+    }
+
+    coro::Task<bool> Engine::removeDeletedSongAsync(SongIdType songId)
+    {
+        std::vector<coro::Task<bool>> purges;
+        purges.emplace_back(runOnPool(TaskPriority::Maintenance, [this, songId] {
+            if (!purgeTrackFingerprintFromPrimary(songId))
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to delete fingerprint from primary");
+                return false;
+            }
+            return true;
+        }));
+        purges.emplace_back(runOnPool(TaskPriority::Maintenance, [this, songId] {
+            if (!purgeTrackFingerprintFromCache({songId}))
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to delete fingerprint from cache");
+                return false;
+            }
+            return true;
+        }));
+
+        auto results = co_await coro::whenAll(std::move(purges));
+        if (!results[0] || !results[1])
+        {
+            co_return false;
+        }
+        m_cacheManager.forget(songId);
+        bool isReleased = co_await runOnPool(TaskPriority::Maintenance, [this, songId] {
+            return m_registry.release(songId);
+        });
+        if (isReleased)
+        {
+            // a lookup that was already running when the song was deleted may have remembered a hit since
+            m_resultCache.evictSong(songId);
+            m_tombstones.remove(songId);
+        }
+        co_return isReleased;
     }
 
 }// namespace siren::cloud
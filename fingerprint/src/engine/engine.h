@@ -1,8 +1,24 @@
 #pragma once
 
 #include <siren_core/src/siren.h>
+#include "../common/latency_tracker.h"
+#include "../common/ranged_downloader.h"
 #include "../histogram/histogram.h"
+#include "../ingestion/ingestion_journal.h"
+#include "../ingestion/ingestion_manager.h"
+#include "../ingestion/siren_core_pool.h"
+#include "bulk_load_controller.h"
+#include "cache_manager.h"
+#include "find_result_cache.h"
+#include "promotion_manager.h"
+#include "song_registry.h"
+#include "tombstone_set.h"
 #include "../storage/connection_pool.h"
+#include "../thread_pool/coro/async_scope.h"
+#include "../thread_pool/coro/timed_event.h"
+#include "../thread_pool/primitives/cancellation.h"
+#include "../thread_pool/primitives/priority.h"
+#include <functional>
 
 namespace siren_core
 {
@@ -11,8 +27,6 @@ namespace siren_core
 
 namespace siren::cloud
 {
-    using SirenCorePtr = std::shared_ptr<siren::SirenCore>;
-
     struct EngineParameters
     {
         EngineParameters();
@@ -21,36 +35,133 @@ namespace siren::cloud
         std::string elasticConnString;
     };
 
+    enum class TierMode
+    {
+        // primary storage is asked only once the cache could not tell the song
+        Sequential,
+        // primary storage is asked once the cache has taken longer than it usually does
+        Hedged,
+        // both tiers are asked right away
+        Parallel
+    };
+
+    struct TierPolicy
+    {
+        TierPolicy();
+
+        TierMode mode{TierMode::Sequential};
+        // lower bound of the hedge delay and its value until enough cache latencies have been seen
+        std::chrono::milliseconds minHedgeDelay{20};
+        // percentile of recent cache latencies used as the hedge delay
+        double hedgePercentile{0.95};
+        // share of recent cache lookups that missed above which a lookup is expected to miss and is not delayed
+        double predictedMissRate{0.5};
+    };
+
+    struct CompactionPolicy
+    {
+        CompactionPolicy();
+
+        // how often deleted songs are looked for, and the tombstones of other processes picked up
+        std::chrono::milliseconds interval{5000};
+        // songs removed from storage per pass
+        size_t batchSize{4};
+        // share of the admission limit in flight above which a pass is skipped, leaving deletes for a quieter moment
+        double maxLoad{0.5};
+    };
+
+    enum class LoadSubmission
+    {
+        Accepted,
+        AlreadyLoaded,
+        // the ingestion queue is full
+        Overloaded,
+        Failed
+    };
+
     class Engine
     {
     public:
-        explicit Engine(const DBConnectionPoolPtr& primaryPool, const DBConnectionPoolPtr& cachePool, const SirenCorePtr& corePtr);
+        explicit Engine(const DBConnectionPoolPtr& primaryPool, const DBConnectionPoolPtr& cachePool, const SirenCorePoolPtr& corePool);
         ~Engine();
-        HistReturnType findSongIdByFingerprint(bool& isSuccess, FingerprintType&& fingerprint);
-        bool loadTrackByUrl(const std::string& url, SongIdType songId, bool isCaching=true);
+        HistReturnType findSongIdByFingerprint(bool& isSuccess, FingerprintType&& fingerprint, const CancellationToken& cancellation={});
         bool purgeFingerprintBySongId(SongIdType songId);
+        // claims the song and queues its load, jobId is set once the load is accepted
+        LoadSubmission submitLoad(JobIdType& jobId, std::string url, SongIdType songId, bool isCaching=true);
+        std::optional<JobStatus> getLoadStatus(JobIdType jobId) const;
+        // leaving fills in the report, and fails without leaving when fp_index cannot be rebuilt
+        bool setBulkLoadMode(bool isEnabled, BulkLoadReport& report);
+        bool isBulkLoading() const;
+
+        // the token bounds every storage call made on behalf of the request and stops the lookup once it is cancelled
+        coro::Task<FindResult> findSongIdByFingerprintAsync(FingerprintType fingerprint, CancellationToken cancellation={});
+        coro::Task<bool> purgeFingerprintBySongIdAsync(SongIdType songId);
+
+        // background work that must finish before the engine is destroyed
+        template <typename T>
+        void spawn(coro::Task<T>&& task)
+        {
+            m_scope.spawn(std::move(task));
+        }
 
     private:
-        bool isSongIdValid(SongIdType songId);
-        bool isSongIdInCache(bool& exists, SongIdType songId);
-        bool isSongIdInPrimary(bool& exists, SongIdType songId, bool shouldClaim=false);
-        bool cacheFingerprintBySongId(SongIdType songId);
-        bool loadFingerprintIntoPrimary(const FingerprintType& fingerprint, SongIdType songId);
-        bool loadFingerprintIntoCache(const FingerprintType& fingerprint, SongIdType songId);
+        std::vector<SongIdType> findSongIdsMissingFromCache(bool& isSuccess, const std::vector<SongIdType>& songIds);
+        bool cacheFingerprintsBySongIds(const std::vector<SongIdType>& songIds);
+        bool restoreCacheResidents();
+        bool evictFromCache(const std::vector<SongIdType>& songIds);
+        // gives up the claim of a load its stage threw on, nothing it had written is left behind
+        void abandonLoad(SongIdType songId);
+        // without fp_index the rows of a failed load are left to compaction, the song stays hidden until then
+        bool discardLoad(SongIdType songId);
+        bool downloadTrack(IngestionJob& job);
+        bool fingerprintTrack(IngestionJob& job);
+        std::vector<bool> storeTracks(const std::vector<IngestionJob*>& jobs);
+        void replayJournal();
+        bool loadFingerprintsIntoPrimary(const std::vector<std::pair<SongIdType, const FingerprintType*>>& fingerprints);
+        bool loadFingerprintsIntoCache(const std::vector<std::pair<SongIdType, const FingerprintType*>>& fingerprints);
         bool purgeTrackFingerprintFromPrimary(SongIdType songId);
-        bool purgeTrackFingerprintFromCache(SongIdType songId);
-        DBCommandPtr fetchFingerprintsFromCache(bool& isSuccess, const FingerprintType& snippet);
-        DBCommandPtr fetchFingerprintsFromPrimary(bool& isSuccess, const FingerprintType& snippet);
-        void markAsyncStart();
-        void markAsyncEnd();
+        bool purgeTrackFingerprintFromCache(const std::vector<SongIdType>& songIds);
+        coro::Task<DBCommandPtr> fetchFingerprintsFromCacheAsync(const FingerprintType& snippet, const CancellationToken& cancellation);
+        coro::Task<DBCommandPtr> fetchFingerprintsFromPrimaryAsync(const FingerprintType& snippet, const CancellationToken& cancellation);
+        coro::Task<FindResult> findInTiersAsync(FingerprintType fingerprint, CancellationToken cancellation);
+        coro::Task<FindResult> findInCacheAsync(const FingerprintType& snippet, CancellationToken cancellation);
+        coro::Task<FindResult> findInPrimaryAsync(const FingerprintType& snippet, CancellationToken cancellation);
+        coro::Task<FindResult> findSequentiallyAsync(FingerprintType fingerprint, CancellationToken cancellation);
+        coro::Task<FindResult> raceTiersAsync(FingerprintType fingerprint, CancellationToken cancellation);
+        coro::Task<FindResult> raceCacheTierAsync(std::shared_ptr<const FingerprintType> snippet, CancellationToken cancellation,
+                                                  coro::TimedEvent isDone);
+        coro::Task<FindResult> racePrimaryTierAsync(std::shared_ptr<const FingerprintType> snippet, CancellationToken cancellation,
+                                                    std::chrono::milliseconds delay, std::shared_ptr<std::atomic<bool>> isShed,
+                                                    coro::TimedEvent isCacheDone);
+        std::chrono::milliseconds getHedgeDelay() const;
+        void recordCacheOutcome(bool isHit);
+        void recordSongAccess(const FindResult& result);
+        coro::Task<void> compactAsync();
+        std::vector<SongIdType> refreshTombstones(bool& isSuccess);
+        coro::Task<bool> removeDeletedSongAsync(SongIdType songId);
+        static coro::Task<bool> runOnPool(TaskPriority priority, std::function<bool()> job, CancellationToken cancellation={});
 
     private:
-        std::mutex m_mtx;
-        std::condition_variable m_cv;
-        std::atomic<int64_t> m_asyncCount{0};
-        SirenCorePtr m_sirenCore;
+        SirenCorePoolPtr m_corePool;
         DBConnectionPoolPtr m_primaryPool;
         DBConnectionPoolPtr m_cachePool;
+        SongRegistry m_registry;
+        BulkLoadController m_bulkLoad;
+        // the store batch size outside of bulk loads
+        size_t m_storeBatchSize{1};
+        CacheManager m_cacheManager;
+        TombstoneSet m_tombstones;
+        CompactionPolicy m_compactionPolicy;
+        DownloadPolicy m_downloadPolicy;
+        CancellationToken m_stopping;
+        IngestionJournal m_journal;
+        IngestionManager m_ingestion;
+        PromotionManager m_promotions;
+        TierPolicy m_tierPolicy;
+        FindResultCache m_resultCache;
+        LatencyTracker m_cacheLatency;
+        std::atomic<double> m_cacheMissRate{0};
+        coro::AsyncScope m_scope;
     };
 
     using EnginePtr = std::shared_ptr<Engine>;
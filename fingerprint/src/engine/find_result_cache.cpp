@@ -0,0 +1,192 @@
+#include "find_result_cache.h"
+#include <algorithm>
+#include "../common/common.h"
+#include "../thread_pool/async_manager.h"
+
+namespace siren::cloud
+{
+    FindCachePolicy::FindCachePolicy()
+    {
+        std::string capacityStr = siren::getenv("FIND_CACHE_CAPACITY");
+        if (!capacityStr.empty())
+        {
+            capacity = std::stoul(capacityStr);
+        }
+
+        std::string ttlStr = siren::getenv("FIND_CACHE_TTL_MS");
+        if (!ttlStr.empty())
+        {
+            ttl = std::chrono::milliseconds(std::stoul(ttlStr));
+        }
+
+        std::string uncertainTtlStr = siren::getenv("FIND_CACHE_UNCERTAIN_TTL_MS");
+        if (!uncertainTtlStr.empty())
+        {
+            uncertainTtl = std::chrono::milliseconds(std::stoul(uncertainTtlStr));
+        }
+
+        std::string joinPollIntervalStr = siren::getenv("FIND_CACHE_JOIN_POLL_MS");
+        if (!joinPollIntervalStr.empty())
+        {
+            joinPollInterval = std::chrono::milliseconds(std::stoul(joinPollIntervalStr));
+        }
+    }
+
+    FindResultCache::FindResultCache(const FindCachePolicy& policy)
+        : m_policy(policy)
+    {
+    }
+
+    FindResultCache::Digest FindResultCache::makeDigest(const FingerprintType& snippet)
+    {
+        std::vector<HashType> hashes;
+        hashes.reserve(snippet.get_size());
+        for (auto it = snippet.cbegin(); it != snippet.cend(); it++)
+        {
+            hashes.push_back(it->first);
+        }
+        std::sort(hashes.begin(), hashes.end());
+        hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+        Digest digest = mixBits(hashes.size());
+        for (HashType hash: hashes)
+        {
+            digest = mixBits(digest ^ mixBits(hash));
+        }
+        return digest;
+    }
+
+    std::optional<FindResult> FindResultCache::lookup(Digest digest)
+    {
+        std::lock_guard lock(m_mtx);
+        auto it = m_entries.find(digest);
+        if (it == m_entries.end())
+        {
+            return std::nullopt;
+        }
+        if (it->second.expiresAt <= Clock::now())
+        {
+            m_recency.erase(it->second.position);
+            m_entries.erase(it);
+            return std::nullopt;
+        }
+        m_recency.splice(m_recency.begin(), m_recency, it->second.position);
+        return it->second.result;
+    }
+
+    FindResultCache::FlightPtr FindResultCache::join(Digest digest, bool& isLeader)
+    {
+        std::lock_guard lock(m_mtx);
+        auto [it, isInserted] = m_flights.try_emplace(digest);
+        if (isInserted)
+        {
+            it->second = std::make_shared<Flight>();
+        }
+        isLeader = isInserted;
+        return it->second;
+    }
+
+    void FindResultCache::complete(Digest digest, const FlightPtr& flight, const FindResult& result, bool isCacheable)
+    {
+        {
+            std::lock_guard lock(m_mtx);
+            m_flights.erase(digest);
+            if (isCacheable)
+            {
+                store(digest, result);
+            }
+        }
+
+        std::vector<WaiterPtr> waiters;
+        {
+            std::lock_guard lock(flight->m_mtx);
+            flight->m_result.emplace(result);
+            waiters.swap(flight->m_waiters);
+        }
+        for (const auto& waiter: waiters)
+        {
+            // a waiter that gave up has already been resumed and may be gone
+            if (!waiter->isClaimed.exchange(true))
+            {
+                waiter->handle.resume();
+            }
+        }
+    }
+
+    void FindResultCache::evictSong(SongIdType songId)
+    {
+        // deletes are rare enough for a scan, an index by song would cost every lookup instead
+        std::lock_guard lock(m_mtx);
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            if (it->second.result.isSuccess && it->second.result.hist.getSongId() == songId)
+            {
+                m_recency.erase(it->second.position);
+                it = m_entries.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    void FindResultCache::watch(WaiterPtr waiter, CancellationToken cancellation, std::chrono::milliseconds pollInterval)
+    {
+        // a check dropped by a full queue only means the waiter stays until the flight completes
+        auto delay = std::min(cancellation.getRemaining(pollInterval), pollInterval);
+        AsyncManager::instance().submitAfter(delay, [waiter, cancellation, pollInterval] {
+            if (waiter->isClaimed)
+            {
+                return;
+            }
+            if (!cancellation.isCancelled())
+            {
+                watch(waiter, cancellation, pollInterval);
+                return;
+            }
+            if (!waiter->isClaimed.exchange(true))
+            {
+                waiter->handle.resume();
+            }
+        }, TaskPriority::Interactive);
+    }
+
+    void FindResultCache::store(Digest digest, const FindResult& result)
+    {
+        if (m_policy.capacity == 0)
+        {
+            return;
+        }
+        auto expiresAt = Clock::now() + (result.isSuccess ? m_policy.ttl : m_policy.uncertainTtl);
+
+        auto it = m_entries.find(digest);
+        if (it != m_entries.end())
+        {
+            it->second.result = result;
+            it->second.expiresAt = expiresAt;
+            m_recency.splice(m_recency.begin(), m_recency, it->second.position);
+            return;
+        }
+
+        m_recency.push_front(digest);
+        m_entries.emplace(digest, Entry{result, expiresAt, m_recency.begin()});
+        while (m_entries.size() > m_policy.capacity)
+        {
+            m_entries.erase(m_recency.back());
+            m_recency.pop_back();
+        }
+    }
+
+    size_t FindResultCache::getSize() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_entries.size();
+    }
+
+    size_t FindResultCache::getInFlightCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_flights.size();
+    }
+}
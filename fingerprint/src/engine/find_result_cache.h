@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "../histogram/histogram.h"
+#include "../thread_pool/primitives/cancellation.h"
+
+namespace siren::cloud
+{
+    struct FindResult
+    {
+        bool isSuccess;
+        HistReturnType hist;
+        // the cache missed and the primary storage fallback was skipped because the server is overloaded
+        bool isShed{false};
+        // storage could not be queried, so the outcome says nothing about the snippet itself
+        bool isFailed{false};
+    };
+
+    struct FindCachePolicy
+    {
+        FindCachePolicy();
+
+        // number of snippets remembered, 0 turns result caching off while still coalescing identical lookups
+        size_t capacity{10000};
+        std::chrono::milliseconds ttl{30000};
+        // uncertain outcomes are kept briefly, a snippet that missed may match once its song gets promoted
+        std::chrono::milliseconds uncertainTtl{2000};
+        // how often a request waiting on someone else's lookup checks whether it has been cancelled itself
+        std::chrono::milliseconds joinPollInterval{50};
+    };
+
+    /*
+     * Remembers recent find outcomes by a digest of the snippet's hash set, evicting the least recently used one,
+     * and coalesces identical lookups in flight so that only the first of them reaches storage.
+     */
+    class FindResultCache
+    {
+    public:
+        using Digest = uint64_t;
+        using Clock = std::chrono::steady_clock;
+
+        // a request suspended on a flight, resumed by whoever claims it first, the flight or its own cancellation
+        struct Waiter
+        {
+            std::coroutine_handle<> handle;
+            std::atomic<bool> isClaimed{false};
+        };
+
+        using WaiterPtr = std::shared_ptr<Waiter>;
+
+        // one lookup shared by every request for the same snippet that arrives while it is running
+        class Flight
+        {
+        private:
+            friend class FindResultCache;
+
+            std::mutex m_mtx;
+            std::optional<FindResult> m_result;
+            std::vector<WaiterPtr> m_waiters;
+        };
+
+        using FlightPtr = std::shared_ptr<Flight>;
+
+        explicit FindResultCache(const FindCachePolicy& policy = {});
+
+        // the digest ignores the order of hashes and duplicates among them
+        static Digest makeDigest(const FingerprintType& snippet);
+
+        std::optional<FindResult> lookup(Digest digest);
+
+        // the caller becomes the leader when nobody else is looking the snippet up, the leader must complete the flight
+        FlightPtr join(Digest digest, bool& isLeader);
+
+        // hands the result over to every waiter, it is remembered only if it is cacheable
+        void complete(Digest digest, const FlightPtr& flight, const FindResult& result, bool isCacheable);
+
+        // forgets every hit on the song, it has been deleted
+        void evictSong(SongIdType songId);
+
+        // co_await cache.wait(flight, cancellation) resumes on the thread that completed the flight,
+        // or with an uncertain outcome once the caller's own cancellation or deadline has been noticed
+        auto wait(FlightPtr flight, CancellationToken cancellation = {}) const
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return cancellation.isCancelled();
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle)
+                {
+                    // the awaiter is gone as soon as the flight resumes the coroutine, only locals may be touched after that
+                    WaiterPtr shared = waiter;
+                    CancellationToken token = cancellation;
+                    std::chrono::milliseconds interval = pollInterval;
+                    shared->handle = handle;
+                    {
+                        std::lock_guard lock(flight->m_mtx);
+                        if (flight->m_result)
+                        {
+                            return false;
+                        }
+                        flight->m_waiters.push_back(shared);
+                    }
+                    if (token.isCancellable())
+                    {
+                        watch(std::move(shared), std::move(token), interval);
+                    }
+                    return true;
+                }
+
+                FindResult await_resume()
+                {
+                    std::lock_guard lock(flight->m_mtx);
+                    if (!flight->m_result)
+                    {
+                        return FindResult{false, HistReturnType{HistStatus::Uncertain}};
+                    }
+                    return *flight->m_result;
+                }
+
+                FlightPtr flight;
+                CancellationToken cancellation;
+                std::chrono::milliseconds pollInterval;
+                WaiterPtr waiter;
+            };
+            return Awaiter{std::move(flight), std::move(cancellation), m_policy.joinPollInterval, std::make_shared<Waiter>()};
+        }
+
+        size_t getSize() const;
+        size_t getInFlightCount() const;
+
+    private:
+        void store(Digest digest, const FindResult& result);
+        // checks the waiter's cancellation every poll interval until either it or the flight has claimed the waiter
+        static void watch(WaiterPtr waiter, CancellationToken cancellation, std::chrono::milliseconds pollInterval);
+
+        struct Entry
+        {
+            FindResult result;
+            Clock::time_point expiresAt;
+            std::list<Digest>::iterator position;
+        };
+
+    private:
+        FindCachePolicy m_policy;
+        mutable std::mutex m_mtx;
+        std::unordered_map<Digest, Entry> m_entries;
+        // most recently used first
+        std::list<Digest> m_recency;
+        std::unordered_map<Digest, FlightPtr> m_flights;
+    };
+}
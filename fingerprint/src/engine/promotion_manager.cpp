@@ -0,0 +1,162 @@
+#include "promotion_manager.h"
+#include "../thread_pool/async_manager.h"
+#include "../logger/logger.h"
+
+namespace siren::cloud
+{
+    PromotionPolicy::PromotionPolicy()
+    {
+        std::string batchSizeStr = siren::getenv("PROMOTION_BATCH_SIZE");
+        if (!batchSizeStr.empty())
+        {
+            batchSize = std::max<size_t>(std::stoul(batchSizeStr), 1);
+        }
+
+        std::string batchDelayStr = siren::getenv("PROMOTION_BATCH_DELAY_MS");
+        if (!batchDelayStr.empty())
+        {
+            batchDelay = std::chrono::milliseconds(std::stoul(batchDelayStr));
+        }
+
+        std::string cooldownStr = siren::getenv("PROMOTION_COOLDOWN_MS");
+        if (!cooldownStr.empty())
+        {
+            cooldown = std::chrono::milliseconds(std::stoul(cooldownStr));
+        }
+
+        std::string failureBackoffStr = siren::getenv("PROMOTION_FAILURE_BACKOFF_MS");
+        if (!failureBackoffStr.empty())
+        {
+            failureBackoff = std::chrono::milliseconds(std::stoul(failureBackoffStr));
+        }
+
+        std::string maxFailureBackoffStr = siren::getenv("PROMOTION_MAX_FAILURE_BACKOFF_MS");
+        if (!maxFailureBackoffStr.empty())
+        {
+            maxFailureBackoff = std::chrono::milliseconds(std::stoul(maxFailureBackoffStr));
+        }
+    }
+
+    PromotionManager::PromotionManager(Promoter promoter, const PromotionPolicy& policy)
+        : m_promoter(std::move(promoter))
+        , m_policy(policy)
+    {
+    }
+
+    PromotionManager::~PromotionManager()
+    {
+        join();
+    }
+
+    bool PromotionManager::request(SongIdType songId)
+    {
+        std::optional<std::chrono::milliseconds> flushDelay;
+        {
+            std::lock_guard lock(m_mtx);
+            auto cooldown = m_cooldown.find(songId);
+            if (cooldown != m_cooldown.end())
+            {
+                if (cooldown->second > Clock::now())
+                {
+                    return false;
+                }
+                m_cooldown.erase(cooldown);
+            }
+            if (!m_pending.insert(songId).second)
+            {
+                return false;
+            }
+            m_queue.push_back(songId);
+            flushDelay = takeFlushDelay();
+        }
+        // the flush may run inline when the pool refuses it, so it must not be started under the lock
+        if (flushDelay)
+        {
+            m_scope.spawn(flushAfter(*flushDelay));
+        }
+        return true;
+    }
+
+    std::optional<std::chrono::milliseconds> PromotionManager::takeFlushDelay()
+    {
+        if (!m_isFlushScheduled)
+        {
+            m_isFlushScheduled = true;
+            return m_queue.size() >= m_policy.batchSize ? std::chrono::milliseconds{0} : m_policy.batchDelay;
+        }
+        // a full batch has no reason to wait for the flush already scheduled
+        if (m_queue.size() == m_policy.batchSize)
+        {
+            return std::chrono::milliseconds{0};
+        }
+        return std::nullopt;
+    }
+
+    coro::Task<void> PromotionManager::flushAfter(std::chrono::milliseconds delay)
+    {
+        co_await AsyncManager::instance().scheduleAfter(delay, TaskPriority::Background);
+
+        std::vector<SongIdType> songIds;
+        {
+            std::lock_guard lock(m_mtx);
+            // an earlier flush may have taken everything already
+            if (m_queue.empty())
+            {
+                co_return;
+            }
+            m_isFlushScheduled = false;
+            songIds.assign(m_queue.begin(), m_queue.end());
+            m_queue.clear();
+        }
+
+        for (size_t i = 0; i < songIds.size(); i += m_policy.batchSize)
+        {
+            std::vector<SongIdType> batch(songIds.begin() + i, songIds.begin() + std::min(i + m_policy.batchSize, songIds.size()));
+            bool isSuccess = m_promoter(batch);
+            if (!isSuccess)
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to promote a batch of " + std::to_string(batch.size()) + " songs");
+            }
+
+            std::lock_guard lock(m_mtx);
+            auto now = Clock::now();
+            std::erase_if(m_cooldown, [now](const auto& entry) { return entry.second <= now; });
+            std::erase_if(m_failures, [this, now](const auto& entry) { return entry.second.lastFailedAt + m_policy.maxFailureBackoff <= now; });
+            for (SongIdType songId: batch)
+            {
+                m_pending.erase(songId);
+                m_cooldown.emplace(songId, recordOutcome(songId, isSuccess, now));
+            }
+        }
+    }
+
+    PromotionManager::Clock::time_point PromotionManager::recordOutcome(SongIdType songId, bool isSuccess, Clock::time_point now)
+    {
+        if (isSuccess)
+        {
+            m_failures.erase(songId);
+            return now + m_policy.cooldown;
+        }
+        // retrying at once would hammer a cache that is already struggling
+        Failure& failure = m_failures[songId];
+        failure.count++;
+        failure.lastFailedAt = now;
+        auto backoff = m_policy.failureBackoff;
+        for (size_t i = 1; i < failure.count && backoff < m_policy.maxFailureBackoff; i++)
+        {
+            backoff *= 2;
+        }
+        return now + std::min(backoff, m_policy.maxFailureBackoff);
+    }
+
+    void PromotionManager::join()
+    {
+        m_scope.join();
+    }
+
+    size_t PromotionManager::getPendingCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_pending.size();
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../common/common.h"
+#include "../thread_pool/coro/async_scope.h"
+
+namespace siren::cloud
+{
+    struct PromotionPolicy
+    {
+        PromotionPolicy();
+
+        // songs copied into the cache by a single promotion
+        size_t batchSize{16};
+        // how long a requested song waits for others to share its batch
+        std::chrono::milliseconds batchDelay{50};
+        // a promoted song is not promoted again for this long, the cache may not have made it searchable yet
+        std::chrono::milliseconds cooldown{10000};
+        // a song whose promotion failed waits this long before it is tried again, doubled with every further failure
+        std::chrono::milliseconds failureBackoff{1000};
+        std::chrono::milliseconds maxFailureBackoff{60000};
+    };
+
+    /*
+     * Collects songs found in primary storage that should be copied into the cache.
+     * A song is promoted at most once at a time, and songs requested close together share one promotion,
+     * which runs on the pool at background priority.
+     */
+    class PromotionManager
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        // copies the given songs into the cache, returns false if none of them could be copied
+        using Promoter = std::function<bool(const std::vector<SongIdType>&)>;
+
+        explicit PromotionManager(Promoter promoter, const PromotionPolicy& policy = {});
+        ~PromotionManager();
+
+        PromotionManager(const PromotionManager& other) = delete;
+        PromotionManager& operator=(const PromotionManager& other) = delete;
+
+        // false when the song is already queued, being promoted, was promoted recently or is backing off a failure
+        bool request(SongIdType songId);
+
+        // waits for every queued promotion to finish
+        void join();
+
+        size_t getPendingCount() const;
+
+    private:
+        coro::Task<void> flushAfter(std::chrono::milliseconds delay);
+        // decides whether another flush is due, called under the lock
+        std::optional<std::chrono::milliseconds> takeFlushDelay();
+        // records the outcome of a song's promotion and returns when it may be promoted again, called under the lock
+        Clock::time_point recordOutcome(SongIdType songId, bool isSuccess, Clock::time_point now);
+
+    private:
+        Promoter m_promoter;
+        PromotionPolicy m_policy;
+        mutable std::mutex m_mtx;
+        std::deque<SongIdType> m_queue;
+        // queued or being promoted
+        std::unordered_set<SongIdType> m_pending;
+        std::unordered_map<SongIdType, Clock::time_point> m_cooldown;
+        struct Failure
+        {
+            size_t count{0};
+            Clock::time_point lastFailedAt;
+        };
+        // consecutive failures, forgotten once a song has gone the longest backoff without failing again
+        std::unordered_map<SongIdType, Failure> m_failures;
+        bool m_isFlushScheduled{false};
+        coro::AsyncScope m_scope;
+    };
+}
@@ -0,0 +1,175 @@
+#include "song_registry.h"
+#include "../logger/logger.h"
+
+namespace siren::cloud
+{
+    SongRegistryPolicy::SongRegistryPolicy()
+    {
+        std::string claimTimeoutStr = siren::getenv("SONG_CLAIM_TIMEOUT_MS");
+        if (!claimTimeoutStr.empty())
+        {
+            claimTimeout = std::chrono::milliseconds(std::stoul(claimTimeoutStr));
+        }
+
+        std::string mirrorTtlStr = siren::getenv("SONG_REGISTRY_MIRROR_TTL_MS");
+        if (!mirrorTtlStr.empty())
+        {
+            mirrorTtl = std::chrono::milliseconds(std::stoul(mirrorTtlStr));
+        }
+    }
+
+    SongRegistry::SongRegistry(DBConnectionPoolPtr pool, const SongRegistryPolicy& policy)
+        : m_pool(std::move(pool))
+        , m_policy(policy)
+    {
+    }
+
+    bool SongRegistry::claim(bool& isClaimed, SongIdType songId)
+    {
+        if (getMirroredState(songId))
+        {
+            isClaimed = false;
+            return true;
+        }
+
+        // the primary key makes the claim atomic, an abandoned claim is taken over instead of blocking the id forever
+        std::stringstream sql;
+        sql << "INSERT INTO song_registry(song_id, state) VALUES (" << songId << ',' << static_cast<int>(SongState::Claimed) << ") "
+            << "ON CONFLICT (song_id) DO UPDATE SET state = EXCLUDED.state, updated_at = now() "
+            << "WHERE song_registry.state IN (" << static_cast<int>(SongState::Claimed) << ',' << static_cast<int>(SongState::Loading) << ") "
+            << "AND song_registry.updated_at < now() - interval '" << m_policy.claimTimeout.count() << " milliseconds' "
+            << "RETURNING song_id";
+
+        if (!execute(sql.str(), isClaimed))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to claim song id");
+            return false;
+        }
+        if (isClaimed)
+        {
+            mirror(songId, SongState::Claimed);
+        }
+        return true;
+    }
+
+    bool SongRegistry::advance(SongIdType songId, SongState from, SongState to)
+    {
+        std::stringstream sql;
+        sql << "UPDATE song_registry SET state = " << static_cast<int>(to) << ", updated_at = now() "
+            << "WHERE song_id = " << songId << " AND state = " << static_cast<int>(from) << " RETURNING song_id";
+
+        bool isAffected = false;
+        if (!execute(sql.str(), isAffected) || !isAffected)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to move song on to its next state");
+            return false;
+        }
+        mirror(songId, to);
+        return true;
+    }
+
+    bool SongRegistry::markDeleting(SongIdType songId)
+    {
+        std::stringstream sql;
+        sql << "INSERT INTO song_registry(song_id, state) VALUES (" << songId << ',' << static_cast<int>(SongState::Deleting) << ") "
+            << "ON CONFLICT (song_id) DO UPDATE SET state = EXCLUDED.state, updated_at = now() RETURNING song_id";
+
+        bool isAffected = false;
+        if (!execute(sql.str(), isAffected))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to mark song as being deleted");
+            return false;
+        }
+        mirror(songId, SongState::Deleting);
+        return true;
+    }
+
+    std::unordered_set<SongIdType> SongRegistry::getDeleting(bool& isSuccess)
+    {
+        std::stringstream sql;
+        sql << "SELECT song_id FROM song_registry WHERE state = " << static_cast<int>(SongState::Deleting);
+
+        Query query;
+        query.emplace("query", sql.str());
+
+        DBConnectionPtr connection = m_pool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(query));
+        isSuccess = command->execute();
+        m_pool->releaseConnection(std::move(connection));
+        if (!isSuccess)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to fetch songs being deleted");
+            return {};
+        }
+
+        std::unordered_set<SongIdType> songIds;
+        SongIdType songId;
+        while (command->fetchNext())
+        {
+            if (command->asUint64("song_id", songId))
+            {
+                songIds.insert(songId);
+            }
+        }
+        return songIds;
+    }
+
+    bool SongRegistry::release(SongIdType songId)
+    {
+        std::stringstream sql;
+        sql << "DELETE FROM song_registry WHERE song_id = " << songId << " RETURNING song_id";
+
+        bool isAffected = false;
+        if (!execute(sql.str(), isAffected))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to release song id");
+            return false;
+        }
+        mirror(songId, std::nullopt);
+        return true;
+    }
+
+    std::optional<SongState> SongRegistry::getMirroredState(SongIdType songId) const
+    {
+        std::lock_guard lock(m_mtx);
+        auto it = m_mirror.find(songId);
+        if (it == m_mirror.end() || it->second.expiresAt <= Clock::now())
+        {
+            return std::nullopt;
+        }
+        return it->second.state;
+    }
+
+    bool SongRegistry::execute(const std::string& sql, bool& isAffected)
+    {
+        Query query;
+        query.emplace("query", sql);
+
+        DBConnectionPtr connection = m_pool->getConnection();
+        DBCommandPtr command = connection->createCommand(std::move(query));
+        bool isSuccess = command->execute();
+        m_pool->releaseConnection(std::move(connection));
+
+        // RETURNING yields a row only for the rows the statement touched
+        isAffected = isSuccess && !command->isEmpty();
+        return isSuccess;
+    }
+
+    void SongRegistry::mirror(SongIdType songId, std::optional<SongState> state)
+    {
+        std::lock_guard lock(m_mtx);
+        if (!state)
+        {
+            m_mirror.erase(songId);
+            return;
+        }
+
+        auto now = Clock::now();
+        m_mirror.insert_or_assign(songId, MirroredState{*state, now + m_policy.mirrorTtl});
+        if (m_mirror.size() >= m_sweepSize)
+        {
+            std::erase_if(m_mirror, [now](const auto& entry) { return entry.second.expiresAt <= now; });
+            m_sweepSize = std::max<size_t>(1024, 2 * m_mirror.size());
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include "../common/common.h"
+#include "../storage/connection_pool.h"
+
+namespace siren::cloud
+{
+    // values are stored in the state column of song_registry
+    enum class SongState : int16_t
+    {
+        // the id is taken, nothing has been written yet
+        Claimed = 0,
+        // fingerprint rows are being written into primary storage
+        Loading = 1,
+        Ready = 2,
+        // fingerprint rows are being removed, the id is freed once they are gone
+        Deleting = 3
+    };
+
+    struct SongRegistryPolicy
+    {
+        SongRegistryPolicy();
+
+        // a claim or load that has not moved on for this long is assumed to be abandoned and may be claimed again
+        std::chrono::milliseconds claimTimeout{600000};
+        // how long a state seen by this process is trusted without asking primary storage
+        std::chrono::milliseconds mirrorTtl{60000};
+    };
+
+    /*
+     * Keeps track of which song ids are in use in a table of its own, so that claiming an id neither locks
+     * nor scans the fingerprint table. Recently seen states are mirrored in memory, which lets a claim
+     * of an id known to be taken return without a round trip.
+     */
+    class SongRegistry
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit SongRegistry(DBConnectionPoolPtr pool, const SongRegistryPolicy& policy = {});
+
+        SongRegistry(const SongRegistry& other) = delete;
+        SongRegistry& operator=(const SongRegistry& other) = delete;
+
+        // isClaimed is false when the id is already taken, returns false if primary storage could not be asked
+        bool claim(bool& isClaimed, SongIdType songId);
+        // moves the song on only if it is still in the expected state
+        bool advance(SongIdType songId, SongState from, SongState to);
+        // tombstones the song, an id nothing is known about is tombstoned as well so that it cannot be claimed halfway
+        bool markDeleting(SongIdType songId);
+        // songs marked as being deleted by any process
+        std::unordered_set<SongIdType> getDeleting(bool& isSuccess);
+        // frees the id, after a failed load or once the song is deleted
+        bool release(SongIdType songId);
+
+        std::optional<SongState> getMirroredState(SongIdType songId) const;
+
+    private:
+        bool execute(const std::string& sql, bool& isAffected);
+        void mirror(SongIdType songId, std::optional<SongState> state);
+
+    private:
+        struct MirroredState
+        {
+            SongState state;
+            Clock::time_point expiresAt;
+        };
+
+        DBConnectionPoolPtr m_pool;
+        SongRegistryPolicy m_policy;
+        mutable std::mutex m_mtx;
+        std::unordered_map<SongIdType, MirroredState> m_mirror;
+        // expired entries are dropped once the mirror has grown to this size
+        size_t m_sweepSize{1024};
+    };
+}
@@ -0,0 +1,67 @@
+#include "tombstone_set.h"
+
+namespace siren::cloud
+{
+    TombstoneSet::TombstoneSet()
+        : m_snapshot(std::make_shared<const std::unordered_set<SongIdType>>())
+    {
+    }
+
+    void TombstoneSet::add(SongIdType songId)
+    {
+        std::lock_guard lock(m_mtx);
+        m_recent.insert_or_assign(songId, ++m_generation);
+        if (m_snapshot->contains(songId))
+        {
+            return;
+        }
+        // deletes are rare next to lookups, so copying on write keeps the read side free of locks held for long
+        auto songIds = std::make_shared<std::unordered_set<SongIdType>>(*m_snapshot);
+        songIds->insert(songId);
+        m_snapshot = std::move(songIds);
+    }
+
+    void TombstoneSet::remove(SongIdType songId)
+    {
+        std::lock_guard lock(m_mtx);
+        m_recent.erase(songId);
+        if (!m_snapshot->contains(songId))
+        {
+            return;
+        }
+        auto songIds = std::make_shared<std::unordered_set<SongIdType>>(*m_snapshot);
+        songIds->erase(songId);
+        m_snapshot = std::move(songIds);
+    }
+
+    bool TombstoneSet::contains(SongIdType songId) const
+    {
+        return getSnapshot()->contains(songId);
+    }
+
+    TombstoneSet::Snapshot TombstoneSet::getSnapshot() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_snapshot;
+    }
+
+    uint64_t TombstoneSet::beginRefresh() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_generation;
+    }
+
+    void TombstoneSet::completeRefresh(uint64_t generation, std::unordered_set<SongIdType> songIds)
+    {
+        std::lock_guard lock(m_mtx);
+        std::erase_if(m_recent, [generation, &songIds](const auto& entry) {
+            if (entry.second > generation)
+            {
+                songIds.insert(entry.first);
+                return false;
+            }
+            return true;
+        });
+        m_snapshot = std::make_shared<const std::unordered_set<SongIdType>>(std::move(songIds));
+    }
+}
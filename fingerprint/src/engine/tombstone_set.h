@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "../common/common.h"
+
+namespace siren::cloud
+{
+    /*
+     * Songs that are deleted but whose rows may still be in storage. Lookups read an immutable snapshot,
+     * so they never wait for a delete or a refresh. The set is replicated by refreshing it from primary storage,
+     * which knows the songs every process has deleted.
+     */
+    class TombstoneSet
+    {
+    public:
+        using Snapshot = std::shared_ptr<const std::unordered_set<SongIdType>>;
+
+        TombstoneSet();
+
+        TombstoneSet(const TombstoneSet& other) = delete;
+        TombstoneSet& operator=(const TombstoneSet& other) = delete;
+
+        void add(SongIdType songId);
+        // the song's rows are gone from storage
+        void remove(SongIdType songId);
+        bool contains(SongIdType songId) const;
+        Snapshot getSnapshot() const;
+
+        // taken before primary storage is read, so that songs deleted while it is being read are kept
+        uint64_t beginRefresh() const;
+        void completeRefresh(uint64_t generation, std::unordered_set<SongIdType> songIds);
+
+    private:
+        mutable std::mutex m_mtx;
+        Snapshot m_snapshot;
+        // songs added by this process, with the generation they were added in
+        std::unordered_map<SongIdType, uint64_t> m_recent;
+        uint64_t m_generation{0};
+    };
+}
@@ -3,7 +3,11 @@
 #include <sstream>
 #include <grpc/support/log.h>
 #include <grpcpp/grpcpp.h>
+#include "../admission/admission_controller.h"
 #include "../engine/engine.h"
+#include "../thread_pool/async_manager.h"
+#include "../thread_pool/coro/task.h"
+#include "../thread_pool/primitives/cancellation.h"
 
 using grpc::Server;
 using grpc::ServerAsyncResponseWriter;
@@ -31,6 +35,7 @@ namespace siren::cloud
     class CallDataBase
     {
     public:
+        CallDataBase() = default;
         virtual ~CallDataBase() = default;
         CallDataBase(CallDataBase&& other) noexcept = default;
         CallDataBase& operator=(CallDataBase&& other) noexcept = default;
@@ -40,7 +45,7 @@ namespace siren::cloud
 
     protected:
         virtual void waitForRequest() = 0;
-        virtual void handleRequest() = 0;
+        virtual coro::Task<void> handleRequest() = 0;
     };
 
     using CallDataPtr = std::shared_ptr<CallDataBase>;
@@ -60,6 +65,8 @@ namespace siren::cloud
             , m_responder(&m_serverContext)
             , m_engine(engine)
             , m_collector(collection)
+            , m_doneTag(this)
+            , m_cancellation(CancellationToken::create())
         {
             m_metadataAddr = siren::getenv("METADATA_ADDRESS") + ':' + siren::getenv("METADATA_PORT");
         }
@@ -75,23 +82,20 @@ namespace siren::cloud
             {
                 case CallStatus::CREATE:
                     m_status = CallStatus::PROCESS;
+                    // has to be armed before the call is requested
+                    m_serverContext.AsyncNotifyWhenDone(&m_doneTag);
                     waitForRequest();
                     break;
                 case CallStatus::PROCESS:
+                    m_receivedAt = std::chrono::steady_clock::now();
                     addNext();
-                    handleRequest();
-                    m_status = CallStatus::FINISH;
-                    m_responder.Finish(m_reply, Status::OK, this);
+                    applyDeadline();
+                    // the completion queue thread goes back to taking calls, the call is finished once it has been served
+                    m_engine->spawn(admitAndHandle());
                     break;
                 case CallStatus::FINISH:
-                {
-                    auto sharedCollector = m_collector.lock();
-                    if (!sharedCollector || !sharedCollector->requestCleanUpByThis(this))
-                    {
-                        Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not clean up calldata");
-                    }
+                    release();
                     break;
-                }
                 default:
                     std::stringstream err;
                     err << "CallStatus " << (int)m_status << " is invalid";
@@ -117,6 +121,107 @@ namespace siren::cloud
     protected:
         virtual void addNext() = 0;
 
+        // decides how long the call may wait for admission and whether its latency drives the concurrency limit
+        virtual TaskPriority getPriority() const = 0;
+
+    private:
+        // completion queue tag delivered once the call is over, whether it was finished, cancelled by the client or timed out
+        class DoneTag: public CallDataBase
+        {
+        public:
+            explicit DoneTag(CallData* owner)
+                : m_owner(owner)
+            {
+            }
+
+            void proceed() override
+            {
+                m_owner->onDone();
+            }
+
+            CallStatus getStatus() override
+            {
+                return m_owner->getStatus();
+            }
+
+        protected:
+            void waitForRequest() override
+            {
+            }
+
+            coro::Task<void> handleRequest() override
+            {
+                co_return;
+            }
+
+        private:
+            CallData* m_owner;
+        };
+
+        void applyDeadline()
+        {
+            auto deadline = m_serverContext.deadline();
+            if (deadline != std::chrono::system_clock::time_point::max())
+            {
+                auto remaining = std::chrono::duration_cast<CancellationToken::Clock::duration>(deadline - std::chrono::system_clock::now());
+                m_cancellation.setDeadline(CancellationToken::Clock::now() + remaining);
+            }
+        }
+
+        // the call data stays alive until the finish tag comes back, so it may be used up to the Finish call
+        coro::Task<void> admitAndHandle()
+        {
+            co_await AsyncManager::instance().schedule(getPriority());
+
+            // the time the call spent queued for the pool counts against its budget
+            auto& admission = AdmissionController::instance();
+            if (!admission.tryAcquire(getPriority(), m_cancellation, m_receivedAt))
+            {
+                Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Concurrency limit reached, refusing the call");
+                m_replyStatus = Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Server is overloaded");
+            }
+            else
+            {
+                auto start = std::chrono::steady_clock::now();
+                try
+                {
+                    co_await handleRequest();
+                }
+                catch (const std::exception& e)
+                {
+                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, e.what());
+                    m_replyStatus = Status(grpc::StatusCode::INTERNAL, "Internal server error");
+                }
+                admission.release(getPriority(), std::chrono::steady_clock::now() - start);
+            }
+
+            m_status = CallStatus::FINISH;
+            m_responder.Finish(m_reply, m_cancellation.isCancelled() ? Status::CANCELLED : m_replyStatus, this);
+        }
+
+        void onDone()
+        {
+            if (m_serverContext.IsCancelled())
+            {
+                m_cancellation.cancel();
+            }
+            release();
+        }
+
+        // the call data may only go once both the finish and the done tag have come back
+        void release()
+        {
+            if (m_pendingTagCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            {
+                return;
+            }
+            auto sharedCollector = m_collector.lock();
+            if (!sharedCollector || !sharedCollector->requestCleanUpByThis(this))
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not clean up calldata");
+            }
+        }
+
     protected:
         AsyncService* m_service;
         WeakCollectorPtr m_collector;
@@ -128,6 +233,14 @@ namespace siren::cloud
         ServerContext m_serverContext;
         EnginePtr m_engine;
         std::string m_metadataAddr;
+        DoneTag m_doneTag;
+        std::atomic<int> m_pendingTagCount{2};
+        // cancelled when the client goes away, carries the deadline of the call once it has been received
+        CancellationToken m_cancellation;
+        // status the call is finished with unless it was cancelled, handlers set it to refuse work they cannot take
+        Status m_replyStatus;
+        // when the call was taken off the completion queue, admission budgets are measured from here
+        std::chrono::steady_clock::time_point m_receivedAt;
     };
 
 } // namespace siren::service
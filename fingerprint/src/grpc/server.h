@@ -129,6 +129,11 @@ namespace siren::cloud
                 {
                     Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__,
                     "CompletionQueue is shutting down or client has disconnected without waiting for a response");
+                    // a response that could not be delivered still has to release its call data
+                    if (callData->getStatus() == CallStatus::FINISH)
+                    {
+                        callData->proceed();
+                    }
                 }
             }
         }
@@ -41,7 +41,7 @@ namespace siren::cloud
         return m_wassersteinDistance;
     }
 
-    Histogram::Histogram(const DBCommandPtr& dbReturnPtr, const FingerprintType& fingerprint)
+    Histogram::Histogram(const DBCommandPtr& dbReturnPtr, const FingerprintType& fingerprint, const std::unordered_set<SongIdType>& droppedSongIds)
     {
         std::string minWassDistance = siren::getenv("MIN_WASSERSTEIN_DISTANCE");
         m_minWassersteinDistance = !minWassDistance.empty() ? std::stof(minWassDistance) : 28;
@@ -67,6 +67,10 @@ namespace siren::cloud
                 Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not extract necessary data from DBCommandPtr");
                 continue;
             }
+            if (droppedSongIds.contains(songId))
+            {
+                continue;
+            }
             hist.emplace(hash, std::make_pair(songId, timestamp));
         }
 
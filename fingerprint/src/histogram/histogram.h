@@ -86,7 +86,8 @@ namespace siren::cloud
         using iterator = HistogramContainer::iterator;
         using const_iterator = HistogramContainer::const_iterator;
 
-        Histogram(const DBCommandPtr& dbReturnPtr, const FingerprintType& fingerprint);
+        // rows of the dropped songs are left out, their fingerprints may still be in storage after a delete
+        Histogram(const DBCommandPtr& dbReturnPtr, const FingerprintType& fingerprint, const std::unordered_set<SongIdType>& droppedSongIds={});
         iterator begin();
         iterator end();
         const_iterator cbegin() const;
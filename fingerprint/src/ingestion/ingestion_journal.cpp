@@ -0,0 +1,364 @@
+#include "ingestion_journal.h"
+#include "../logger/logger.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace siren::cloud
+{
+    // length and checksum in front of every record
+    static constexpr size_t RecordHeaderSize = 2 * sizeof(uint32_t);
+
+    static uint32_t checksum(const char* data, size_t size)
+    {
+        // FNV-1a, enough to tell a torn record from a whole one
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    static void put(std::string& out, T value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    static bool take(std::string_view& in, T& value)
+    {
+        if (in.size() < sizeof(T))
+        {
+            return false;
+        }
+        std::memcpy(&value, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    static bool writeAll(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            ssize_t written = ::write(fd, data.data(), data.size());
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+        return true;
+    }
+
+    IngestionJournal::IngestionJournal(size_t compactionSize)
+    {
+        if (compactionSize == 0)
+        {
+            std::string compactionSizeStr = siren::getenv("INGESTION_JOURNAL_COMPACT_BYTES");
+            compactionSize = !compactionSizeStr.empty() ? std::stoul(compactionSizeStr) : 64 * 1024 * 1024;
+        }
+        m_compactionSize = compactionSize;
+    }
+
+    IngestionJournal::~IngestionJournal()
+    {
+        close();
+    }
+
+    bool IngestionJournal::open(const std::string& path, std::vector<JournalEntry>& recovered)
+    {
+        std::lock_guard lock(m_mtx);
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (m_fd == -1)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not open the ingestion journal at " + path);
+            return false;
+        }
+        m_path = path;
+
+        std::string content;
+        char buffer[1 << 16];
+        ssize_t count;
+        while ((count = ::pread(m_fd, buffer, sizeof(buffer), static_cast<off_t>(content.size()))) > 0)
+        {
+            content.append(buffer, static_cast<size_t>(count));
+        }
+
+        std::unordered_map<SongIdType, JournalEntry> pending;
+        std::vector<SongIdType> order;
+        std::string_view in(content);
+        size_t validSize = 0;
+        while (in.size() >= RecordHeaderSize)
+        {
+            uint32_t length, sum;
+            std::string_view header = in.substr(0, RecordHeaderSize);
+            take(header, length);
+            take(header, sum);
+            if (in.size() < RecordHeaderSize + length || checksum(in.data() + RecordHeaderSize, length) != sum)
+            {
+                break;
+            }
+            std::string_view payload = in.substr(RecordHeaderSize, length);
+            in.remove_prefix(RecordHeaderSize + length);
+            validSize += RecordHeaderSize + length;
+
+            uint8_t type;
+            SongIdType songId;
+            if (!take(payload, type) || !take(payload, songId))
+            {
+                continue;
+            }
+            if (type == static_cast<uint8_t>(RecordType::Done))
+            {
+                pending.erase(songId);
+                continue;
+            }
+
+            // a record too short for the rows it claims is skipped, its size must not be trusted
+            uint8_t isCaching;
+            uint64_t size;
+            if (!take(payload, isCaching) || !take(payload, size) || size > payload.size() / (sizeof(uint64_t) + sizeof(uint32_t)))
+            {
+                continue;
+            }
+            std::vector<std::pair<uint64_t, uint32_t>> rows;
+            rows.reserve(size);
+            for (uint64_t i = 0; i < size; i++)
+            {
+                std::pair<uint64_t, uint32_t> row;
+                if (!take(payload, row.first) || !take(payload, row.second))
+                {
+                    break;
+                }
+                rows.push_back(row);
+            }
+            if (rows.size() == size)
+            {
+                auto fingerprint = std::make_shared<const FingerprintType>(rows.begin(), rows.end());
+                pending.insert_or_assign(songId, JournalEntry{songId, isCaching != 0, std::move(fingerprint)});
+                order.push_back(songId);
+            }
+        }
+
+        // a torn tail would hide every record appended after it
+        if (validSize < content.size() && ftruncate(m_fd, static_cast<off_t>(validSize)) != 0)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not cut the torn tail off the ingestion journal");
+        }
+        m_fileSize = validSize;
+
+        for (SongIdType songId: order)
+        {
+            auto it = pending.find(songId);
+            if (it != pending.end())
+            {
+                std::string record = makePendingRecord(it->second);
+                m_pendingSize += record.size();
+                m_pending.emplace(songId, std::move(record));
+                recovered.push_back(std::move(it->second));
+                pending.erase(it);
+            }
+        }
+        if (m_pending.empty() && validSize > 0)
+        {
+            if (ftruncate(m_fd, 0) != 0)
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not empty the ingestion journal");
+            }
+            else
+            {
+                m_fileSize = 0;
+            }
+        }
+        else if (m_fileSize > m_compactionSize && m_fileSize > 2 * m_pendingSize)
+        {
+            compact();
+        }
+
+        std::stringstream msg;
+        msg << "Ingestion journal opened with " << recovered.size() << " pending fingerprints";
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+        return true;
+    }
+
+    void IngestionJournal::close()
+    {
+        std::lock_guard lock(m_mtx);
+        if (m_fd != -1)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        m_pending.clear();
+        m_pendingSize = 0;
+        m_fileSize = 0;
+    }
+
+    bool IngestionJournal::isOpen() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_fd != -1;
+    }
+
+    bool IngestionJournal::appendPending(const std::vector<JournalEntry>& entries)
+    {
+        std::vector<std::string> pendingRecords;
+        pendingRecords.reserve(entries.size());
+        std::string records;
+        for (const auto& entry: entries)
+        {
+            pendingRecords.push_back(makePendingRecord(entry));
+            records.append(pendingRecords.back());
+        }
+
+        std::lock_guard lock(m_mtx);
+        if (!write(records, true))
+        {
+            return false;
+        }
+        // a later record of a song supersedes its earlier one, as it does on replay
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            std::string& record = m_pending[entries[i].songId];
+            m_pendingSize = m_pendingSize - record.size() + pendingRecords[i].size();
+            record = std::move(pendingRecords[i]);
+        }
+        return true;
+    }
+
+    bool IngestionJournal::appendDone(const std::vector<SongIdType>& songIds)
+    {
+        std::lock_guard lock(m_mtx);
+        for (SongIdType songId: songIds)
+        {
+            auto it = m_pending.find(songId);
+            if (it != m_pending.end())
+            {
+                m_pendingSize -= it->second.size();
+                m_pending.erase(it);
+            }
+        }
+        // nothing in the file is needed anymore
+        if (m_pending.empty() && m_fd != -1)
+        {
+            if (ftruncate(m_fd, 0) != 0)
+            {
+                return false;
+            }
+            m_fileSize = 0;
+            return true;
+        }
+
+        std::string records;
+        std::string payload;
+        for (SongIdType songId: songIds)
+        {
+            payload.clear();
+            put(payload, static_cast<uint8_t>(RecordType::Done));
+            put(payload, songId);
+            appendRecord(records, payload);
+        }
+        if (!write(records, false))
+        {
+            return false;
+        }
+        // with several batches in flight the file may never be emptied, only rewritten
+        if (m_fileSize > m_compactionSize && m_fileSize > 2 * m_pendingSize)
+        {
+            compact();
+        }
+        return true;
+    }
+
+    size_t IngestionJournal::getPendingCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_pending.size();
+    }
+
+    size_t IngestionJournal::getFileSize() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_fileSize;
+    }
+
+    bool IngestionJournal::write(const std::string& records, bool isSyncing)
+    {
+        if (m_fd == -1 || !writeAll(m_fd, records))
+        {
+            return false;
+        }
+        m_fileSize += records.size();
+        return !isSyncing || fdatasync(m_fd) == 0;
+    }
+
+    bool IngestionJournal::compact()
+    {
+        // the pending records are made durable in a file of their own before it takes the journal's place,
+        // a crash at any point leaves either the old or the new file, both of which hold them
+        std::string tempPath = m_path + ".compact";
+        int fd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not create a file to compact the ingestion journal into");
+            return false;
+        }
+
+        std::string records;
+        records.reserve(m_pendingSize);
+        for (const auto& [songId, record]: m_pending)
+        {
+            records.append(record);
+        }
+        if (!writeAll(fd, records) || fdatasync(fd) != 0 || std::rename(tempPath.c_str(), m_path.c_str()) != 0)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Could not compact the ingestion journal, it keeps growing");
+            ::close(fd);
+            ::unlink(tempPath.c_str());
+            return false;
+        }
+
+        std::stringstream msg;
+        msg << "Compacted the ingestion journal from " << m_fileSize << " to " << records.size() << " bytes";
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+        ::close(m_fd);
+        m_fd = fd;
+        m_fileSize = records.size();
+        return true;
+    }
+
+    std::string IngestionJournal::makePendingRecord(const JournalEntry& entry)
+    {
+        std::string payload;
+        put(payload, static_cast<uint8_t>(RecordType::Pending));
+        put(payload, entry.songId);
+        put(payload, static_cast<uint8_t>(entry.isCaching));
+        put(payload, static_cast<uint64_t>(entry.fingerprint->get_size()));
+        for (auto it = entry.fingerprint->cbegin(); it != entry.fingerprint->cend(); it++)
+        {
+            put(payload, static_cast<uint64_t>(it->first));
+            put(payload, static_cast<uint32_t>(it->second));
+        }
+        std::string record;
+        appendRecord(record, payload);
+        return record;
+    }
+
+    void IngestionJournal::appendRecord(std::string& out, const std::string& payload)
+    {
+        put(out, static_cast<uint32_t>(payload.size()));
+        put(out, checksum(payload.data(), payload.size()));
+        out.append(payload);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/common.h"
+
+namespace siren::cloud
+{
+    // a fingerprint on its way to storage
+    struct JournalEntry
+    {
+        SongIdType songId;
+        bool isCaching;
+        std::shared_ptr<const FingerprintType> fingerprint;
+    };
+
+    /*
+     * Local append-only log of fingerprints whose writes to storage have not landed yet.
+     * A fingerprint is logged before it is written and marked done once primary storage holds it,
+     * whatever is still pending when the process dies is handed back on the next open.
+     * Records are length prefixed and checksummed, a record torn by a crash ends the log.
+     * Once the file outgrows compactionSize it is rewritten with the pending records alone.
+     */
+    class IngestionJournal
+    {
+    public:
+        // 0 reads INGESTION_JOURNAL_COMPACT_BYTES
+        explicit IngestionJournal(size_t compactionSize = 0);
+        ~IngestionJournal();
+
+        IngestionJournal(const IngestionJournal& other) = delete;
+        IngestionJournal& operator=(const IngestionJournal& other) = delete;
+
+        // reads what an earlier run left pending into recovered and keeps the entries pending
+        bool open(const std::string& path, std::vector<JournalEntry>& recovered);
+        void close();
+        bool isOpen() const;
+
+        // the whole group is made durable with a single sync
+        bool appendPending(const std::vector<JournalEntry>& entries);
+        // not synced, a done record lost to a crash only makes the write happen again
+        bool appendDone(const std::vector<SongIdType>& songIds);
+
+        size_t getPendingCount() const;
+        size_t getFileSize() const;
+
+    private:
+        enum class RecordType: uint8_t
+        {
+            Pending = 1,
+            Done = 2
+        };
+
+        bool write(const std::string& records, bool isSyncing);
+        // replaces the file with one holding only the pending records, must be called with m_mtx held
+        bool compact();
+        static std::string makePendingRecord(const JournalEntry& entry);
+        static void appendRecord(std::string& out, const std::string& payload);
+
+    private:
+        mutable std::mutex m_mtx;
+        int m_fd{-1};
+        std::string m_path;
+        size_t m_compactionSize;
+        size_t m_fileSize{0};
+        // records of the pending entries in the file, once none are left it is emptied
+        std::unordered_map<SongIdType, std::string> m_pending;
+        size_t m_pendingSize{0};
+    };
+}
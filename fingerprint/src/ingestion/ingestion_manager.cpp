@@ -0,0 +1,292 @@
+#include "ingestion_manager.h"
+#include "../thread_pool/async_manager.h"
+#include "../logger/logger.h"
+
+namespace siren::cloud
+{
+    static constexpr std::array<JobState, IngestionStageCount> RunningStates{
+        JobState::Downloading,
+        JobState::Fingerprinting,
+        JobState::Storing
+    };
+
+    IngestionPolicy::IngestionPolicy()
+    {
+        std::string capacityStr = siren::getenv("INGESTION_CAPACITY");
+        if (!capacityStr.empty())
+        {
+            capacity = std::stoul(capacityStr);
+        }
+
+        std::array<std::string, IngestionStageCount> parallelismVars{
+            "INGESTION_DOWNLOAD_PARALLELISM",
+            "INGESTION_FINGERPRINT_PARALLELISM",
+            "INGESTION_STORE_PARALLELISM"
+        };
+        for (size_t i = 0; i < IngestionStageCount; i++)
+        {
+            std::string parallelismStr = siren::getenv(parallelismVars[i]);
+            if (!parallelismStr.empty())
+            {
+                parallelism[i] = std::max<size_t>(std::stoul(parallelismStr), 1);
+            }
+        }
+
+        std::string retainedCountStr = siren::getenv("INGESTION_RETAINED_JOBS");
+        if (!retainedCountStr.empty())
+        {
+            retainedCount = std::stoul(retainedCountStr);
+        }
+
+        std::string longTrackSizeStr = siren::getenv("INGESTION_LONG_TRACK_BYTES");
+        if (!longTrackSizeStr.empty())
+        {
+            longTrackSize = std::stoul(longTrackSizeStr);
+        }
+
+        std::string longTrackParallelismStr = siren::getenv("INGESTION_LONG_TRACK_PARALLELISM");
+        if (!longTrackParallelismStr.empty())
+        {
+            longTrackParallelism = std::max<size_t>(std::stoul(longTrackParallelismStr), 1);
+        }
+
+        std::string storeBatchSizeStr = siren::getenv("INGESTION_STORE_BATCH_SIZE");
+        if (!storeBatchSizeStr.empty())
+        {
+            batchSize[static_cast<size_t>(IngestionStage::Store)] = std::max<size_t>(std::stoul(storeBatchSizeStr), 1);
+        }
+    }
+
+    IngestionManager::IngestionManager(std::array<Stage, IngestionStageCount> stages, const IngestionPolicy& policy)
+        : m_stages{forEachJob(std::move(stages[0])), forEachJob(std::move(stages[1])), forEachJob(std::move(stages[2]))}
+        , m_policy(policy)
+    {
+    }
+
+    IngestionManager::IngestionManager(std::array<BatchStage, IngestionStageCount> stages, const IngestionPolicy& policy)
+        : m_stages(std::move(stages))
+        , m_policy(policy)
+    {
+    }
+
+    IngestionManager::~IngestionManager()
+    {
+        join();
+    }
+
+    IngestionManager::BatchStage IngestionManager::forEachJob(Stage stage)
+    {
+        return [stage = std::move(stage)](const std::vector<IngestionJob*>& jobs) {
+            std::vector<bool> results;
+            results.reserve(jobs.size());
+            for (IngestionJob* job: jobs)
+            {
+                results.push_back(stage(*job));
+            }
+            return results;
+        };
+    }
+
+    std::optional<JobIdType> IngestionManager::submit(std::string url, SongIdType songId, bool isCaching)
+    {
+        std::vector<std::pair<Batch, size_t>> runnable;
+        JobIdType jobId;
+        {
+            std::lock_guard lock(m_mtx);
+            if (m_activeCount >= m_policy.capacity)
+            {
+                return std::nullopt;
+            }
+            jobId = m_nextJobId++;
+            auto job = std::make_shared<IngestionJob>(IngestionJob{jobId, std::move(url), songId, isCaching});
+            m_statuses.emplace(jobId, JobStatus{JobState::Queued, songId});
+            m_queues[0].push_back(std::move(job));
+            m_activeCount++;
+            takeRunnable(runnable);
+        }
+        // a stage may run inline when the pool refuses it, so it must not be started under the lock
+        start(std::move(runnable));
+        return jobId;
+    }
+
+    JobIdType IngestionManager::resume(IngestionJob&& job, IngestionStage stage)
+    {
+        std::vector<std::pair<Batch, size_t>> runnable;
+        JobIdType jobId;
+        {
+            std::lock_guard lock(m_mtx);
+            jobId = m_nextJobId++;
+            job.id = jobId;
+            m_statuses.emplace(jobId, JobStatus{JobState::Queued, job.songId});
+            m_queues[static_cast<size_t>(stage)].push_back(std::make_shared<IngestionJob>(std::move(job)));
+            m_activeCount++;
+            takeRunnable(runnable);
+        }
+        start(std::move(runnable));
+        return jobId;
+    }
+
+    std::optional<JobStatus> IngestionManager::getStatus(JobIdType jobId) const
+    {
+        std::lock_guard lock(m_mtx);
+        auto it = m_statuses.find(jobId);
+        if (it == m_statuses.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    void IngestionManager::setBatchSize(IngestionStage stage, size_t batchSize)
+    {
+        std::lock_guard lock(m_mtx);
+        m_policy.batchSize[static_cast<size_t>(stage)] = std::max<size_t>(batchSize, 1);
+    }
+
+    size_t IngestionManager::getBatchSize(IngestionStage stage) const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_policy.batchSize[static_cast<size_t>(stage)];
+    }
+
+    void IngestionManager::takeRunnable(std::vector<std::pair<Batch, size_t>>& runnable)
+    {
+        constexpr size_t fingerprintStage = static_cast<size_t>(IngestionStage::Fingerprint);
+        for (size_t stage = 0; stage < IngestionStageCount; stage++)
+        {
+            auto& queue = m_queues[stage];
+            auto it = queue.begin();
+            while (it != queue.end() && m_runningCounts[stage] < m_policy.parallelism[stage])
+            {
+                Batch batch;
+                while (it != queue.end() && batch.size() < m_policy.batchSize[stage])
+                {
+                    // an hour long mix must not hold every fingerprinting place, tracks queued behind it go past it instead
+                    bool isLong = stage == fingerprintStage && isLongTrack(**it);
+                    if (isLong && m_runningLong.size() >= m_policy.longTrackParallelism)
+                    {
+                        ++it;
+                        continue;
+                    }
+                    if (isLong)
+                    {
+                        m_runningLong.insert((*it)->id);
+                    }
+
+                    m_statuses.at((*it)->id).state = RunningStates[stage];
+                    batch.push_back(std::move(*it));
+                    it = queue.erase(it);
+                }
+                if (batch.empty())
+                {
+                    break;
+                }
+                m_runningCounts[stage]++;
+                runnable.emplace_back(std::move(batch), stage);
+            }
+        }
+    }
+
+    bool IngestionManager::isLongTrack(const IngestionJob& job) const
+    {
+        return m_policy.longTrackSize > 0 && job.track.getSize() >= m_policy.longTrackSize;
+    }
+
+    void IngestionManager::start(std::vector<std::pair<Batch, size_t>>&& runnable)
+    {
+        for (auto& [batch, stage]: runnable)
+        {
+            m_scope.spawn(runStage(std::move(batch), stage));
+        }
+    }
+
+    coro::Task<void> IngestionManager::runStage(Batch batch, size_t stage)
+    {
+        co_await AsyncManager::instance().schedule(TaskPriority::Background);
+
+        std::vector<IngestionJob*> jobs;
+        jobs.reserve(batch.size());
+        for (const auto& job: batch)
+        {
+            jobs.push_back(job.get());
+        }
+
+        std::vector<bool> results;
+        try
+        {
+            results = m_stages[stage](jobs);
+        }
+        catch (const std::exception& ex)
+        {
+            for (IngestionJob* job: jobs)
+            {
+                job->error = ex.what();
+            }
+        }
+        catch (...)
+        {
+            // the jobs still have to be finished, or join() never returns
+            for (IngestionJob* job: jobs)
+            {
+                job->error = "Unknown error";
+            }
+        }
+        results.resize(batch.size(), false);
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            if (!results[i])
+            {
+                std::stringstream err;
+                err << "Load job " << batch[i]->id << " for song " << batch[i]->songId << " failed: " << batch[i]->error;
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, err.str());
+            }
+        }
+
+        std::vector<std::pair<Batch, size_t>> runnable;
+        {
+            std::lock_guard lock(m_mtx);
+            m_runningCounts[stage]--;
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                m_runningLong.erase(batch[i]->id);
+                if (results[i] && stage + 1 < IngestionStageCount)
+                {
+                    m_queues[stage + 1].push_back(std::move(batch[i]));
+                }
+                else
+                {
+                    finish(batch[i], results[i] ? JobState::Done : JobState::Failed);
+                }
+            }
+            takeRunnable(runnable);
+        }
+        start(std::move(runnable));
+    }
+
+    void IngestionManager::finish(const JobPtr& job, JobState state)
+    {
+        JobStatus& status = m_statuses.at(job->id);
+        status.state = state;
+        status.error = job->error;
+        m_activeCount--;
+
+        m_finished.push_back(job->id);
+        while (m_finished.size() > m_policy.retainedCount)
+        {
+            m_statuses.erase(m_finished.front());
+            m_finished.pop_front();
+        }
+    }
+
+    void IngestionManager::join()
+    {
+        m_scope.join();
+    }
+
+    size_t IngestionManager::getActiveCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_activeCount;
+    }
+}
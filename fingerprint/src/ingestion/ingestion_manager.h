@@ -0,0 +1,145 @@
+#pragma once
+#include <array>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "../common/common.h"
+#include "../thread_pool/coro/async_scope.h"
+#include "track_buffer.h"
+
+namespace siren::cloud
+{
+    using JobIdType = uint64_t;
+
+    enum class IngestionStage
+    {
+        Download = 0,
+        Fingerprint = 1,
+        Store = 2
+    };
+
+    inline constexpr size_t IngestionStageCount = 3;
+
+    enum class JobState
+    {
+        Queued,
+        Downloading,
+        Fingerprinting,
+        Storing,
+        Done,
+        Failed
+    };
+
+    // everything one load carries from stage to stage
+    struct IngestionJob
+    {
+        JobIdType id;
+        std::string url;
+        SongIdType songId;
+        bool isCaching;
+        // filled in by the stages
+        TrackBuffer track;
+        std::shared_ptr<const FingerprintType> fingerprint;
+        // why the job failed, set by the stage that failed it
+        std::string error;
+        // fingerprinted by an earlier run, its write was found pending in the journal
+        bool isRecovered{false};
+    };
+
+    struct JobStatus
+    {
+        JobState state;
+        SongIdType songId;
+        std::string error;
+    };
+
+    struct IngestionPolicy
+    {
+        IngestionPolicy();
+
+        // jobs admitted and not yet finished, a load beyond it is refused
+        size_t capacity{256};
+        // jobs running each stage at once, indexed by IngestionStage
+        std::array<size_t, IngestionStageCount> parallelism{8, 2, 4};
+        // finished jobs whose status can still be asked for
+        size_t retainedCount{1024};
+        // downloads at least this large are fingerprinted as long tracks, 0 treats none as long
+        size_t longTrackSize{64 * 1024 * 1024};
+        // fingerprinting places long tracks may hold at once, the rest is left to everything else
+        size_t longTrackParallelism{1};
+        // jobs a single run of a stage takes from its queue, indexed by IngestionStage
+        std::array<size_t, IngestionStageCount> batchSize{1, 1, 16};
+    };
+
+    /*
+     * Runs loads as jobs passing through the download, fingerprint and store stages.
+     * Every stage runs on the pool at background priority with a bounded number of jobs at once,
+     * so a slow download holds neither an RPC thread nor a place in the fingerprinting stage.
+     * A stage run takes every queued job up to its batch size, jobs that pile up behind a busy stage are handled together.
+     */
+    class IngestionManager
+    {
+    public:
+        // returns false and fills in the job's error once the job cannot go on
+        using Stage = std::function<bool(IngestionJob&)>;
+        // runs a batch of jobs at once and tells for each one whether it can go on
+        using BatchStage = std::function<std::vector<bool>(const std::vector<IngestionJob*>&)>;
+
+        explicit IngestionManager(std::array<Stage, IngestionStageCount> stages, const IngestionPolicy& policy = {});
+        explicit IngestionManager(std::array<BatchStage, IngestionStageCount> stages, const IngestionPolicy& policy = {});
+
+        // runs a stage on every job of the batch in turn
+        static BatchStage forEachJob(Stage stage);
+        ~IngestionManager();
+
+        IngestionManager(const IngestionManager& other) = delete;
+        IngestionManager& operator=(const IngestionManager& other) = delete;
+
+        // nullopt when the queue is full
+        std::optional<JobIdType> submit(std::string url, SongIdType songId, bool isCaching);
+        // carries on a job an earlier run left at the given stage, never refused
+        JobIdType resume(IngestionJob&& job, IngestionStage stage);
+        // nullopt for jobs never submitted here or finished too long ago
+        std::optional<JobStatus> getStatus(JobIdType jobId) const;
+
+        // waits for every submitted job to finish
+        void join();
+
+        size_t getActiveCount() const;
+        // applies to stage runs started from now on
+        void setBatchSize(IngestionStage stage, size_t batchSize);
+        size_t getBatchSize(IngestionStage stage) const;
+
+    private:
+        using JobPtr = std::shared_ptr<IngestionJob>;
+
+        using Batch = std::vector<JobPtr>;
+
+        coro::Task<void> runStage(Batch batch, size_t stage);
+        // starts every queued job a stage has room for, called under the lock
+        void takeRunnable(std::vector<std::pair<Batch, size_t>>& runnable);
+        bool isLongTrack(const IngestionJob& job) const;
+        void finish(const JobPtr& job, JobState state);
+        void start(std::vector<std::pair<Batch, size_t>>&& runnable);
+
+    private:
+        std::array<BatchStage, IngestionStageCount> m_stages;
+        IngestionPolicy m_policy;
+        mutable std::mutex m_mtx;
+        std::array<std::deque<JobPtr>, IngestionStageCount> m_queues;
+        std::array<size_t, IngestionStageCount> m_runningCounts{};
+        // long tracks being fingerprinted, their buffer is closed by the time the stage returns
+        std::unordered_set<JobIdType> m_runningLong;
+        std::unordered_map<JobIdType, JobStatus> m_statuses;
+        // finished jobs, oldest first
+        std::deque<JobIdType> m_finished;
+        size_t m_activeCount{0};
+        JobIdType m_nextJobId{1};
+        coro::AsyncScope m_scope;
+    };
+}
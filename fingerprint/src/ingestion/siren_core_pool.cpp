@@ -0,0 +1,79 @@
+#include "siren_core_pool.h"
+#include "../logger/logger.h"
+#include <sstream>
+
+namespace siren::cloud
+{
+    SirenCorePool::Lease::Lease(SirenCorePool* pool, SirenCorePtr core)
+        : m_pool(pool)
+        , m_core(std::move(core))
+    {
+    }
+
+    SirenCorePool::Lease::Lease(Lease&& other) noexcept
+        : m_pool(other.m_pool)
+        , m_core(std::move(other.m_core))
+    {
+    }
+
+    SirenCorePool::Lease::~Lease()
+    {
+        if (m_core)
+        {
+            m_pool->release(std::move(m_core));
+        }
+    }
+
+    siren::SirenCore* SirenCorePool::Lease::operator->() const
+    {
+        return m_core.get();
+    }
+
+    siren::SirenCore& SirenCorePool::Lease::operator*() const
+    {
+        return *m_core;
+    }
+
+    SirenCorePool::SirenCorePool(const Factory& factory, size_t size)
+        : m_size(std::max<size_t>(size, 1))
+    {
+        m_idle.reserve(m_size);
+        for (size_t i = 0; i < m_size; i++)
+        {
+            m_idle.push_back(factory());
+        }
+
+        std::stringstream msg;
+        msg << "Created " << m_size << " SirenCore instances for fingerprinting";
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+    }
+
+    SirenCorePool::Lease SirenCorePool::acquire()
+    {
+        std::unique_lock lock(m_mtx);
+        m_cv.wait(lock, [this] { return !m_idle.empty(); });
+        SirenCorePtr core = std::move(m_idle.back());
+        m_idle.pop_back();
+        return Lease(this, std::move(core));
+    }
+
+    void SirenCorePool::release(SirenCorePtr core)
+    {
+        {
+            std::lock_guard lock(m_mtx);
+            m_idle.push_back(std::move(core));
+        }
+        m_cv.notify_one();
+    }
+
+    size_t SirenCorePool::getSize() const
+    {
+        return m_size;
+    }
+
+    size_t SirenCorePool::getIdleCount() const
+    {
+        std::lock_guard lock(m_mtx);
+        return m_idle.size();
+    }
+}
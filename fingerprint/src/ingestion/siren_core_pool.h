@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <siren_core/src/siren.h>
+
+namespace siren::cloud
+{
+    using SirenCorePtr = std::shared_ptr<siren::SirenCore>;
+
+    /*
+     * Owns one SirenCore per fingerprinting worker, so fingerprints are made side by side
+     * instead of all going through a single instance and its scratch buffers.
+     * Cores are handed out most recently returned first, the buffers of a core that has just finished are still warm.
+     */
+    class SirenCorePool
+    {
+    public:
+        using Factory = std::function<SirenCorePtr()>;
+
+        // returns its core to the pool once it goes out of scope
+        class Lease
+        {
+        public:
+            Lease(SirenCorePool* pool, SirenCorePtr core);
+            ~Lease();
+
+            Lease(Lease&& other) noexcept;
+            Lease(const Lease& other) = delete;
+            Lease& operator=(const Lease& other) = delete;
+            Lease& operator=(Lease&& other) = delete;
+
+            siren::SirenCore* operator->() const;
+            siren::SirenCore& operator*() const;
+
+        private:
+            SirenCorePool* m_pool;
+            SirenCorePtr m_core;
+        };
+
+        SirenCorePool(const Factory& factory, size_t size);
+
+        SirenCorePool(const SirenCorePool& other) = delete;
+        SirenCorePool& operator=(const SirenCorePool& other) = delete;
+
+        // waits for a free core when every one is leased
+        Lease acquire();
+
+        size_t getSize() const;
+        size_t getIdleCount() const;
+
+    private:
+        void release(SirenCorePtr core);
+
+    private:
+        mutable std::mutex m_mtx;
+        std::condition_variable m_cv;
+        std::vector<SirenCorePtr> m_idle;
+        size_t m_size;
+    };
+
+    using SirenCorePoolPtr = std::shared_ptr<SirenCorePool>;
+}
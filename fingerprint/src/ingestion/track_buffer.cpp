@@ -0,0 +1,107 @@
+#include "track_buffer.h"
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace siren::cloud
+{
+    TrackBuffer::~TrackBuffer()
+    {
+        close();
+    }
+
+    TrackBuffer::TrackBuffer(TrackBuffer&& other) noexcept
+        : m_fd(other.m_fd)
+        , m_size(other.m_size.load())
+    {
+        other.m_fd = -1;
+        other.m_size = 0;
+    }
+
+    TrackBuffer& TrackBuffer::operator=(TrackBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            m_fd = other.m_fd;
+            m_size = other.m_size.load();
+            other.m_fd = -1;
+            other.m_size = 0;
+        }
+        return *this;
+    }
+
+    bool TrackBuffer::open(const std::string& name)
+    {
+        close();
+        m_fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+        return m_fd != -1;
+    }
+
+    bool TrackBuffer::append(std::string_view chunk)
+    {
+        return writeAt(m_size, chunk);
+    }
+
+    bool TrackBuffer::reserve(size_t size)
+    {
+        if (ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+        {
+            return false;
+        }
+        size_t current = m_size;
+        while (current < size && !m_size.compare_exchange_weak(current, size))
+        {
+        }
+        return true;
+    }
+
+    bool TrackBuffer::writeAt(size_t offset, std::string_view chunk)
+    {
+        while (!chunk.empty())
+        {
+            ssize_t written = ::pwrite(m_fd, chunk.data(), chunk.size(), static_cast<off_t>(offset));
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            chunk.remove_prefix(static_cast<size_t>(written));
+            offset += static_cast<size_t>(written);
+        }
+
+        size_t current = m_size;
+        while (current < offset && !m_size.compare_exchange_weak(current, offset))
+        {
+        }
+        return true;
+    }
+
+    void TrackBuffer::close()
+    {
+        if (m_fd != -1)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+            m_size = 0;
+        }
+    }
+
+    bool TrackBuffer::isOpen() const
+    {
+        return m_fd != -1;
+    }
+
+    size_t TrackBuffer::getSize() const
+    {
+        return m_size;
+    }
+
+    std::string TrackBuffer::getPath() const
+    {
+        return "/proc/self/fd/" + std::to_string(m_fd);
+    }
+}
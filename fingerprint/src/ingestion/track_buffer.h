@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <string_view>
+
+namespace siren::cloud
+{
+    /*
+     * A downloaded track held in an anonymous in-memory file.
+     * SirenCore reads tracks by path, the buffer hands it one under /proc/self/fd,
+     * so a download never touches the disk and is gone as soon as the buffer is.
+     */
+    class TrackBuffer
+    {
+    public:
+        TrackBuffer() = default;
+        ~TrackBuffer();
+
+        TrackBuffer(TrackBuffer&& other) noexcept;
+        TrackBuffer& operator=(TrackBuffer&& other) noexcept;
+        TrackBuffer(const TrackBuffer& other) = delete;
+        TrackBuffer& operator=(const TrackBuffer& other) = delete;
+
+        // creates the in-memory file, false when the kernel refuses one
+        bool open(const std::string& name);
+        bool append(std::string_view chunk);
+        // sizes the file up front, so ranges can be written in any order
+        bool reserve(size_t size);
+        // safe to call from several threads at once for disjoint offsets
+        bool writeAt(size_t offset, std::string_view chunk);
+        void close();
+
+        bool isOpen() const;
+        size_t getSize() const;
+        // valid for as long as the buffer is open
+        std::string getPath() const;
+
+    private:
+        int m_fd{-1};
+        std::atomic<size_t> m_size{0};
+    };
+}
@@ -27,10 +27,12 @@ namespace siren::cloud
         auto elasticConnector = std::make_shared<elastic::ElasticConnector>(params.elasticConnString);
         auto elasticPool = std::make_shared<DBConnectionPool>(elasticConnector, elasticPoolSize);
 
-        auto rawCore = siren_core::CreateCore();
-        SirenCorePtr corePtr = std::shared_ptr<siren::SirenCore>(rawCore);
+        // one core for every job the fingerprinting stage runs at once, so a job never waits for a core
+        IngestionPolicy ingestionPolicy;
+        size_t corePoolSize = ingestionPolicy.parallelism[static_cast<size_t>(IngestionStage::Fingerprint)];
+        auto corePool = std::make_shared<SirenCorePool>([] { return SirenCorePtr(siren_core::CreateCore()); }, corePoolSize);
 
-        auto engine = std::make_shared<Engine>(postgresPool, elasticPool, corePtr);
+        auto engine = std::make_shared<Engine>(postgresPool, elasticPool, corePool);
         return std::make_unique<ServerImpl>(servAddress, engine);
     }
 
@@ -1,4 +1,5 @@
 #include "abstract_command.h"
+#include "../thread_pool/async_manager.h"
 
 AbstractCommand::AbstractCommand(const Query& query)
     : m_queries{query}
@@ -26,3 +27,18 @@ QueryCollection AbstractCommand::getQueries() const
     return m_queries;
 }
 
+void AbstractCommand::setCancellationToken(const siren::cloud::CancellationToken& token)
+{
+    m_cancellation = token;
+}
+
+siren::cloud::coro::Task<bool> AbstractCommand::executeAsync(siren::cloud::TaskPriority priority)
+{
+    co_await siren::cloud::AsyncManager::instance().schedule(priority);
+    if (m_cancellation.isCancelled())
+    {
+        co_return false;
+    }
+    co_return execute();
+}
+
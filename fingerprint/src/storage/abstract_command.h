@@ -1,6 +1,9 @@
 #pragma once
 #include <memory>
 #include "query.h"
+#include "../thread_pool/coro/task.h"
+#include "../thread_pool/primitives/cancellation.h"
+#include "../thread_pool/primitives/priority.h"
 
 class AbstractConnection;
 using DBConnectionPtr = std::shared_ptr<AbstractConnection>;
@@ -18,7 +21,12 @@ public:
     virtual bool isBatch() const;
     virtual QueryCollection getQueries() const;
 
+    // bounds execution by the token's deadline and lets it be abandoned once the caller has gone away
+    void setCancellationToken(const siren::cloud::CancellationToken& token);
+
     [[nodiscard]] virtual bool execute() = 0;
+    // completes on a pool thread of the given priority, the default implementation blocks that thread in execute()
+    [[nodiscard]] virtual siren::cloud::coro::Task<bool> executeAsync(siren::cloud::TaskPriority priority=siren::cloud::TaskPriority::Interactive);
     virtual bool isEmpty() const = 0;
     virtual bool fetchNext() = 0;
     virtual bool asInt32(const std::string& columnName, int32_t& val) const = 0;
@@ -37,6 +45,7 @@ protected:
     bool m_isFirstIter{true};
     bool m_isBatch{false};
     QueryCollection m_queries;
+    siren::cloud::CancellationToken m_cancellation;
 };
 
 using DBCommandPtr = std::shared_ptr<AbstractCommand>;
@@ -0,0 +1,144 @@
+#include "bulk_body_writer.h"
+#include <algorithm>
+#include <charconv>
+#include <concepts>
+#include <cstring>
+
+namespace siren::cloud::elastic
+{
+    static char* append(char* it, std::string_view text)
+    {
+        std::memcpy(it, text.data(), text.size());
+        return it + text.size();
+    }
+
+    template <std::integral T>
+    static char* append(char* it, T value)
+    {
+        // MaxRowSize leaves room for the widest value of every field
+        return std::to_chars(it, it + 20, value).ptr;
+    }
+
+    BulkBodyWriter::BulkBodyWriter(size_t maxBodySize)
+    {
+        if (maxBodySize == 0)
+        {
+            std::string maxBodySizeStr = siren::getenv("ELASTIC_BULK_MAX_BYTES");
+            maxBodySize = !maxBodySizeStr.empty() ? std::stoul(maxBodySizeStr) : 5 * 1024 * 1024;
+        }
+        // a body holds at least one row
+        m_maxBodySize = std::max(maxBodySize, MaxRowSize);
+    }
+
+    void BulkBodyWriter::reserve(size_t rowCount)
+    {
+        m_expectedSize += rowCount * MaxRowSize;
+    }
+
+    void BulkBodyWriter::index(HashType hash, TimestampType timestamp, SongIdType songId)
+    {
+        char* it = beginRow();
+        it = appendHeader(it, "index", hash, songId);
+        it = append(it, R"({"hash":)");
+        it = append(it, hash);
+        it = append(it, R"(,"song_id":)");
+        it = append(it, songId);
+        it = append(it, R"(,"timestamp":)");
+        it = append(it, timestamp);
+        it = append(it, "}\n");
+        endRow(it);
+    }
+
+    void BulkBodyWriter::remove(HashType hash, SongIdType songId)
+    {
+        endRow(appendHeader(beginRow(), "delete", hash, songId));
+    }
+
+    bool BulkBodyWriter::empty() const
+    {
+        return m_rowCount == 0;
+    }
+
+    size_t BulkBodyWriter::getRowCount() const
+    {
+        return m_rowCount;
+    }
+
+    size_t BulkBodyWriter::getMaxBodySize() const
+    {
+        return m_maxBodySize;
+    }
+
+    QueryCollection BulkBodyWriter::takeQueries(const std::string& lucene)
+    {
+        std::vector<std::string> bodies = takeBodies();
+        QueryCollection queries;
+        queries.reserve(bodies.size());
+        for (auto& body: bodies)
+        {
+            Query query;
+            query.emplace("lucene", lucene);
+            query.emplace("query", std::move(body));
+            query.emplace("request_type", "POST");
+            queries.insertQuery(std::move(query));
+        }
+        return queries;
+    }
+
+    std::vector<std::string> BulkBodyWriter::takeBodies()
+    {
+        if (!m_body.empty())
+        {
+            m_bodies.push_back(std::move(m_body));
+        }
+        m_body = {};
+        m_expectedSize = 0;
+        m_rowCount = 0;
+        return std::move(m_bodies);
+    }
+
+    char* BulkBodyWriter::appendHeader(char* it, std::string_view action, HashType hash, SongIdType songId)
+    {
+        it = append(it, R"({")");
+        it = append(it, action);
+        it = append(it, R"(":{"_id":")");
+        it = append(it, songId);
+        it = append(it, ":");
+        it = append(it, hash);
+        it = append(it, R"(","routing":")");
+        it = append(it, songId);
+        return append(it, "\"}}\n");
+    }
+
+    char* BulkBodyWriter::beginRow()
+    {
+        if (m_body.size() + MaxRowSize > m_maxBodySize)
+        {
+            m_bodies.push_back(std::move(m_body));
+            m_body = {};
+        }
+        if (m_body.empty())
+        {
+            startBody();
+        }
+
+        // grows within the reserved capacity, endRow trims it back to what was written
+        size_t size = m_body.size();
+        m_body.resize(size + MaxRowSize);
+        return m_body.data() + size;
+    }
+
+    void BulkBodyWriter::endRow(const char* end)
+    {
+        size_t size = end - m_body.data();
+        m_expectedSize -= std::min(m_expectedSize, MaxRowSize);
+        m_body.resize(size);
+        m_rowCount++;
+    }
+
+    void BulkBodyWriter::startBody()
+    {
+        // sized for the rows still expected, never past the limit
+        m_body.reserve(std::clamp(m_expectedSize, MaxRowSize, m_maxBodySize));
+    }
+}
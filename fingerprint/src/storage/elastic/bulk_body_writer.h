@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../query.h"
+#include "../../common/common.h"
+
+namespace siren::cloud::elastic
+{
+    /*
+     * Builds the NDJSON bodies of _bulk requests for fingerprint rows.
+     * Every row is written straight into a body reserved up front, numbers are formatted with std::to_chars,
+     * and a new body is started once the next row could take the current one past the size limit.
+     * A row's document id is made of its song id and hash, the key of its row in primary storage, and it is routed by song id,
+     * so writing a row again overwrites it and a song's rows all live on one shard.
+     */
+    class BulkBodyWriter
+    {
+    public:
+        // 0 takes ELASTIC_BULK_MAX_BYTES
+        explicit BulkBodyWriter(size_t maxBodySize = 0);
+
+        // rows about to be written, the bodies are reserved for them instead of growing
+        void reserve(size_t rowCount);
+        void index(HashType hash, TimestampType timestamp, SongIdType songId);
+        void remove(HashType hash, SongIdType songId);
+
+        bool empty() const;
+        size_t getRowCount() const;
+        size_t getMaxBodySize() const;
+
+        // one POST per body, the writer is empty and can be reused afterwards
+        QueryCollection takeQueries(const std::string& lucene);
+        std::vector<std::string> takeBodies();
+
+    private:
+        // room for the header and document of any row
+        static constexpr size_t MaxRowSize = 256;
+
+        static char* appendHeader(char* it, std::string_view action, HashType hash, SongIdType songId);
+        char* beginRow();
+        void endRow(const char* end);
+        void startBody();
+
+    private:
+        size_t m_maxBodySize;
+        // bytes the rows announced by reserve are still expected to take
+        size_t m_expectedSize{0};
+        size_t m_rowCount{0};
+        std::string m_body;
+        std::vector<std::string> m_bodies;
+    };
+}
@@ -1,4 +1,5 @@
 #include "elastic_command.h"
+#include "../../thread_pool/async_manager.h"
 #include <memory>
 
 namespace siren::cloud::elastic
@@ -33,16 +34,6 @@ namespace siren::cloud::elastic
     {
     }
 
-    static constexpr uint32_t hash(std::string_view data) noexcept
-    {
-        uint32_t hash = 5381;
-        for (auto c: data)
-        {
-            hash = ((hash << 5) + hash) + (unsigned char)c;
-        }
-        return hash;
-    }
-
     bool ElasticCommand::isEmpty() const
     {
         return m_bufVec.empty();
@@ -53,13 +44,66 @@ namespace siren::cloud::elastic
         return m_bufVec.size();
     }
 
-    std::string ElasticCommand::formBulkQuery(Query&& queryBody, const std::string& header)
+    bool ElasticCommand::execute()
     {
-        return {header + "\n" + queryBody.get("query") + "\n"};
+        std::vector<HttpRequest> requests;
+        if (!prepareRequests(requests))
+        {
+            return false;
+        }
+
+        // every request is multiplexed on the HttpClient reactor, this thread only waits for the whole batch once
+        std::vector<std::future<HttpResponse>> futures;
+        futures.reserve(requests.size());
+        for (auto&& request: requests)
+        {
+            futures.emplace_back(HttpClient::instance().send(std::move(request)));
+        }
+
+        std::vector<HttpResponse> responses;
+        responses.reserve(futures.size());
+        for (auto&& future: futures)
+        {
+            responses.emplace_back(future.get());
+        }
+        return handleResponses(std::move(responses));
     }
 
-    bool ElasticCommand::execute()
+    coro::Task<bool> ElasticCommand::executeAsync(TaskPriority priority)
     {
+        std::vector<HttpRequest> requests;
+        if (!prepareRequests(requests))
+        {
+            co_return false;
+        }
+
+        // no thread is held while the requests are in flight, the last of them to complete resumes us on its reactor
+        std::vector<coro::Task<HttpResponse>> transfers;
+        transfers.reserve(requests.size());
+        for (auto&& request: requests)
+        {
+            transfers.emplace_back([](HttpRequest request) -> coro::Task<HttpResponse> {
+                co_return co_await HttpClient::instance().request(std::move(request));
+            }(std::move(request)));
+        }
+        std::vector<HttpResponse> responses = co_await coro::whenAll(std::move(transfers));
+        co_await AsyncManager::instance().schedule(priority);
+        if (m_cancellation.isCancelled())
+        {
+            // whoever asked for the hits has given up while the resumption was queued
+            co_return false;
+        }
+        co_return handleResponses(std::move(responses));
+    }
+
+    bool ElasticCommand::prepareRequests(std::vector<HttpRequest>& requests)
+    {
+        if (m_cancellation.isCancelled())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "ESQuery was cancelled before it was sent");
+            return false;
+        }
+
         Auth auth;
         auth.user = m_credentials.elasticUser;
         auth.password = m_credentials.elasticPassword;
@@ -67,7 +111,8 @@ namespace siren::cloud::elastic
         std::string useSslStr = siren::getenv("USE_SSL");
         bool useSsl = !useSslStr.empty() ? std::stoi(useSslStr) : 1;
 
-        QueryCollection queries = getQueries();
+        // a command runs once, the bodies are handed over to the requests instead of copied
+        QueryCollection& queries = m_queries;
         if (queries.empty())
         {
             Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Tried to execute empty ESQuery");
@@ -91,9 +136,24 @@ namespace siren::cloud::elastic
             return false;
         }
 
+        // without a header every query of a bulk or msearch request must already be a whole NDJSON body
+        if ((contains(url, "_bulk") || contains(url, "_msearch")) && header.empty())
+        {
+            for (auto it = queries.cbegin(); it != queries.cend(); it++)
+            {
+                std::string_view body = it->view("query");
+                if (body.empty() || body.back() != '\n')
+                {
+                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "ESQuery lacks header to perform bulk/msearch request");
+                    return false;
+                }
+            }
+        }
+
         if (queries.size() == 1)
         {
-            return doExecute(auth, url, type, queries.begin()->get("query"), useSsl);
+            requests.push_back(makeRequest(auth, url, type, queries[0].take("query"), useSsl));
+            return true;
         }
 
         bool isBulk = contains(url, "_bulk") && !header.empty();
@@ -110,103 +170,59 @@ namespace siren::cloud::elastic
             optimalBatchSize = !batchSize.empty() ? std::stoul(batchSize) : 1000;
         }
 
-        std::vector<WaitableFuture> futures;
-        futures.reserve(queries.size());
         if (!isBulk && !isMultiSearch)
         {
+            requests.reserve(queries.size());
             for (auto&& query: queries)
             {
-                futures.emplace_back(AsyncManager::instance().submitTask(
-                    [this, url, auth, type, useSsl, strQuery = std::move(query.get("query"))] {
-                        if (!doExecute(auth, url, type, strQuery, useSsl))
-                        {
-                            Logger::log(LogLevel::FATAL, __FILE__, __FUNCTION__, __LINE__, "doExecute failed to execute ESQuery asynchronously."
-                            "Consider making individual queries more lightweight or opting for a bulk version");
-                        }
-                    }, true));
+                requests.push_back(makeRequest(auth, url, type, query.take("query"), useSsl));
             }
             return true;
         }
 
-        if (header.empty())
-        {
-            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "ESQuery lacks header to perform bulk/msearch request");
-            return false;
-        }
-
-        if (queries.size() % optimalBatchSize != 0 || queries.size() < optimalBatchSize)
+        requests.reserve(queries.size() / optimalBatchSize + 1);
+        for (size_t i = 0; i < queries.size(); i += optimalBatchSize)
         {
-            std::stringstream streamQuery;
-            size_t i = queries.size() < optimalBatchSize ? 0 : floor(queries.size() / optimalBatchSize) * optimalBatchSize;
-            for (; i < queries.size(); i++)
+            std::string body;
+            for (size_t j = i; j < std::min(i + optimalBatchSize, queries.size()); j++)
             {
-                std::string currentQuery = formBulkQuery(std::move(queries[i]), header);
-                if (currentQuery.empty())
-                {
-                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "formBulkQuery returned an invalid bulk ESQuery");
-                    return false;
-                }
-                streamQuery << currentQuery;
+                std::string document = queries[j].take("query");
+                body.append(header).append(1, '\n').append(document).append(1, '\n');
             }
+            requests.push_back(makeRequest(auth, url, type, std::move(body), useSsl));
+        }
+        return true;
+    }
 
-            if (!doExecute(auth, url, type, streamQuery.str(), useSsl))
-            {
-                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "doExecute failed to execute ESQuery");
-                return false;
-            }
+    HttpRequest ElasticCommand::makeRequest(const Auth& auth, const std::string& url, const std::string& ReqType, std::string&& body, bool isVerifying) const
+    {
+        HttpRequest request = RequestManager::MakeRequest(ReqType, url, {}, "application/json", auth, isVerifying);
+        request.body = std::move(body);
+        // ES cancels a search once its HTTP connection is closed, so aborting the transfer frees the cluster as well
+        request.cancellation = m_cancellation;
+        return request;
+    }
 
-            if (queries.size() < optimalBatchSize)
+    bool ElasticCommand::handleResponses(std::vector<HttpResponse>&& responses)
+    {
+        bool isSuccess = true;
+        for (auto&& response: responses)
+        {
+            if (!handleResponse(std::move(response)))
             {
-                return true;
+                isSuccess = false;
             }
         }
-
-        for (size_t i = 0; i <= queries.size() - optimalBatchSize; i += optimalBatchSize)
+        if (!isSuccess && responses.size() > 1)
         {
-            std::stringstream streamQuery;
-            for (size_t j = i; j < i + optimalBatchSize; j++)
-            {
-                std::string currentQuery = formBulkQuery(std::move(queries[j]), header);
-                if (currentQuery.empty())
-                {
-                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "formBulkQuery returned an invalid bulk ESQuery");
-                    return false;
-                }
-                streamQuery << currentQuery;
-            }
-            futures.emplace_back(AsyncManager::instance().submitTask(
-                [this, url, type, auth, useSsl, strQuery = std::move(streamQuery.str())] {
-                    if (!doExecute(auth, url, type, strQuery, useSsl))
-                    {
-                        Logger::log(LogLevel::FATAL, __FILE__, __FUNCTION__, __LINE__,
-                        "doExecute failed to execute ESQuery asynchronously. Consider adjusting the value for ELASTIC_BATCH_SIZE"
-                        " and/or increasing memory limit for ES (MEM_LIMIT)");
-                    }
-                }, true));
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Failed to execute batched ESQuery. Consider adjusting the value for ELASTIC_BATCH_SIZE"
+                " and/or increasing memory limit for ES (MEM_LIMIT)");
         }
-        return true;
+        return isSuccess;
     }
 
-    bool ElasticCommand::doExecute(const Auth& auth, const std::string& url, const std::string& ReqType, const std::string& body, bool isVerifying)
+    bool ElasticCommand::handleResponse(HttpResponse&& res)
     {
-        std::string contentType = "application/json";
-        HttpResponse res;
-        switch (hash(ReqType))
-        {
-            case hash("PUT"):
-                res = RequestManager::Put(url, body, contentType, auth, isVerifying);
-                break;
-            case hash("POST"):
-                res = RequestManager::Post(url, body, contentType, auth, isVerifying);
-                break;
-            case hash("GET"):
-                res = RequestManager::Get(url, body, contentType, auth, isVerifying);
-                break;
-            case hash("DELETE"):
-                res = RequestManager::Delete(url, body, contentType, auth, isVerifying);
-                break;
-        }
-
         if (res.status_code == 0)
         {
             Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, res.error.message);
@@ -248,7 +264,22 @@ namespace siren::cloud::elastic
         }
 
         Json resArray;
-        if (esResponse["hits"].contains("hits"))
+        bool isSongStatistics = esResponse.contains("aggregations") && esResponse["aggregations"].contains("songs");
+        if (isSongStatistics)
+        {
+            // per song statistics, every bucket becomes a row with its key and doc_count
+            for (auto&& bucket: esResponse["aggregations"]["songs"]["buckets"])
+            {
+                // a composite bucket is keyed by an object holding its single source
+                if (bucket["key"].is_object() && bucket["key"].size() == 1)
+                {
+                    Json key = bucket["key"].begin().value();
+                    bucket["key"] = std::move(key);
+                }
+                resArray.emplace_back(std::move(bucket));
+            }
+        }
+        else if (esResponse["hits"].contains("hits"))
         {
             resArray = esResponse["hits"]["hits"];
         }
@@ -279,7 +310,7 @@ namespace siren::cloud::elastic
             }
         }
 
-        if (esResponse.is_object() && resArray.empty())
+        if (esResponse.is_object() && resArray.empty() && !isSongStatistics)
         {
             resArray.emplace_back(std::move(esResponse));
         }
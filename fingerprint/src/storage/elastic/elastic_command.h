@@ -3,7 +3,6 @@
 #include <mutex>
 #include "elastic_connection.h"
 #include "../../common/request_manager.h"
-#include "../../thread_pool/async_manager.h"
 #include "../../logger/logger.h"
 #include "../../common/common.h"
 
@@ -18,6 +17,8 @@ namespace siren::cloud::elastic
         ElasticCommand(const DBConnectionPtr& conn, QueryCollection&& queries);
 
         [[nodiscard]] bool execute() override;
+        // the requests are awaited on the HttpClient reactor instead of a blocked pool thread
+        [[nodiscard]] coro::Task<bool> executeAsync(TaskPriority priority=TaskPriority::Interactive) override;
         bool isEmpty() const override;
         bool fetchNext() override;
         bool asInt32(const std::string& fieldName, int32_t& val) const override;
@@ -32,8 +33,11 @@ namespace siren::cloud::elastic
         size_t getSize() const override;
 
     private:
-        std::string formBulkQuery(Query&& queryBody, const std::string& header);
-        bool doExecute(const Auth& auth, const std::string& url, const std::string& ReqType, const std::string& body, bool isVerifying=true);
+        // false when the command is malformed or cancelled, an empty command leaves requests empty
+        bool prepareRequests(std::vector<HttpRequest>& requests);
+        HttpRequest makeRequest(const Auth& auth, const std::string& url, const std::string& ReqType, std::string&& body, bool isVerifying) const;
+        bool handleResponses(std::vector<HttpResponse>&& responses);
+        bool handleResponse(HttpResponse&& res);
 
         template<typename T>
         bool asValue(const std::string& fieldName, T& value) const
@@ -0,0 +1,329 @@
+#include "pg_reactor.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstring>
+#include "../../logger/logger.h"
+
+namespace siren::cloud::postgres
+{
+    struct PgPipeline
+    {
+        PgPipeline(PGconn* connection, std::vector<std::string>&& statements, PgReactor::Callback&& onComplete)
+            : connection(connection)
+            , statements(std::move(statements))
+            , onComplete(std::move(onComplete))
+        {
+        }
+
+        void complete(bool isSuccess)
+        {
+            if (onComplete)
+            {
+                onComplete(PgPipelineResult{isSuccess && !hasFailed, std::move(results)});
+                onComplete = nullptr;
+            }
+        }
+
+        PGconn* connection;
+        std::vector<std::string> statements;
+        PgReactor::Callback onComplete;
+        std::vector<PgResultPtr> results;
+        bool hasFailed{false};
+        bool isFlushing{false};
+    };
+
+    static void logConnectionError(PGconn* connection, const std::string& context)
+    {
+        Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, context + ": " + PQerrorMessage(connection));
+    }
+
+    PgReactor::PgReactor()
+    {
+        m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_epollFd < 0 || m_wakeFd < 0)
+        {
+            Logger::log(LogLevel::FATAL, __FILE__, __FUNCTION__, __LINE__, "Failed to initialize PgReactor");
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = m_wakeFd;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+
+        m_thread = std::thread([this] { run(); });
+    }
+
+    PgReactor::~PgReactor()
+    {
+        m_isStopping = true;
+        wake();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        abortAll();
+        close(m_wakeFd);
+        close(m_epollFd);
+    }
+
+    PgReactor& PgReactor::instance()
+    {
+        static PgReactor reactor;
+        return reactor;
+    }
+
+    PGconn* PgReactor::connect(const std::string& connectionString)
+    {
+        PGconn* connection = PQconnectdb(connectionString.c_str());
+        if (PQstatus(connection) != CONNECTION_OK)
+        {
+            logConnectionError(connection, "Failed to open a pipelined postgres connection");
+            PQfinish(connection);
+            return nullptr;
+        }
+        if (PQsetnonblocking(connection, 1) != 0 || PQenterPipelineMode(connection) != 1)
+        {
+            logConnectionError(connection, "Failed to switch postgres connection into pipeline mode");
+            PQfinish(connection);
+            return nullptr;
+        }
+        return connection;
+    }
+
+    void PgReactor::submit(PGconn* connection, std::vector<std::string>&& statements, Callback&& onComplete)
+    {
+        auto pipeline = std::make_unique<PgPipeline>(connection, std::move(statements), std::move(onComplete));
+        if (m_isStopping || !connection)
+        {
+            pipeline->complete(false);
+            return;
+        }
+        m_inFlightCount++;
+        {
+            std::lock_guard lock(m_pendingMtx);
+            m_pending.emplace_back(std::move(pipeline));
+        }
+        wake();
+    }
+
+    size_t PgReactor::getInFlightCount() const
+    {
+        return m_inFlightCount;
+    }
+
+    void PgReactor::wake()
+    {
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(m_wakeFd, &one, sizeof(one));
+    }
+
+    void PgReactor::run()
+    {
+        static constexpr int MaxEvents = 64;
+        epoll_event events[MaxEvents];
+
+        while (!m_isStopping)
+        {
+            int count = epoll_wait(m_epollFd, events, MaxEvents, -1);
+            if (count < 0)
+            {
+                if (errno != EINTR)
+                {
+                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, std::string("epoll_wait failed: ") + std::strerror(errno));
+                }
+                continue;
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                int fd = events[i].data.fd;
+                if (fd == m_wakeFd)
+                {
+                    uint64_t value;
+                    [[maybe_unused]] auto bytesRead = read(m_wakeFd, &value, sizeof(value));
+                    drainPending();
+                    continue;
+                }
+                onReady(fd, events[i].events);
+            }
+        }
+    }
+
+    void PgReactor::drainPending()
+    {
+        std::vector<std::unique_ptr<PgPipeline>> pending;
+        {
+            std::lock_guard lock(m_pendingMtx);
+            pending.swap(m_pending);
+        }
+        for (auto& pipeline: pending)
+        {
+            start(std::move(pipeline));
+        }
+    }
+
+    void PgReactor::start(std::unique_ptr<PgPipeline>&& pipeline)
+    {
+        PGconn* connection = pipeline->connection;
+        int fd = PQsocket(connection);
+        if (fd < 0 || m_active.count(fd))
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Postgres connection is closed or already has a pipeline in flight");
+            m_inFlightCount--;
+            pipeline->complete(false);
+            return;
+        }
+
+        for (const auto& statement: pipeline->statements)
+        {
+            // the extended query protocol is the only one allowed in pipeline mode
+            if (!PQsendQueryParams(connection, statement.c_str(), 0, nullptr, nullptr, nullptr, nullptr, 0))
+            {
+                logConnectionError(connection, "Failed to queue postgres statement");
+                pipeline->hasFailed = true;
+                break;
+            }
+        }
+        // the sync point is still needed after a failed send so that the connection gets back to a usable state
+        int flushStatus = PQpipelineSync(connection) ? PQflush(connection) : -1;
+        if (flushStatus < 0)
+        {
+            logConnectionError(connection, "Failed to send postgres pipeline");
+            m_inFlightCount--;
+            pipeline->complete(false);
+            return;
+        }
+        pipeline->isFlushing = flushStatus == 1;
+        pipeline->statements.clear();
+
+        epoll_event event{};
+        event.events = EPOLLIN | (pipeline->isFlushing ? EPOLLOUT : 0u);
+        event.data.fd = fd;
+        if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, std::string("Failed to watch postgres socket: ") + std::strerror(errno));
+            m_inFlightCount--;
+            pipeline->complete(false);
+            return;
+        }
+        m_active.emplace(fd, std::move(pipeline));
+    }
+
+    void PgReactor::onReady(int fd, uint32_t events)
+    {
+        auto it = m_active.find(fd);
+        if (it == m_active.end())
+        {
+            return;
+        }
+        PgPipeline& pipeline = *it->second;
+        PGconn* connection = pipeline.connection;
+
+        if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        {
+            if (!PQconsumeInput(connection))
+            {
+                logConnectionError(connection, "Failed to read from postgres");
+                finish(fd, false);
+                return;
+            }
+        }
+        if (pipeline.isFlushing)
+        {
+            // libpq may need to read before it can write, so retry on every wake up rather than only on EPOLLOUT
+            int flushStatus = PQflush(connection);
+            if (flushStatus < 0)
+            {
+                logConnectionError(connection, "Failed to send postgres pipeline");
+                finish(fd, false);
+                return;
+            }
+            if (flushStatus == 0)
+            {
+                pipeline.isFlushing = false;
+                epoll_event event{};
+                event.events = EPOLLIN;
+                event.data.fd = fd;
+                epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event);
+            }
+        }
+        readResults(pipeline);
+    }
+
+    void PgReactor::readResults(PgPipeline& pipeline)
+    {
+        PGconn* connection = pipeline.connection;
+        int fd = PQsocket(connection);
+
+        while (!PQisBusy(connection))
+        {
+            PGresult* raw = PQgetResult(connection);
+            if (!raw)
+            {
+                // marks the end of one statement's results, the next statement follows
+                continue;
+            }
+            PgResultPtr result(raw, PQclear);
+            switch (PQresultStatus(raw))
+            {
+                case PGRES_PIPELINE_SYNC:
+                    finish(fd, true);
+                    return;
+                case PGRES_TUPLES_OK:
+                    if (PQntuples(raw) > 0)
+                    {
+                        pipeline.results.emplace_back(std::move(result));
+                    }
+                    break;
+                case PGRES_COMMAND_OK:
+                    break;
+                case PGRES_PIPELINE_ABORTED:
+                    // statements following a failed one are skipped by the server
+                    pipeline.hasFailed = true;
+                    break;
+                default:
+                    Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, std::string("Postgres statement failed: ") + PQresultErrorMessage(raw));
+                    pipeline.hasFailed = true;
+                    break;
+            }
+        }
+    }
+
+    void PgReactor::finish(int fd, bool isSuccess)
+    {
+        auto it = m_active.find(fd);
+        if (it == m_active.end())
+        {
+            return;
+        }
+        std::unique_ptr<PgPipeline> pipeline = std::move(it->second);
+        m_active.erase(it);
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+        m_inFlightCount--;
+        pipeline->complete(isSuccess);
+    }
+
+    void PgReactor::abortAll()
+    {
+        std::vector<std::unique_ptr<PgPipeline>> pending;
+        {
+            std::lock_guard lock(m_pendingMtx);
+            pending.swap(m_pending);
+        }
+        for (auto& pipeline: pending)
+        {
+            m_inFlightCount--;
+            pipeline->complete(false);
+        }
+        for (auto& [fd, pipeline]: m_active)
+        {
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            m_inFlightCount--;
+            pipeline->complete(false);
+        }
+        m_active.clear();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <postgresql/libpq-fe.h>
+
+namespace siren::cloud::postgres
+{
+    using PgResultPtr = std::shared_ptr<PGresult>;
+
+    struct PgPipelineResult
+    {
+        bool isSuccess{false};
+        // only results that carry rows are kept, in the order of their statements
+        std::vector<PgResultPtr> results;
+    };
+
+    struct PgPipeline;
+
+    /*
+     * Single thread multiplexing libpq connections in non-blocking pipeline mode through epoll.
+     * All statements of one submission are sent back to back and followed by a single sync point,
+     * so they run in one implicit transaction and cost one round trip.
+     * A connection must not be touched by its owner while a submission on it is in flight.
+     */
+    class PgReactor
+    {
+    public:
+        using Callback = std::function<void(PgPipelineResult&&)>;
+
+        PgReactor();
+        ~PgReactor();
+
+        PgReactor(const PgReactor& other) = delete;
+        PgReactor(PgReactor&& other) = delete;
+        PgReactor& operator=(const PgReactor& other) = delete;
+        PgReactor& operator=(PgReactor&& other) = delete;
+
+        static PgReactor& instance();
+
+        // opens a connection suitable for submit(), returns nullptr on failure
+        static PGconn* connect(const std::string& connectionString);
+
+        // the callback runs on the reactor thread and must stay cheap
+        void submit(PGconn* connection, std::vector<std::string>&& statements, Callback&& onComplete);
+
+        // co_await reactor.execute(...) resumes on the reactor thread, hop back onto the pool before doing real work
+        auto execute(PGconn* connection, std::vector<std::string>&& statements)
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<> handle)
+                {
+                    reactor->submit(connection, std::move(statements), [this, handle](PgPipelineResult&& pipelineResult) {
+                        result = std::move(pipelineResult);
+                        handle.resume();
+                    });
+                }
+
+                PgPipelineResult await_resume()
+                {
+                    return std::move(result);
+                }
+
+                PgReactor* reactor;
+                PGconn* connection;
+                std::vector<std::string> statements;
+                PgPipelineResult result;
+            };
+            return Awaiter{this, connection, std::move(statements), {}};
+        }
+
+        size_t getInFlightCount() const;
+
+    private:
+        void run();
+        void wake();
+        void drainPending();
+        void start(std::unique_ptr<PgPipeline>&& pipeline);
+        void onReady(int fd, uint32_t events);
+        void readResults(PgPipeline& pipeline);
+        void finish(int fd, bool isSuccess);
+        void abortAll();
+
+    private:
+        int m_epollFd{-1};
+        int m_wakeFd{-1};
+        std::unordered_map<int, std::unique_ptr<PgPipeline>> m_active;
+        std::vector<std::unique_ptr<PgPipeline>> m_pending;
+        std::mutex m_pendingMtx;
+        std::atomic<bool> m_isStopping{false};
+        std::atomic<size_t> m_inFlightCount{0};
+        std::thread m_thread;
+    };
+}
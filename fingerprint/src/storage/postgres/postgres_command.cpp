@@ -1,68 +1,179 @@
 #include "postgres_command.h"
 #include "postgres_connection.h"
+#include "../../thread_pool/async_manager.h"
 
 namespace siren::cloud::postgres
 {
     PostgresCommand::PostgresCommand(const DBConnectionPtr& conn, const Query& query)
         : AbstractCommand(query)
         , m_connection(conn)
-        , m_work(*(m_connection->getRawConnection()))
     {
     }
 
     PostgresCommand::PostgresCommand(const DBConnectionPtr& conn, Query&& query)
         : AbstractCommand(std::move(query))
         , m_connection(conn)
-        , m_work(*(m_connection->getRawConnection()))
     {
     }
 
     PostgresCommand::PostgresCommand(const DBConnectionPtr& conn, QueryCollection&& queries)
         : AbstractCommand(std::move(queries))
         , m_connection(conn)
-        , m_work(*(m_connection->getRawConnection()))
     {
     }
 
     bool PostgresCommand::isEmpty() const
     {
-        return m_bufVec.empty();
+        return m_bufVec.empty() && m_asyncBufVec.empty();
     }
 
-    bool PostgresCommand::execute()
+    bool PostgresCommand::getStatements(std::vector<std::string>& statements) const
     {
-        pqxx::pipeline pipe(m_work);
-        std::vector<size_t> ids;
-        for (auto&& query: getQueries())
+        statements.reserve(statements.size() + m_queries.size());
+        for (auto it = m_queries.cbegin(); it != m_queries.cend(); it++)
         {
-            std::string sql = query.get("query");
+            std::string sql = it->get("query");
             if (sql.empty())
             {
                 Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "PGQuery passed to createCommand() lacks sql field");
                 return false;
             }
+            statements.emplace_back(std::move(sql));
+        }
+        return true;
+    }
+
+    bool PostgresCommand::execute()
+    {
+        std::vector<std::string> statements;
+        if (!getStatements(statements))
+        {
+            return false;
+        }
+        if (m_cancellation.isCancelled())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "PGQuery was cancelled before it was sent");
+            return false;
+        }
+
+        // the transaction is opened here rather than on construction so that async commands never issue a BEGIN
+        m_work = std::make_unique<Transaction>(*(m_connection->getRawConnection()));
+        pqxx::pipeline pipe(*m_work);
+        if (m_cancellation.hasDeadline())
+        {
+            // scoped to this transaction, so pooled connections don't inherit it
+            pipe.insert("SET LOCAL statement_timeout = " + std::to_string(getStatementTimeout().count()));
+        }
+        std::vector<size_t> ids;
+        for (const auto& sql: statements)
+        {
             ids.push_back(pipe.insert(sql));
         }
-         pipe.complete();
-         m_work.commit();
-         for (size_t id: ids)
-         {
+        pipe.complete();
+        m_work->commit();
+        for (size_t id: ids)
+        {
             pqxx::result result = pipe.retrieve(id);
             if (!result.empty())
             {
                 m_bufVec.emplace_back(std::move(result));
             }
-         }
-        if (!m_bufVec.empty())
-        {
-            m_currBufIter = m_bufVec[m_idx].begin();
         }
         return true;
     }
 
+    coro::Task<bool> PostgresCommand::executeAsync(TaskPriority priority)
+    {
+        std::vector<std::string> statements;
+        // SET LOCAL has no effect in the implicit transaction of a pipeline, so the session value is overwritten on every run
+        statements.emplace_back("SET statement_timeout = " + std::to_string(getStatementTimeout().count()));
+        if (!getStatements(statements))
+        {
+            co_return false;
+        }
+        if (m_cancellation.isCancelled())
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "PGQuery was cancelled before it was sent");
+            co_return false;
+        }
+        PGconn* connection = m_connection->getPipelineConnection();
+        if (!connection)
+        {
+            co_return false;
+        }
+
+        // no thread is held while the statements are in flight, the reactor resumes us once the sync point arrives
+        PgPipelineResult result = co_await PgReactor::instance().execute(connection, std::move(statements));
+        co_await AsyncManager::instance().schedule(priority);
+        if (m_cancellation.isCancelled())
+        {
+            // whoever asked for the rows has given up while the resumption was queued
+            co_return false;
+        }
+        if (!result.isSuccess)
+        {
+            Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Postgres pipeline did not complete");
+            co_return false;
+        }
+        m_asyncBufVec = std::move(result.results);
+        co_return true;
+    }
+
+    std::chrono::milliseconds PostgresCommand::getStatementTimeout() const
+    {
+        // 0 disables the server side timeout, an expired deadline still gets the smallest possible one
+        if (!m_cancellation.hasDeadline())
+        {
+            return std::chrono::milliseconds{0};
+        }
+        return std::max(m_cancellation.getRemaining({}), std::chrono::milliseconds{1});
+    }
+
+    size_t PostgresCommand::getBufferCount() const
+    {
+        return !m_asyncBufVec.empty() ? m_asyncBufVec.size() : m_bufVec.size();
+    }
+
+    size_t PostgresCommand::getRowCount(size_t idx) const
+    {
+        if (!m_asyncBufVec.empty())
+        {
+            return static_cast<size_t>(PQntuples(m_asyncBufVec[idx].get()));
+        }
+        return m_bufVec[idx].size();
+    }
+
+    bool PostgresCommand::getField(const std::string& columnName, bool& isNull, std::string_view& text) const
+    {
+        if (!m_asyncBufVec.empty())
+        {
+            const PGresult* result = m_asyncBufVec[m_idx].get();
+            int column = PQfnumber(result, columnName.c_str());
+            if (column < 0)
+            {
+                return false;
+            }
+            int row = static_cast<int>(m_row);
+            isNull = PQgetisnull(result, row, column);
+            text = std::string_view(PQgetvalue(result, row, column), PQgetlength(result, row, column));
+            return true;
+        }
+        try
+        {
+            pqxx::field field = m_bufVec[m_idx][m_row].at(columnName);
+            isNull = field.is_null();
+            text = field.view();
+            return true;
+        }
+        catch (const std::exception& ex)
+        {
+            return false;
+        }
+    }
+
     bool PostgresCommand::fetchNext()
     {
-        if (m_bufVec.empty() || m_currBufIter == m_bufVec[m_bufVec.size()-1].end())
+        if (isEmpty())
         {
             return false;
         }
@@ -71,15 +182,15 @@ namespace siren::cloud::postgres
             m_isFirstIter = false;
             return true;
         }
-        if (m_currBufIter != m_bufVec[m_idx].end() - 1)
+        if (m_row + 1 < getRowCount(m_idx))
         {
-            m_currBufIter++;
+            m_row++;
             return true;
         }
-        if (m_idx < m_bufVec.size() - 1)
+        if (m_idx + 1 < getBufferCount())
         {
             m_idx++;
-            m_currBufIter = m_bufVec[m_idx].begin();
+            m_row = 0;
             return true;
         }
         return false;
@@ -87,10 +198,10 @@ namespace siren::cloud::postgres
 
     size_t PostgresCommand::getSize() const
     {
-        size_t outerSize = m_bufVec.size();
+        size_t outerSize = getBufferCount();
         if (outerSize > 0)
         {
-            size_t innerSize = m_bufVec.begin()->size();
+            size_t innerSize = getRowCount(0);
             return outerSize * innerSize;
         }
         return outerSize;
@@ -2,6 +2,7 @@
 
 #include <pqxx/pqxx>
 #include "../abstract_command.h"
+#include "pg_reactor.h"
 #include "../../logger/logger.h"
 
 namespace siren::cloud::postgres
@@ -11,7 +12,6 @@ namespace siren::cloud::postgres
 
     using Transaction = pqxx::work;
     using Buffer = pqxx::result;
-    using BufferIter = Buffer::iterator;
     using BufferVec = std::vector<Buffer>;
 
     class PostgresCommand: public AbstractCommand
@@ -22,6 +22,7 @@ namespace siren::cloud::postgres
         PostgresCommand(const DBConnectionPtr& conn, QueryCollection&& queries);
 
         [[nodiscard]] bool execute() override;
+        [[nodiscard]] coro::Task<bool> executeAsync(TaskPriority priority=TaskPriority::Interactive) override;
         bool isEmpty() const override;
         bool fetchNext() override;
         bool asInt32(const std::string& columnName, int32_t& val) const override;
@@ -36,36 +37,51 @@ namespace siren::cloud::postgres
         size_t getSize() const override;
 
     private:
+        bool getStatements(std::vector<std::string>& statements) const;
+        std::chrono::milliseconds getStatementTimeout() const;
+        size_t getBufferCount() const;
+        size_t getRowCount(size_t idx) const;
+        bool getField(const std::string& columnName, bool& isNull, std::string_view& text) const;
+
         template<typename T>
         bool asValue(const std::string& columnName, T& value) const
         {
-            if (m_bufVec.empty())
+            if (isEmpty())
             {
                 Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "PGQuery did not return any results");
                 return false;
             }
-            try
+            bool isNull;
+            std::string_view text;
+            if (!getField(columnName, isNull, text))
+            {
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Requested PGField is not present in the result");
+                return false;
+            }
+            if (isNull)
             {
-                pqxx::field field = m_currBufIter->at(columnName);
-                if (!field.is_null())
-                {
-                    value = field.as<T>();
-                    return true;
-                }
                 Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Requested PGField is null");
                 return false;
             }
+            try
+            {
+                value = pqxx::from_string<T>(text);
+                return true;
+            }
             catch (const std::exception& ex)
             {
-                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Requested PGField is not present in the result");
+                Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Requested PGField could not be converted");
                 return false;
             }
         }
     private:
         DBConnectionPtr m_connection;
-        Transaction m_work;
+        std::unique_ptr<Transaction> m_work;
+        // filled by execute()
         BufferVec m_bufVec;
-        BufferIter m_currBufIter;
+        // filled by executeAsync()
+        std::vector<PgResultPtr> m_asyncBufVec;
+        size_t m_row{0};
     };
 
 }// namespace siren::service::postgres
\ No newline at end of file
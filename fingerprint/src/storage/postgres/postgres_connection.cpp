@@ -10,6 +10,14 @@ namespace siren::cloud::postgres
     {
     }
 
+    PostgresConnection::~PostgresConnection()
+    {
+        if (m_pipelineConnection)
+        {
+            PQfinish(m_pipelineConnection);
+        }
+    }
+
     bool PostgresConnection::open()
     {
         if (isAlive())
@@ -22,6 +30,11 @@ namespace siren::cloud::postgres
 
     bool PostgresConnection::close()
     {
+        if (m_pipelineConnection)
+        {
+            PQfinish(m_pipelineConnection);
+            m_pipelineConnection = nullptr;
+        }
         m_connection.close();
         return !m_connection.is_open();
     }
@@ -64,4 +77,19 @@ namespace siren::cloud::postgres
         return &m_connection;
     }
 
+    PGconn* PostgresConnection::getPipelineConnection()
+    {
+        // a pipeline interrupted by an error or a shutdown leaves the connection mid-transaction, it cannot be reused
+        if (m_pipelineConnection && (PQstatus(m_pipelineConnection) != CONNECTION_OK || PQtransactionStatus(m_pipelineConnection) != PQTRANS_IDLE))
+        {
+            PQfinish(m_pipelineConnection);
+            m_pipelineConnection = nullptr;
+        }
+        if (!m_pipelineConnection)
+        {
+            m_pipelineConnection = PgReactor::connect(getConnectionStr());
+        }
+        return m_pipelineConnection;
+    }
+
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <pqxx/pqxx>
 #include "../abstract_connection.h"
+#include "pg_reactor.h"
 
 namespace siren::cloud::postgres
 {
@@ -13,6 +14,7 @@ namespace siren::cloud::postgres
 
     public:
         explicit PostgresConnection(const std::string& connectionString);
+        ~PostgresConnection() override;
 
         bool open() override;
         bool close() override;
@@ -25,9 +27,12 @@ namespace siren::cloud::postgres
 
     private:
         Connection* getRawConnection();
+        PGconn* getPipelineConnection();
 
     private:
         Connection m_connection;
+        // opened on first async execution, pqxx does not expose its own handle for non-blocking use
+        PGconn* m_pipelineConnection{nullptr};
     };
 
     using DBConnectionPtr = std::shared_ptr<PostgresConnection>;
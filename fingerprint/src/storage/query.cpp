@@ -46,6 +46,26 @@ std::string Query::get(const std::string& key) const
     return {};
 }
 
+std::string_view Query::view(const std::string& key) const
+{
+    auto it = m_body.find(key);
+    if (it != m_body.end())
+    {
+        return it->second;
+    }
+    return {};
+}
+
+std::string Query::take(const std::string& key)
+{
+    auto it = m_body.find(key);
+    if (it != m_body.end())
+    {
+        return std::move(it->second);
+    }
+    return {};
+}
+
 
 QueryCollection::QueryCollection(const Query& query)
     : m_queries{query}
@@ -58,7 +78,12 @@ QueryCollection::QueryCollection(QueryCollection::iterator begin, QueryCollectio
     m_queries = std::move(map);
 }
 
-Query QueryCollection::operator[](size_t i) const
+const Query& QueryCollection::operator[](size_t i) const
+{
+    return m_queries[i];
+}
+
+Query& QueryCollection::operator[](size_t i)
 {
     return m_queries[i];
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -14,6 +15,10 @@ public:
     void emplace(const std::string& key, const std::string& value);
     void emplace(const std::string& key, std::string&& value);
     std::string get(const std::string& key) const;
+    // valid until the query is changed, empty for a missing key
+    std::string_view view(const std::string& key) const;
+    // moves the value out, leaving the key empty
+    std::string take(const std::string& key);
     bool keyCompare(const Query& other) const;
     size_t getSize() const;
 
@@ -31,7 +36,8 @@ public:
     QueryCollection(const Query& query);
     QueryCollection(iterator begin, iterator end);
 
-    Query operator[](size_t i) const;
+    const Query& operator[](size_t i) const;
+    Query& operator[](size_t i);
     iterator begin();
     iterator end();
     const_iterator cbegin() const;
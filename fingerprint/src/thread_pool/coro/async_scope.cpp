@@ -0,0 +1,36 @@
+#include "async_scope.h"
+#include "../../logger/logger.h"
+
+namespace siren::cloud::coro
+{
+    AsyncScope::~AsyncScope()
+    {
+        join();
+    }
+
+    void AsyncScope::join()
+    {
+        std::unique_lock lock(m_mtx);
+        m_cv.wait(lock, [&] { return m_activeCount == 0; });
+    }
+
+    size_t AsyncScope::getActiveCount() const
+    {
+        return m_activeCount;
+    }
+
+    void AsyncScope::reportFailure(const std::string& what)
+    {
+        Logger::log(LogLevel::ERROR, __FILE__, __FUNCTION__, __LINE__, "Spawned task has failed: " + what);
+    }
+
+    void AsyncScope::release()
+    {
+        // notifying under the lock keeps the scope alive until the joining thread can observe the new count
+        std::lock_guard lock(m_mtx);
+        if (--m_activeCount == 0)
+        {
+            m_cv.notify_all();
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include "task.h"
+
+namespace siren::cloud::coro
+{
+    /*
+     * Owns fire-and-forget tasks. A task is accounted for from the moment it is spawned,
+     * so join() cannot miss work that has not started running yet.
+     */
+    class AsyncScope
+    {
+    public:
+        AsyncScope() = default;
+        ~AsyncScope();
+
+        AsyncScope(const AsyncScope& other) = delete;
+        AsyncScope(AsyncScope&& other) = delete;
+        AsyncScope& operator=(const AsyncScope& other) = delete;
+        AsyncScope& operator=(AsyncScope&& other) = delete;
+
+        // the task starts running inline on the calling thread, its result is discarded
+        template <typename T>
+        void spawn(Task<T>&& task)
+        {
+            m_activeCount++;
+            run(std::move(task), this);
+        }
+
+        // the returned task is awaited as usual, but the scope keeps accounting for it even once its awaiter has moved on
+        template <typename T>
+        Task<T> track(Task<T>&& task)
+        {
+            m_activeCount++;
+            return runTracked(Lease(this), std::move(task));
+        }
+
+        void join();
+        size_t getActiveCount() const;
+
+    private:
+        class Lease
+        {
+        public:
+            explicit Lease(AsyncScope* scope)
+                : m_scope(scope)
+            {
+            }
+
+            Lease(Lease&& other) noexcept
+                : m_scope(std::exchange(other.m_scope, nullptr))
+            {
+            }
+
+            Lease(const Lease& other) = delete;
+            Lease& operator=(const Lease& other) = delete;
+            Lease& operator=(Lease&& other) = delete;
+
+            ~Lease()
+            {
+                if (m_scope)
+                {
+                    m_scope->release();
+                }
+            }
+
+        private:
+            AsyncScope* m_scope;
+        };
+
+        // the lease goes with the frame, so a task that is dropped without ever running is released as well
+        template <typename T>
+        static Task<T> runTracked(Lease lease, Task<T> task)
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                co_await std::move(task);
+                task = {};
+            }
+            else
+            {
+                T result = co_await std::move(task);
+                task = {};
+                co_return result;
+            }
+        }
+
+        template <typename T>
+        static detail::Detached run(Task<T> task, AsyncScope* scope)
+        {
+            try
+            {
+                co_await std::move(task);
+            }
+            catch (const std::exception& e)
+            {
+                scope->reportFailure(e.what());
+            }
+            catch (...)
+            {
+                scope->reportFailure("unknown error");
+            }
+            // the finished frame may still hold parameters referring to the scope's owner, so it goes first
+            task = {};
+            scope->release();
+        }
+
+        void reportFailure(const std::string& what);
+        void release();
+
+    private:
+        std::atomic<size_t> m_activeCount{0};
+        std::mutex m_mtx;
+        std::condition_variable m_cv;
+    };
+}
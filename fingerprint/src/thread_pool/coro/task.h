@@ -0,0 +1,501 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace siren::cloud::coro
+{
+    template <typename T = void>
+    class Task;
+
+    // value produced by a Task<T>, void is represented by std::monostate so that it can be stored
+    template <typename T>
+    using Result = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+    namespace detail
+    {
+        // transfers control straight to the awaiting coroutine, so long co_await chains don't grow the stack
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                auto continuation = handle.promise().m_continuation;
+                if (continuation)
+                {
+                    return continuation;
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        struct PromiseBase
+        {
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void unhandled_exception() noexcept
+            {
+                m_exception = std::current_exception();
+            }
+
+            void rethrowIfFailed()
+            {
+                if (m_exception)
+                {
+                    std::rethrow_exception(m_exception);
+                }
+            }
+
+            std::coroutine_handle<> m_continuation;
+            std::exception_ptr m_exception;
+        };
+
+        template <typename T>
+        struct Promise: PromiseBase
+        {
+            Task<T> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U&& value)
+            {
+                m_value.emplace(std::forward<U>(value));
+            }
+
+            T result()
+            {
+                rethrowIfFailed();
+                return std::move(*m_value);
+            }
+
+            std::optional<T> m_value;
+        };
+
+        template <>
+        struct Promise<void>: PromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+
+            void return_void() noexcept
+            {
+            }
+
+            void result()
+            {
+                rethrowIfFailed();
+            }
+        };
+
+        // eagerly started coroutine that owns its frame, used to drive Tasks from non-coroutine code
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept
+                {
+                    return {};
+                }
+
+                void return_void() noexcept
+                {
+                }
+
+                void unhandled_exception() noexcept
+                {
+                    std::terminate();
+                }
+            };
+        };
+    }
+
+    /*
+     * Lazily started coroutine, the body runs only once the task is awaited.
+     * Awaiting a task resumes the awaiter on whichever thread the task completes on.
+     */
+    template <typename T>
+    class [[nodiscard]] Task
+    {
+    public:
+        using promise_type = detail::Promise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        Task() = default;
+
+        explicit Task(Handle handle)
+            : m_handle(handle)
+        {
+        }
+
+        Task(Task&& other) noexcept
+            : m_handle(std::exchange(other.m_handle, {}))
+        {
+        }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                m_handle = std::exchange(other.m_handle, {});
+            }
+            return *this;
+        }
+
+        Task(const Task& other) = delete;
+        Task& operator=(const Task& other) = delete;
+
+        ~Task()
+        {
+            destroy();
+        }
+
+        bool valid() const
+        {
+            return static_cast<bool>(m_handle);
+        }
+
+        auto operator co_await() && noexcept
+        {
+            return Awaiter{m_handle};
+        }
+
+        auto operator co_await() & noexcept
+        {
+            return Awaiter{m_handle};
+        }
+
+    private:
+        struct Awaiter
+        {
+            bool await_ready() const noexcept
+            {
+                return handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().m_continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().result();
+            }
+
+            Handle handle;
+        };
+
+        void destroy()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+                m_handle = {};
+            }
+        }
+
+    private:
+        Handle m_handle;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        Task<T> Promise<T>::get_return_object() noexcept
+        {
+            return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+        }
+
+        inline Task<void> Promise<void>::get_return_object() noexcept
+        {
+            return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+        }
+
+        template <typename T>
+        Detached fulfil(Task<T> task, std::promise<T> promise)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await std::move(task);
+                    promise.set_value();
+                }
+                else
+                {
+                    promise.set_value(co_await std::move(task));
+                }
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        }
+
+        // count is one higher than the number of children, the awaiting coroutine takes the extra arrival
+        class Latch
+        {
+        public:
+            explicit Latch(size_t count)
+                : m_remaining(count + 1)
+            {
+            }
+
+            // returns true for the last arrival, which is responsible for resuming the continuation
+            bool countDown()
+            {
+                return m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            }
+
+            std::coroutine_handle<> m_continuation;
+
+        private:
+            std::atomic<size_t> m_remaining;
+        };
+
+        template <typename T>
+        Detached runLatched(Task<T> task, std::optional<Result<T>>& result, std::exception_ptr& error, Latch& latch)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await std::move(task);
+                    result.emplace();
+                }
+                else
+                {
+                    result.emplace(co_await std::move(task));
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            if (latch.countDown())
+            {
+                latch.m_continuation.resume();
+            }
+        }
+
+        template <typename T>
+        struct WhenAllAwaiter
+        {
+            WhenAllAwaiter(std::vector<Task<T>>& tasks, std::vector<std::optional<Result<T>>>& results, std::vector<std::exception_ptr>& errors)
+                : tasks(tasks)
+                , results(results)
+                , errors(errors)
+                , latch(tasks.size())
+            {
+            }
+
+            bool await_ready() const noexcept
+            {
+                return tasks.empty();
+            }
+
+            bool await_suspend(std::coroutine_handle<> awaiting)
+            {
+                latch.m_continuation = awaiting;
+                for (size_t i = 0; i < tasks.size(); i++)
+                {
+                    runLatched(std::move(tasks[i]), results[i], errors[i], latch);
+                }
+                // every child may have already finished inline, in which case there is nobody left to resume us
+                return !latch.countDown();
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+
+            std::vector<Task<T>>& tasks;
+            std::vector<std::optional<Result<T>>>& results;
+            std::vector<std::exception_ptr>& errors;
+            Latch latch;
+        };
+
+        template <typename T>
+        struct WhenAnyState
+        {
+            std::atomic<bool> m_hasWinner{false};
+            std::atomic<bool> m_isHandshakeDone{false};
+            std::atomic<size_t> m_remaining{0};
+            // results it rejects only win when nothing else is left, an empty predicate accepts everything
+            std::function<bool(const Result<T>&)> m_accept;
+            std::coroutine_handle<> m_continuation;
+            size_t m_index{0};
+            std::optional<Result<T>> m_result;
+            std::exception_ptr m_error;
+
+            // the awaiting coroutine and the winner both arrive here, the second one resumes the continuation
+            bool arrive()
+            {
+                return m_isHandshakeDone.exchange(true, std::memory_order_acq_rel);
+            }
+        };
+
+        template <typename T>
+        Detached runRacing(Task<T> task, size_t index, std::shared_ptr<WhenAnyState<T>> state)
+        {
+            std::optional<Result<T>> result;
+            std::exception_ptr error;
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await std::move(task);
+                    result.emplace();
+                }
+                else
+                {
+                    result.emplace(co_await std::move(task));
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            bool isLast = state->m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            bool isAccepted = error || !state->m_accept || state->m_accept(*result);
+            if (!isAccepted && !isLast)
+            {
+                co_return;
+            }
+            if (state->m_hasWinner.exchange(true, std::memory_order_acq_rel))
+            {
+                co_return;
+            }
+            state->m_index = index;
+            state->m_result = std::move(result);
+            state->m_error = error;
+            if (state->arrive())
+            {
+                state->m_continuation.resume();
+            }
+        }
+
+        template <typename T>
+        struct WhenAnyAwaiter
+        {
+            WhenAnyAwaiter(std::vector<Task<T>>& tasks, std::shared_ptr<WhenAnyState<T>> state)
+                : tasks(tasks)
+                , state(std::move(state))
+            {
+            }
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> awaiting)
+            {
+                state->m_continuation = awaiting;
+                for (size_t i = 0; i < tasks.size(); i++)
+                {
+                    runRacing(std::move(tasks[i]), i, state);
+                }
+                return !state->arrive();
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+
+            std::vector<Task<T>>& tasks;
+            std::shared_ptr<WhenAnyState<T>> state;
+        };
+    }
+
+    // blocks the calling thread until the task completes, must not be called from a thread the task needs to make progress
+    template <typename T>
+    T syncWait(Task<T>&& task)
+    {
+        std::promise<T> promise;
+        auto future = promise.get_future();
+        detail::fulfil(std::move(task), std::move(promise));
+        return future.get();
+    }
+
+    // runs all tasks concurrently and resumes once each of them has completed, the first failure is rethrown
+    template <typename T>
+    Task<std::vector<Result<T>>> whenAll(std::vector<Task<T>> tasks)
+    {
+        std::vector<std::optional<Result<T>>> results(tasks.size());
+        std::vector<std::exception_ptr> errors(tasks.size());
+        co_await detail::WhenAllAwaiter<T>(tasks, results, errors);
+
+        std::vector<Result<T>> values;
+        values.reserve(results.size());
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            if (errors[i])
+            {
+                std::rethrow_exception(errors[i]);
+            }
+            values.emplace_back(std::move(*results[i]));
+        }
+        co_return values;
+    }
+
+    /*
+     * Resumes with the index and value of the first task to complete whose result is accepted,
+     * or with the last one to complete when none is. A failure is always accepted and rethrown.
+     * The remaining tasks are not cancelled, they run to completion in the background and their results are dropped.
+     */
+    template <typename T>
+    Task<std::pair<size_t, Result<T>>> whenAny(std::vector<Task<T>> tasks, std::type_identity_t<std::function<bool(const Result<T>&)>> accept = {})
+    {
+        if (tasks.empty())
+        {
+            throw std::invalid_argument("whenAny requires at least one task");
+        }
+        auto state = std::make_shared<detail::WhenAnyState<T>>();
+        state->m_remaining = tasks.size();
+        state->m_accept = std::move(accept);
+        co_await detail::WhenAnyAwaiter<T>(tasks, state);
+
+        if (state->m_error)
+        {
+            std::rethrow_exception(state->m_error);
+        }
+        co_return std::pair<size_t, Result<T>>{state->m_index, std::move(*state->m_result)};
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include "../async_manager.h"
+
+namespace siren::cloud::coro
+{
+    /*
+     * One-shot event a single coroutine waits on with a timeout. co_await wait() resumes on a pool thread
+     * once the delay has passed or the event has been set, whichever comes first. Copies share the event.
+     */
+    class TimedEvent
+    {
+    public:
+        void set() const
+        {
+            m_state->isSet = true;
+            if (m_state->isWaiting)
+            {
+                m_state->resume(true);
+            }
+        }
+
+        bool isSet() const
+        {
+            return m_state->isSet;
+        }
+
+        auto wait(std::chrono::milliseconds delay, TaskPriority priority=TaskPriority::Interactive)
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return state->isSet;
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle)
+                {
+                    // the awaiter is gone as soon as another thread resumes the coroutine, only the local copy may be touched
+                    auto shared = state;
+                    shared->handle = handle;
+                    shared->priority = priority;
+                    shared->isWaiting = true;
+                    if (shared->isSet)
+                    {
+                        // set in the meantime, whoever claims the resume first runs it
+                        return !shared->claim();
+                    }
+                    if (delay.count() <= 0)
+                    {
+                        shared->resume(true);
+                        return true;
+                    }
+                    // a timer dropped by a full queue leaves the resume to set()
+                    AsyncManager::instance().submitAfter(delay, [shared] { shared->resume(false); }, priority);
+                    return true;
+                }
+
+                void await_resume() const noexcept
+                {
+                }
+
+                std::shared_ptr<State> state;
+                std::chrono::milliseconds delay;
+                TaskPriority priority;
+            };
+            return Awaiter{m_state, delay, priority};
+        }
+
+    private:
+        struct State
+        {
+            bool claim()
+            {
+                return !isResumed.exchange(true);
+            }
+
+            // the timer already runs on a pool thread, set() hands the coroutine over instead of running it on the caller
+            void resume(bool isPosted)
+            {
+                if (!claim())
+                {
+                    return;
+                }
+                if (!isPosted || !AsyncManager::instance().post([waiter = handle] { waiter.resume(); }, priority))
+                {
+                    handle.resume();
+                }
+            }
+
+            std::atomic<bool> isSet{false};
+            std::atomic<bool> isWaiting{false};
+            std::atomic<bool> isResumed{false};
+            std::coroutine_handle<> handle;
+            TaskPriority priority{TaskPriority::Interactive};
+        };
+
+        std::shared_ptr<State> m_state = std::make_shared<State>();
+    };
+}
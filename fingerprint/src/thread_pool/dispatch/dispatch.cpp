@@ -57,16 +57,39 @@ namespace siren::cloud
 
     void QueueDispatch::pushTaskToLeastBusy(Task&& task)
     {
-        QueuePtr queue = extractLeastBusy();
-        queue->push(std::move(task));
-        insertQueue(queue);
+        // the queue is reinserted under the same lock so that concurrent producers never observe an empty set
+        std::unique_lock lock(m_setMtx);
+        auto nodeHandle = m_set.extract(m_set.begin());
+        nodeHandle.value()->push(std::move(task));
+        m_set.insert(std::move(nodeHandle));
     }
 
-    QueuePtr QueueDispatch::extractLeastBusy()
+    bool QueueDispatch::tryPushTaskToLeastBusy(Task& task)
     {
         std::unique_lock lock(m_setMtx);
-        auto nodeHandle = m_set.extract(m_set.begin());
-        return nodeHandle.value();
+        for (auto it = m_set.begin(); it != m_set.end(); it++)
+        {
+            if ((*it)->isFull(task.getPriority()))
+            {
+                continue;
+            }
+            auto nodeHandle = m_set.extract(it);
+            bool isPushed = nodeHandle.value()->tryPush(task);
+            m_set.insert(std::move(nodeHandle));
+            return isPushed;
+        }
+        return false;
+    }
+
+    size_t QueueDispatch::getQueueDepth(TaskPriority priority) const
+    {
+        std::shared_lock lock(m_setMtx);
+        size_t depth = 0;
+        for (const auto& queue: m_set)
+        {
+            depth += queue->getCurrentSize(priority);
+        }
+        return depth;
     }
 
     void QueueDispatch::insertQueue(const QueuePtr& queueBlockPtr)
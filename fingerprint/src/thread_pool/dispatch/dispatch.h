@@ -4,13 +4,14 @@
 #include <set>
 #include "../callback/callback.h"
 #include "../primitives/task.h"
+#include "../primitives/priority_queue.h"
 #include "../../common/safe_queue.h"
 #include "../../logger/logger.h"
 
 namespace siren::cloud
 {
     using Task = PackagedTask<void>;
-    using Queue = SafeQueue<Task>;
+    using Queue = SafePriorityQueue<Task>;
     using QueuePtr = std::shared_ptr<Queue>;
 
     class QueueDispatch
@@ -29,13 +30,14 @@ namespace siren::cloud
         void insertQueue(const QueuePtr& queueBlockPtr);
         void assignThreadIdToQueue(size_t threadId, const QueuePtr& queuePtr);
         void pushTaskToLeastBusy(Task&& callBack);
+        bool tryPushTaskToLeastBusy(Task& task);
+        size_t getQueueDepth(TaskPriority priority) const;
         Task extractTaskByThreadId(size_t threadId);
         void clear();
 
     private:
         iterator begin();
         iterator end();
-        QueuePtr extractLeastBusy();
 
     private:
         mutable std::shared_mutex m_setMtx;
@@ -3,13 +3,15 @@
 namespace siren::cloud
 {
 
-    ThreadPool::ThreadPool(size_t numberOfQueues, size_t threadsPerQueue, bool isGraceful)
+    ThreadPool::ThreadPool(size_t numberOfQueues, size_t threadsPerQueue, bool isGraceful, const SchedulingPolicy& policy, const BackpressurePolicy& backpressure)
         : m_isGraceful(isGraceful)
+        , m_backpressure(backpressure)
+        , m_timerResolution(policy.timerResolution)
     {
         std::unique_lock lock(m_poolMtx);
         for (size_t i = 0; i < numberOfQueues; i++)
         {
-            auto queue = std::make_shared<Queue>(i);
+            auto queue = std::make_shared<Queue>(i, policy, backpressure.capacity);
             m_primaryDispatch.insertQueue(queue);
             for (size_t j = 0; j < threadsPerQueue; j++)
             {
@@ -48,6 +50,11 @@ namespace siren::cloud
             }
             if (task.valid())
             {
+                if (m_blockedProducers != 0)
+                {
+                    std::lock_guard lock(m_spaceMtx);
+                    m_spaceCv.notify_all();
+                }
                 m_jobCount--;
                 m_runningJobCount++;
                 task();
@@ -57,6 +64,119 @@ namespace siren::cloud
         }
     }
 
+    bool ThreadPool::tryEnqueue(Task& task)
+    {
+        m_jobCount++;
+        if (m_primaryDispatch.tryPushTaskToLeastBusy(task))
+        {
+            return true;
+        }
+        m_jobCount--;
+        return false;
+    }
+
+    void ThreadPool::resumeDropped(std::coroutine_handle<> handle, TaskPriority priority)
+    {
+        if (m_shutDown)
+        {
+            // no worker is left to run it, the caller finishes the coroutine as schedule() does when the queues refuse it
+            handle.resume();
+            return;
+        }
+        // a single resume per dropped timer, letting it past the capacity keeps the coroutine from being lost
+        m_jobCount++;
+        m_primaryDispatch.pushTaskToLeastBusy(Task(CallBack([handle] { handle.resume(); }, 0), priority));
+    }
+
+    bool ThreadPool::enqueue(Task& task, bool isCallerRunsAllowed)
+    {
+        if (tryEnqueue(task))
+        {
+            return true;
+        }
+
+        switch (m_backpressure.overflow[toLevel(task.getPriority())])
+        {
+            case OverflowPolicy::CallerRuns:
+                // post() must not run the task itself, so the task is rejected
+                if (!isCallerRunsAllowed)
+                {
+                    break;
+                }
+                task();
+                m_callerRunsCount++;
+                return true;
+            case OverflowPolicy::BlockWithTimeout:
+            {
+                auto deadline = std::chrono::steady_clock::now() + m_backpressure.blockTimeout;
+                std::unique_lock lock(m_spaceMtx);
+                m_blockedProducers++;
+                bool isPushed = false;
+                while (!m_shutDown)
+                {
+                    m_jobCount++;
+                    if (m_primaryDispatch.tryPushTaskToLeastBusy(task))
+                    {
+                        isPushed = true;
+                        break;
+                    }
+                    m_jobCount--;
+                    if (m_spaceCv.wait_until(lock, deadline) == std::cv_status::timeout)
+                    {
+                        break;
+                    }
+                }
+                m_blockedProducers--;
+                if (isPushed)
+                {
+                    return true;
+                }
+                m_timedOutCount++;
+                break;
+            }
+            case OverflowPolicy::Reject:
+                break;
+        }
+        m_rejectedCount++;
+        Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "ThreadPool queue is full, task has been rejected");
+        return false;
+    }
+
+    TimerWheel& ThreadPool::getTimerWheel()
+    {
+        std::call_once(m_timerFlag, [this] {
+            m_timerWheel = std::make_unique<TimerWheel>(
+                [this](CallBack&& callback, TaskPriority priority) {
+                    // the timer thread neither waits for room nor runs the task itself, every other timer would stall behind it
+                    Task task(std::move(callback), priority);
+                    if (m_shutDown || !tryEnqueue(task))
+                    {
+                        m_droppedTimerCount++;
+                        Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "ThreadPool queue is full, delayed task has been dropped");
+                    }
+                },
+                m_timerResolution);
+        });
+        return *m_timerWheel;
+    }
+
+    ThreadPoolStats ThreadPool::getStats() const
+    {
+        ThreadPoolStats stats;
+        for (size_t i = 0; i < PriorityLevelCount; i++)
+        {
+            stats.queueDepthByPriority[i] = m_primaryDispatch.getQueueDepth(static_cast<TaskPriority>(i));
+            stats.queueDepth += stats.queueDepthByPriority[i];
+        }
+        stats.runningCount = m_runningJobCount;
+        stats.nestedThreadCount = m_nestedThreadCount;
+        stats.rejectedCount = m_rejectedCount;
+        stats.timedOutCount = m_timedOutCount;
+        stats.callerRunsCount = m_callerRunsCount;
+        stats.droppedTimerCount = m_droppedTimerCount;
+        return stats;
+    }
+
     void ThreadPool::waitForAll()
     {
         std::unique_lock lock(m_waitMtx);
@@ -86,6 +206,12 @@ namespace siren::cloud
 
     ThreadPool::~ThreadPool()
     {
+        if (m_timerWheel)
+        {
+            // pending timers are dropped, those already due have been handed over to the queues
+            // and a coroutine that was waiting on a dropped one is resumed by the workers before they stop
+            m_timerWheel->stop();
+        }
         std::unique_lock lock(m_poolMtx);
         if (m_isGraceful)
         {
@@ -96,6 +222,7 @@ namespace siren::cloud
             }
         }
         m_shutDown = true;
+        m_spaceCv.notify_all();
         m_primaryDispatch.clear();
         for (auto&& thread: m_threads)
         {
@@ -108,6 +235,34 @@ namespace siren::cloud
         Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "ThreadPool has been shut down");
     }
 
+    static OverflowPolicy parseOverflowPolicy(const std::string& str)
+    {
+        if (str == "caller_runs")
+        {
+            return OverflowPolicy::CallerRuns;
+        }
+        if (str == "reject")
+        {
+            return OverflowPolicy::Reject;
+        }
+        if (str != "block")
+        {
+            Logger::log(LogLevel::WARNING, __FILE__, __FUNCTION__, __LINE__, "Unknown overflow policy " + str + ", falling back to block");
+        }
+        return OverflowPolicy::BlockWithTimeout;
+    }
+
+    static void logStats(const ThreadPoolStats& stats)
+    {
+        std::stringstream msg;
+        msg << "ThreadPool queues hold " << stats.queueDepth << " tasks (" << stats.queueDepthByPriority[0] << " interactive, "
+            << stats.queueDepthByPriority[1] << " background, " << stats.queueDepthByPriority[2] << " maintenance), "
+            << stats.runningCount << " running, " << stats.nestedThreadCount << " on helper threads; so far "
+            << stats.rejectedCount << " rejected, " << stats.timedOutCount << " timed out, " << stats.callerRunsCount << " run by the caller, "
+            << stats.droppedTimerCount << " delayed tasks dropped";
+        Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, msg.str());
+    }
+
     ThreadPoolProxy::ThreadPoolProxy()
     {
         size_t coreCount = std::thread::hardware_concurrency();
@@ -118,6 +273,71 @@ namespace siren::cloud
         std::string threadCountStr = siren::getenv("TP_THREADS_PER_QUEUE");
         size_t threadsPerQueue = !threadCountStr.empty() ? std::stoul(threadCountStr) : coreCount;
 
-        m_pool = std::make_shared<ThreadPool>(queueCount, threadsPerQueue, true);
+        SchedulingPolicy policy;
+
+        std::string schedulingStr = siren::getenv("TP_SCHEDULING");
+        if (schedulingStr == "strict")
+        {
+            policy.mode = SchedulingPolicy::Mode::Strict;
+        }
+
+        auto weights = splitList(siren::getenv("TP_PRIORITY_WEIGHTS"));
+        for (size_t i = 0; i < PriorityLevelCount && i < weights.size(); i++)
+        {
+            policy.weights[i] = std::stoul(weights[i]);
+        }
+
+        std::string starvationStr = siren::getenv("TP_STARVATION_MS");
+        if (!starvationStr.empty())
+        {
+            policy.starvationThreshold = std::chrono::milliseconds(std::stoul(starvationStr));
+        }
+
+        std::string timerResolutionStr = siren::getenv("TP_TIMER_RESOLUTION_MS");
+        if (!timerResolutionStr.empty())
+        {
+            policy.timerResolution = std::chrono::milliseconds(std::stoul(timerResolutionStr));
+        }
+
+        BackpressurePolicy backpressure;
+
+        auto capacities = splitList(siren::getenv("TP_QUEUE_CAPACITY"));
+        for (size_t i = 0; i < PriorityLevelCount && i < capacities.size(); i++)
+        {
+            backpressure.capacity[i] = std::stoul(capacities[i]);
+        }
+
+        auto overflowPolicies = splitList(siren::getenv("TP_OVERFLOW_POLICY"));
+        for (size_t i = 0; i < PriorityLevelCount && i < overflowPolicies.size(); i++)
+        {
+            backpressure.overflow[i] = parseOverflowPolicy(overflowPolicies[i]);
+        }
+
+        std::string blockTimeoutStr = siren::getenv("TP_BLOCK_TIMEOUT_MS");
+        if (!blockTimeoutStr.empty())
+        {
+            backpressure.blockTimeout = std::chrono::milliseconds(std::stoul(blockTimeoutStr));
+        }
+
+        std::string nestedThreadsStr = siren::getenv("TP_MAX_NESTED_THREADS");
+        if (!nestedThreadsStr.empty())
+        {
+            backpressure.maxNestedThreads = std::stoul(nestedThreadsStr);
+        }
+
+        m_pool = std::make_shared<ThreadPool>(queueCount, threadsPerQueue, true, policy, backpressure);
+
+        // queue depths and overflow counters are only ever seen in the log
+        std::string statsIntervalStr = siren::getenv("TP_STATS_INTERVAL_MS");
+        std::chrono::milliseconds statsInterval(!statsIntervalStr.empty() ? std::stoul(statsIntervalStr) : 60000);
+        if (statsInterval.count() != 0)
+        {
+            m_statsTimer = m_pool->submitEvery(statsInterval, [pool = m_pool.get()] { logStats(pool->getStats()); }, TaskPriority::Maintenance);
+        }
+    }
+
+    ThreadPoolStats ThreadPoolProxy::getStats() const
+    {
+        return m_pool->getStats();
     }
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
+#include <coroutine>
 #include <thread>
 #include <vector>
 #include <condition_variable>
 #include "../dispatch/dispatch.h"
 #include "../primitives/waitable_future.h"
+#include "../primitives/backpressure.h"
+#include "../timer/timer_wheel.h"
 #include "../../common/common.h"
 
 namespace siren::cloud
@@ -11,7 +14,7 @@ namespace siren::cloud
     class ThreadPool
     {
     public:
-        ThreadPool(size_t numberOfQueues=3, size_t threadsPerQueue=2, bool isGraceful=true);
+        ThreadPool(size_t numberOfQueues=3, size_t threadsPerQueue=2, bool isGraceful=true, const SchedulingPolicy& policy={}, const BackpressurePolicy& backpressure={});
         ~ThreadPool();
 
         ThreadPool() = delete;
@@ -24,27 +27,188 @@ namespace siren::cloud
         void resume();
         size_t getCurrentJobCount() const;
         bool areAllThreadsBusy() const;
+        ThreadPoolStats getStats() const;
 
         template <typename Invocable>
         WaitableFuture submitTask(Invocable&& invocable, bool isWaiting=false)
+        {
+            return submitTask(std::forward<Invocable>(invocable), TaskPriority::Interactive, isWaiting);
+        }
+
+        template <typename Invocable>
+        WaitableFuture submitTask(Invocable&& invocable, TaskPriority priority, bool isWaiting=false)
         {
             if (!m_shutDown && m_isInitialized)
             {
                 size_t thisId = std::hash<std::thread::id>{}(std::this_thread::get_id());
                 if (m_primaryDispatch.isPoolId(thisId))
                 {
-                    return WaitableFuture{std::move(std::async(std::launch::async, invocable)), isWaiting};
+                    return submitNested(std::forward<Invocable>(invocable), isWaiting);
                 }
-                Task task(CallBack(std::move(invocable), thisId));
+                Task task(CallBack(std::forward<Invocable>(invocable), thisId), priority);
                 WaitableFuture future{std::move(task.getFuture()), isWaiting};
-                m_jobCount++;
-                m_primaryDispatch.pushTaskToLeastBusy(std::move(task));
+                if (!enqueue(task))
+                {
+                    return {};
+                }
                 return future;
             }
             return {};
         }
 
+        // always enqueues, even from pool threads, returns false if the task could not be queued and must be run by the caller
+        template <typename Invocable>
+        bool post(Invocable&& invocable, TaskPriority priority=TaskPriority::Interactive)
+        {
+            if (m_shutDown || !m_isInitialized)
+            {
+                return false;
+            }
+            Task task(CallBack(std::forward<Invocable>(invocable), 0), priority);
+            return enqueue(task, false);
+        }
+
+        // co_await schedule() resumes the coroutine on a pool thread, or inline when the queues refuse it
+        auto schedule(TaskPriority priority=TaskPriority::Interactive)
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle)
+                {
+                    return pool->post([handle] { handle.resume(); }, priority);
+                }
+
+                void await_resume() const noexcept
+                {
+                }
+
+                ThreadPool* pool;
+                TaskPriority priority;
+            };
+            return Awaiter{this, priority};
+        }
+
+        // co_await scheduleAfter() resumes the coroutine on a pool thread once the delay has passed
+        auto scheduleAfter(std::chrono::milliseconds delay, TaskPriority priority=TaskPriority::Interactive)
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                bool await_suspend(std::coroutine_handle<> handle)
+                {
+                    if (delay.count() <= 0)
+                    {
+                        return pool->post([handle] { handle.resume(); }, priority);
+                    }
+                    // a delayed task dropped by an overflowing queue never runs, the last copy of it hands the resume on
+                    // instead of running it on whichever thread happens to destroy the timer
+                    struct Resumer
+                    {
+                        ~Resumer()
+                        {
+                            if (handle)
+                            {
+                                pool->resumeDropped(handle, priority);
+                            }
+                        }
+
+                        ThreadPool* pool;
+                        std::coroutine_handle<> handle;
+                        TaskPriority priority;
+                    };
+                    auto resumer = std::make_shared<Resumer>(pool, handle, priority);
+                    pool->submitAfter(delay, [resumer] { std::exchange(resumer->handle, {}).resume(); }, priority);
+                    return true;
+                }
+
+                void await_resume() const noexcept
+                {
+                }
+
+                ThreadPool* pool;
+                std::chrono::milliseconds delay;
+                TaskPriority priority;
+            };
+            return Awaiter{this, delay, priority};
+        }
+
+        // delayed tasks are kept in the timer wheel and enqueued with the given priority once they are due
+        template <typename Invocable>
+        TimerHandle submitAfter(std::chrono::milliseconds delay, Invocable&& invocable, TaskPriority priority=TaskPriority::Interactive)
+        {
+            return submitAt(TimerWheel::Clock::now() + delay, std::forward<Invocable>(invocable), priority);
+        }
+
+        template <typename Invocable>
+        TimerHandle submitAt(TimerWheel::Clock::time_point timePoint, Invocable&& invocable, TaskPriority priority=TaskPriority::Interactive)
+        {
+            if (m_shutDown || !m_isInitialized)
+            {
+                return {};
+            }
+            return getTimerWheel().schedule(CallBack(std::forward<Invocable>(invocable), 0), priority, timePoint);
+        }
+
+        // the first run happens one period from now, the task keeps being rescheduled until its handle is cancelled
+        template <typename Invocable>
+        TimerHandle submitEvery(std::chrono::milliseconds period, Invocable&& invocable, TaskPriority priority=TaskPriority::Interactive)
+        {
+            if (m_shutDown || !m_isInitialized)
+            {
+                return {};
+            }
+            return getTimerWheel().schedule(CallBack(std::forward<Invocable>(invocable), 0), priority, TimerWheel::Clock::now() + period, period);
+        }
+
     private:
+        // pool threads must never wait on their own queues, so their submissions run on helper threads instead
+        template <typename Invocable>
+        WaitableFuture submitNested(Invocable&& invocable, bool isWaiting)
+        {
+            size_t limit = m_backpressure.maxNestedThreads;
+            if (limit != 0 && m_nestedThreadCount.fetch_add(1) >= limit)
+            {
+                m_nestedThreadCount--;
+                m_callerRunsCount++;
+                std::packaged_task<void()> inlineTask(std::forward<Invocable>(invocable));
+                WaitableFuture future{inlineTask.get_future(), isWaiting};
+                inlineTask();
+                return future;
+            }
+            if (limit == 0)
+            {
+                m_nestedThreadCount++;
+            }
+            return WaitableFuture{std::async(std::launch::async, [this, invocable = std::forward<Invocable>(invocable)]() mutable {
+                NestedGuard guard{m_nestedThreadCount};
+                invocable();
+            }), isWaiting};
+        }
+
+        struct NestedGuard
+        {
+            std::atomic<int64_t>& counter;
+            ~NestedGuard()
+            {
+                counter--;
+            }
+        };
+
+        // resumes a coroutine whose delayed task was dropped on a pool thread, past the queue capacity if need be
+        void resumeDropped(std::coroutine_handle<> handle, TaskPriority priority);
+        bool enqueue(Task& task, bool isCallerRunsAllowed=true);
+        // never waits and never runs the task, false once the queues are full
+        bool tryEnqueue(Task& task);
+        TimerWheel& getTimerWheel();
         void waitForAll();
         void process();
 
@@ -63,6 +227,21 @@ namespace siren::cloud
         std::condition_variable m_pauseCv;
         std::atomic<int64_t> m_jobCount{0};
         std::atomic<int64_t> m_runningJobCount{0};
+
+        BackpressurePolicy m_backpressure;
+        std::mutex m_spaceMtx;
+        std::condition_variable m_spaceCv;
+        std::atomic<int64_t> m_blockedProducers{0};
+        std::atomic<int64_t> m_nestedThreadCount{0};
+        std::atomic<size_t> m_rejectedCount{0};
+        std::atomic<size_t> m_timedOutCount{0};
+        std::atomic<size_t> m_callerRunsCount{0};
+        std::atomic<size_t> m_droppedTimerCount{0};
+
+        // created on first use so that pools without delayed tasks don't pay for the timer thread
+        std::chrono::milliseconds m_timerResolution;
+        std::once_flag m_timerFlag;
+        TimerWheelPtr m_timerWheel;
     };
 
     using ThreadPoolPtr = std::shared_ptr<ThreadPool>;
@@ -79,7 +258,55 @@ namespace siren::cloud
             return m_pool->submitTask(std::forward<Invocable>(task), isWaiting);
         }
 
+        template<typename Invocable>
+        WaitableFuture submitTask(Invocable&& task, TaskPriority priority, bool isWaiting=false)
+        {
+            static_assert(std::is_invocable_v<Invocable>, "submitTask accept only invocable objects");
+            return m_pool->submitTask(std::forward<Invocable>(task), priority, isWaiting);
+        }
+
+        template<typename Invocable>
+        TimerHandle submitAfter(std::chrono::milliseconds delay, Invocable&& task, TaskPriority priority=TaskPriority::Interactive)
+        {
+            static_assert(std::is_invocable_v<Invocable>, "submitAfter accept only invocable objects");
+            return m_pool->submitAfter(delay, std::forward<Invocable>(task), priority);
+        }
+
+        template<typename Invocable>
+        TimerHandle submitAt(std::chrono::steady_clock::time_point timePoint, Invocable&& task, TaskPriority priority=TaskPriority::Interactive)
+        {
+            static_assert(std::is_invocable_v<Invocable>, "submitAt accept only invocable objects");
+            return m_pool->submitAt(timePoint, std::forward<Invocable>(task), priority);
+        }
+
+        template<typename Invocable>
+        TimerHandle submitEvery(std::chrono::milliseconds period, Invocable&& task, TaskPriority priority=TaskPriority::Interactive)
+        {
+            static_assert(std::is_invocable_v<Invocable>, "submitEvery accept only invocable objects");
+            return m_pool->submitEvery(period, std::forward<Invocable>(task), priority);
+        }
+
+        template<typename Invocable>
+        bool post(Invocable&& task, TaskPriority priority=TaskPriority::Interactive)
+        {
+            static_assert(std::is_invocable_v<Invocable>, "post accept only invocable objects");
+            return m_pool->post(std::forward<Invocable>(task), priority);
+        }
+
+        auto schedule(TaskPriority priority=TaskPriority::Interactive)
+        {
+            return m_pool->schedule(priority);
+        }
+
+        auto scheduleAfter(std::chrono::milliseconds delay, TaskPriority priority=TaskPriority::Interactive)
+        {
+            return m_pool->scheduleAfter(delay, priority);
+        }
+
+        ThreadPoolStats getStats() const;
+
     private:
         ThreadPoolPtr m_pool;
+        TimerHandle m_statsTimer;
     };
 }
@@ -0,0 +1,36 @@
+#pragma once
+#include "priority.h"
+
+namespace siren::cloud
+{
+    enum class OverflowPolicy
+    {
+        CallerRuns,
+        BlockWithTimeout,
+        Reject
+    };
+
+    struct BackpressurePolicy
+    {
+        // maximum number of queued tasks of each level per worker queue, 0 means unbounded
+        std::array<size_t, PriorityLevelCount> capacity{0, 0, 0};
+        std::array<OverflowPolicy, PriorityLevelCount> overflow{OverflowPolicy::BlockWithTimeout, OverflowPolicy::CallerRuns, OverflowPolicy::CallerRuns};
+        std::chrono::milliseconds blockTimeout{100};
+
+        // upper bound on helper threads spawned for submissions made from pool threads, 0 means unbounded
+        size_t maxNestedThreads{0};
+    };
+
+    struct ThreadPoolStats
+    {
+        size_t queueDepth{0};
+        std::array<size_t, PriorityLevelCount> queueDepthByPriority{0, 0, 0};
+        size_t runningCount{0};
+        size_t nestedThreadCount{0};
+        size_t rejectedCount{0};
+        size_t timedOutCount{0};
+        size_t callerRunsCount{0};
+        // due delayed tasks that found their queue full
+        size_t droppedTimerCount{0};
+    };
+}
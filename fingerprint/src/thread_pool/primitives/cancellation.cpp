@@ -0,0 +1,90 @@
+#include "cancellation.h"
+#include <algorithm>
+
+namespace siren::cloud
+{
+    CancellationToken CancellationToken::create()
+    {
+        CancellationToken token;
+        token.m_state = std::make_shared<State>();
+        return token;
+    }
+
+    CancellationToken CancellationToken::create(Clock::time_point deadline)
+    {
+        CancellationToken token = create();
+        token.setDeadline(deadline);
+        return token;
+    }
+
+    CancellationToken CancellationToken::createChild() const
+    {
+        CancellationToken child = create();
+        child.m_state->parent = m_state;
+        if (hasDeadline())
+        {
+            child.m_state->deadline.store(m_state->deadline.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        return child;
+    }
+
+    bool CancellationToken::State::isCancelledOrExpired() const
+    {
+        if (isCancelled.load(std::memory_order_acquire))
+        {
+            return true;
+        }
+        if (deadline.load(std::memory_order_relaxed) <= Clock::now().time_since_epoch().count())
+        {
+            return true;
+        }
+        return parent && parent->isCancelledOrExpired();
+    }
+
+    bool CancellationToken::isCancellable() const
+    {
+        return m_state != nullptr;
+    }
+
+    void CancellationToken::cancel() const
+    {
+        if (m_state)
+        {
+            m_state->isCancelled.store(true, std::memory_order_release);
+        }
+    }
+
+    bool CancellationToken::isCancelled() const
+    {
+        return m_state && m_state->isCancelledOrExpired();
+    }
+
+    void CancellationToken::setDeadline(Clock::time_point deadline) const
+    {
+        if (!m_state)
+        {
+            return;
+        }
+        Clock::rep value = deadline.time_since_epoch().count();
+        Clock::rep current = m_state->deadline.load(std::memory_order_relaxed);
+        while (value < current && !m_state->deadline.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    bool CancellationToken::hasDeadline() const
+    {
+        return m_state && m_state->deadline.load(std::memory_order_relaxed) != Clock::time_point::max().time_since_epoch().count();
+    }
+
+    std::chrono::milliseconds CancellationToken::getRemaining(std::chrono::milliseconds fallback) const
+    {
+        if (!hasDeadline())
+        {
+            return fallback;
+        }
+        Clock::time_point deadline{Clock::duration{m_state->deadline.load(std::memory_order_relaxed)}};
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        return std::max(remaining, std::chrono::milliseconds{0});
+    }
+}
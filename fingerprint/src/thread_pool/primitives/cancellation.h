@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace siren::cloud
+{
+    /*
+     * Shared cancellation flag with an optional deadline, copies observe the same state.
+     * A default constructed token can never be cancelled, so passing one opts out of cancellation.
+     */
+    class CancellationToken
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        CancellationToken() = default;
+
+        static CancellationToken create();
+        static CancellationToken create(Clock::time_point deadline);
+
+        // a child is cancelled along with this token and starts with its deadline, cancelling the child leaves this token alone
+        CancellationToken createChild() const;
+
+        bool isCancellable() const;
+        void cancel() const;
+
+        // true once cancel() was called or the deadline has passed
+        bool isCancelled() const;
+
+        // a deadline can only be tightened, later calls with a looser one are ignored
+        void setDeadline(Clock::time_point deadline) const;
+        bool hasDeadline() const;
+
+        // time left before the deadline, fallback when there is none
+        std::chrono::milliseconds getRemaining(std::chrono::milliseconds fallback) const;
+
+    private:
+        struct State
+        {
+            std::atomic<bool> isCancelled{false};
+            std::atomic<Clock::rep> deadline{Clock::time_point::max().time_since_epoch().count()};
+            std::shared_ptr<const State> parent;
+
+            bool isCancelledOrExpired() const;
+        };
+
+        std::shared_ptr<State> m_state;
+    };
+}
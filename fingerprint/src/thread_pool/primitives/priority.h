@@ -0,0 +1,41 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+namespace siren::cloud
+{
+    enum class TaskPriority
+    {
+        Interactive = 0,
+        Background = 1,
+        Maintenance = 2
+    };
+
+    inline constexpr size_t PriorityLevelCount = 3;
+
+    struct SchedulingPolicy
+    {
+        enum class Mode
+        {
+            Strict,
+            WeightedFair
+        };
+
+        Mode mode{Mode::WeightedFair};
+
+        // number of tasks of each level served per round in WeightedFair mode
+        std::array<size_t, PriorityLevelCount> weights{8, 2, 1};
+
+        // a task waiting longer than this is served next regardless of its level, 0 disables aging
+        std::chrono::milliseconds starvationThreshold{500};
+
+        // tick length of the timer wheel serving delayed and periodic tasks
+        std::chrono::milliseconds timerResolution{10};
+    };
+
+    inline constexpr size_t toLevel(TaskPriority priority)
+    {
+        return static_cast<size_t>(priority);
+    }
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include "backpressure.h"
+
+namespace siren::cloud
+{
+    /*
+     * Drop-in replacement for SafeQueue that keeps one FIFO per TaskPriority.
+     * T is expected to expose getPriority() and getCreationTime().
+     */
+    template <typename T>
+    class SafePriorityQueue
+    {
+        using Clock = std::chrono::steady_clock;
+
+    public:
+        explicit SafePriorityQueue(size_t id, const SchedulingPolicy& policy = {}, const std::array<size_t, PriorityLevelCount>& capacity = {})
+            : m_id(id)
+            , m_size(0)
+            , m_abort(false)
+            , m_policy(policy)
+            , m_capacity(capacity)
+            , m_credits(policy.weights)
+        {
+        }
+
+        void push(T&& task)
+        {
+            std::unique_lock lock(m_mtx);
+            m_levels[toLevel(task.getPriority())].emplace(std::move(task));
+            m_size++;
+            m_cv.notify_one();
+        }
+
+        // respects the capacity of the task's level, task is left untouched on failure
+        bool tryPush(T& task)
+        {
+            std::unique_lock lock(m_mtx);
+            size_t level = toLevel(task.getPriority());
+            if (m_abort || (m_capacity[level] != 0 && m_levels[level].size() >= m_capacity[level]))
+            {
+                return false;
+            }
+            m_levels[level].emplace(std::move(task));
+            m_size++;
+            m_cv.notify_one();
+            return true;
+        }
+
+        bool isFull(TaskPriority priority) const
+        {
+            std::unique_lock lock(m_mtx);
+            size_t level = toLevel(priority);
+            return m_capacity[level] != 0 && m_levels[level].size() >= m_capacity[level];
+        }
+
+        bool pop(T& value)
+        {
+            {
+                std::unique_lock lock(m_mtx);
+                m_cv.wait(lock, [&] { return m_size != 0 || m_abort; });
+
+                if (m_abort)
+                {
+                    return false;
+                }
+
+                auto& level = m_levels[selectLevel()];
+                value = std::move(level.front());
+                level.pop();
+                m_size--;
+            }
+            return true;
+        }
+
+        void signalAbort()
+        {
+            m_abort = true;
+            m_cv.notify_all();
+        }
+
+        size_t getId() const
+        {
+            return m_id;
+        }
+
+        size_t getCurrentSize() const
+        {
+            return m_size;
+        }
+
+        size_t getCurrentSize(TaskPriority priority) const
+        {
+            std::unique_lock lock(m_mtx);
+            return m_levels[toLevel(priority)].size();
+        }
+
+        bool isEmpty() const
+        {
+            return m_size == 0;
+        }
+
+    private:
+        // must be called with m_mtx held and at least one task enqueued
+        size_t selectLevel()
+        {
+            if (m_policy.starvationThreshold.count() > 0)
+            {
+                auto now = Clock::now();
+                size_t starving = PriorityLevelCount;
+                Clock::duration longestWait{0};
+                for (size_t i = 1; i < PriorityLevelCount; i++)
+                {
+                    if (m_levels[i].empty())
+                    {
+                        continue;
+                    }
+                    auto wait = now - m_levels[i].front().getCreationTime();
+                    if (wait >= m_policy.starvationThreshold && wait > longestWait)
+                    {
+                        starving = i;
+                        longestWait = wait;
+                    }
+                }
+                if (starving != PriorityLevelCount)
+                {
+                    return starving;
+                }
+            }
+
+            if (m_policy.mode == SchedulingPolicy::Mode::Strict)
+            {
+                return firstNonEmpty(false);
+            }
+
+            size_t level = firstNonEmpty(true);
+            if (level == PriorityLevelCount)
+            {
+                m_credits = m_policy.weights;
+                level = firstNonEmpty(true);
+            }
+            if (level == PriorityLevelCount)
+            {
+                // every non-empty level has a zero weight, fall back to strict order
+                return firstNonEmpty(false);
+            }
+            m_credits[level]--;
+            return level;
+        }
+
+        size_t firstNonEmpty(bool requireCredit) const
+        {
+            for (size_t i = 0; i < PriorityLevelCount; i++)
+            {
+                if (!m_levels[i].empty() && (!requireCredit || m_credits[i] > 0))
+                {
+                    return i;
+                }
+            }
+            return PriorityLevelCount;
+        }
+
+    private:
+        size_t m_id;
+        std::atomic<size_t> m_size;
+        std::atomic<bool> m_abort;
+        SchedulingPolicy m_policy;
+        std::array<size_t, PriorityLevelCount> m_capacity;
+        std::array<size_t, PriorityLevelCount> m_credits;
+        std::array<std::queue<T>, PriorityLevelCount> m_levels;
+        std::condition_variable m_cv;
+        mutable std::mutex m_mtx;
+    };
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include <chrono>
 #include <future>
+#include "priority.h"
 #include "../callback/callback.h"
 
 namespace siren::cloud
@@ -8,8 +10,12 @@ namespace siren::cloud
     class PackagedTask
     {
     public:
+        using TimePoint = std::chrono::steady_clock::time_point;
+
         PackagedTask() = default;
-        PackagedTask(CallBack&& callback)
+        PackagedTask(CallBack&& callback, TaskPriority priority = TaskPriority::Interactive)
+            : m_priority(priority)
+            , m_creationTime(std::chrono::steady_clock::now())
         {
             m_id = callback.getSenderId();
             std::packaged_task<T()> task(std::move(callback));
@@ -31,6 +37,16 @@ namespace siren::cloud
             return m_id;
         }
 
+        TaskPriority getPriority() const
+        {
+            return m_priority;
+        }
+
+        TimePoint getCreationTime() const
+        {
+            return m_creationTime;
+        }
+
         bool valid() const
         {
             return m_task.valid();
@@ -38,6 +54,8 @@ namespace siren::cloud
 
     private:
         size_t m_id{0};
+        TaskPriority m_priority{TaskPriority::Interactive};
+        TimePoint m_creationTime{};
         std::packaged_task<T()> m_task;
     };
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "timer_wheel.h"
+#include "../../logger/logger.h"
+#include <iterator>
+
+namespace siren::cloud
+{
+    TimerHandle::TimerHandle(std::shared_ptr<std::atomic<bool>> cancelled)
+        : m_cancelled(std::move(cancelled))
+    {
+    }
+
+    void TimerHandle::cancel()
+    {
+        if (m_cancelled)
+        {
+            *m_cancelled = true;
+        }
+    }
+
+    bool TimerHandle::isCancelled() const
+    {
+        return m_cancelled && *m_cancelled;
+    }
+
+    bool TimerHandle::valid() const
+    {
+        return m_cancelled != nullptr;
+    }
+
+    TimerWheel::TimerWheel(Dispatcher dispatcher, std::chrono::milliseconds resolution)
+        : m_dispatcher(std::move(dispatcher))
+        , m_resolution(resolution.count() > 0 ? resolution : std::chrono::milliseconds(1))
+        , m_start(Clock::now())
+    {
+        m_thread = std::thread([this] { run(); });
+    }
+
+    TimerWheel::~TimerWheel()
+    {
+        stop();
+    }
+
+    void TimerWheel::stop()
+    {
+        {
+            std::unique_lock lock(m_mtx);
+            if (m_isStopping)
+            {
+                return;
+            }
+            m_isStopping = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        if (m_pendingCount != 0)
+        {
+            Logger::log(LogLevel::INFO, __FILE__, __FUNCTION__, __LINE__, "TimerWheel stopped with " + std::to_string(m_pendingCount) + " pending timers");
+        }
+
+        // pending callbacks are destroyed now rather than with the wheel, while whatever they own can still be handed to the pool
+        std::vector<TimerPtr> pending;
+        {
+            std::unique_lock lock(m_mtx);
+            for (auto& level: m_levels)
+            {
+                for (auto& slot: level)
+                {
+                    std::move(slot.begin(), slot.end(), std::back_inserter(pending));
+                    slot.clear();
+                }
+            }
+            m_pendingCount = 0;
+        }
+    }
+
+    TimerHandle TimerWheel::schedule(CallBack&& callback, TaskPriority priority, Clock::time_point expiry, std::chrono::milliseconds period)
+    {
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+        uint64_t periodTicks = 0;
+        if (period.count() > 0)
+        {
+            periodTicks = std::max<uint64_t>(1, (period + m_resolution - std::chrono::milliseconds(1)) / m_resolution);
+        }
+        auto timer = std::make_unique<Timer>(Timer{toTick(expiry, true), periodTicks, priority, std::move(callback), cancelled});
+        {
+            std::unique_lock lock(m_mtx);
+            if (m_isStopping)
+            {
+                return {};
+            }
+            if (m_pendingCount == 0)
+            {
+                // the wheel does not tick while idle, catch up before inserting relative to the current tick
+                m_currentTick = std::max(m_currentTick, toTick(Clock::now(), false));
+            }
+            insert(std::move(timer));
+            m_pendingCount++;
+        }
+        m_cv.notify_one();
+        return TimerHandle{std::move(cancelled)};
+    }
+
+    size_t TimerWheel::getPendingCount() const
+    {
+        return m_pendingCount;
+    }
+
+    // must be called with m_mtx held
+    void TimerWheel::insert(TimerPtr&& timer)
+    {
+        if (timer->expiryTick <= m_currentTick)
+        {
+            timer->expiryTick = m_currentTick + 1;
+        }
+        uint64_t delta = timer->expiryTick - m_currentTick;
+        size_t level = 0;
+        while (level < LevelCount - 1 && delta >= (uint64_t(1) << (LevelBits * (level + 1))))
+        {
+            level++;
+        }
+        uint64_t tick = timer->expiryTick;
+        uint64_t range = uint64_t(1) << (LevelBits * LevelCount);
+        if (delta >= range)
+        {
+            // beyond the horizon of the top level, park it at the farthest slot and let cascading re-place it
+            tick = m_currentTick + range - 1;
+        }
+        size_t slot = (tick >> (LevelBits * level)) & (SlotCount - 1);
+        m_levels[level][slot].emplace_back(std::move(timer));
+    }
+
+    // must be called with m_mtx held, re-inserts the current slot of the level into the levels below it
+    void TimerWheel::cascade(size_t level)
+    {
+        size_t slot = (m_currentTick >> (LevelBits * level)) & (SlotCount - 1);
+        Slot timers = std::move(m_levels[level][slot]);
+        m_levels[level][slot].clear();
+        for (auto& timer: timers)
+        {
+            insert(std::move(timer));
+        }
+    }
+
+    // must be called with m_mtx held
+    void TimerWheel::advanceTo(uint64_t tick, std::vector<TimerPtr>& expired)
+    {
+        while (m_currentTick < tick && m_pendingCount != 0)
+        {
+            m_currentTick++;
+            for (size_t level = 1; level < LevelCount; level++)
+            {
+                if (((m_currentTick >> (LevelBits * (level - 1))) & (SlotCount - 1)) != 0)
+                {
+                    break;
+                }
+                cascade(level);
+            }
+            auto& slot = m_levels[0][m_currentTick & (SlotCount - 1)];
+            for (auto& timer: slot)
+            {
+                expired.emplace_back(std::move(timer));
+            }
+            slot.clear();
+        }
+        if (m_pendingCount == 0 && m_currentTick < tick)
+        {
+            m_currentTick = tick;
+        }
+    }
+
+    void TimerWheel::run()
+    {
+        std::vector<TimerPtr> expired;
+        while (true)
+        {
+            {
+                std::unique_lock lock(m_mtx);
+                if (m_pendingCount == 0)
+                {
+                    m_cv.wait(lock, [&] { return m_isStopping || m_pendingCount != 0; });
+                }
+                else
+                {
+                    m_cv.wait_until(lock, toTimePoint(m_currentTick + 1), [&] { return m_isStopping; });
+                }
+                if (m_isStopping)
+                {
+                    return;
+                }
+                advanceTo(toTick(Clock::now(), false), expired);
+            }
+
+            for (auto& timer: expired)
+            {
+                if (*timer->cancelled)
+                {
+                    m_pendingCount--;
+                    continue;
+                }
+                // the callback is guarded as well, so cancel() also covers tasks that are still sitting in the pool queues
+                auto task = [cancelled = timer->cancelled, callback = timer->callback] {
+                    if (!*cancelled)
+                    {
+                        callback();
+                    }
+                };
+                m_dispatcher(CallBack(std::move(task), 0), timer->priority);
+
+                if (timer->periodTicks == 0)
+                {
+                    m_pendingCount--;
+                    continue;
+                }
+                std::unique_lock lock(m_mtx);
+                timer->expiryTick += timer->periodTicks;
+                insert(std::move(timer));
+            }
+            expired.clear();
+        }
+    }
+
+    // expiries are rounded up so that timers never fire early, the current tick is rounded down
+    uint64_t TimerWheel::toTick(Clock::time_point timePoint, bool roundUp) const
+    {
+        if (timePoint <= m_start)
+        {
+            return 0;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint - m_start).count();
+        auto resolution = std::chrono::duration_cast<std::chrono::nanoseconds>(m_resolution).count();
+        return (elapsed + (roundUp ? resolution - 1 : 0)) / resolution;
+    }
+
+    TimerWheel::Clock::time_point TimerWheel::toTimePoint(uint64_t tick) const
+    {
+        return m_start + m_resolution * tick;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../callback/callback.h"
+#include "../primitives/priority.h"
+
+namespace siren::cloud
+{
+    class TimerHandle
+    {
+    public:
+        TimerHandle() = default;
+        explicit TimerHandle(std::shared_ptr<std::atomic<bool>> cancelled);
+
+        void cancel();
+        bool isCancelled() const;
+        bool valid() const;
+
+    private:
+        std::shared_ptr<std::atomic<bool>> m_cancelled;
+    };
+
+    /*
+     * Hierarchical timing wheel with LevelCount levels of SlotCount slots each.
+     * Insertion and cancellation are O(1), a single thread advances the wheel and
+     * hands expired callbacks over to the dispatcher.
+     */
+    class TimerWheel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Dispatcher = std::function<void(CallBack&&, TaskPriority)>;
+
+        explicit TimerWheel(Dispatcher dispatcher, std::chrono::milliseconds resolution = std::chrono::milliseconds(10));
+        ~TimerWheel();
+
+        TimerWheel(const TimerWheel& other) = delete;
+        TimerWheel(TimerWheel&& other) = delete;
+        TimerWheel& operator=(const TimerWheel& other) = delete;
+        TimerWheel& operator=(TimerWheel&& other) = delete;
+
+        TimerHandle schedule(CallBack&& callback, TaskPriority priority, Clock::time_point expiry, std::chrono::milliseconds period = std::chrono::milliseconds(0));
+        size_t getPendingCount() const;
+        void stop();
+
+    private:
+        struct Timer
+        {
+            uint64_t expiryTick;
+            uint64_t periodTicks;
+            TaskPriority priority;
+            CallBack callback;
+            std::shared_ptr<std::atomic<bool>> cancelled;
+        };
+
+        using TimerPtr = std::unique_ptr<Timer>;
+        using Slot = std::vector<TimerPtr>;
+
+        static constexpr size_t LevelBits = 8;
+        static constexpr size_t SlotCount = 1 << LevelBits;
+        static constexpr size_t LevelCount = 4;
+
+        void run();
+        void insert(TimerPtr&& timer);
+        void cascade(size_t level);
+        void advanceTo(uint64_t tick, std::vector<TimerPtr>& expired);
+        uint64_t toTick(Clock::time_point timePoint, bool roundUp) const;
+        Clock::time_point toTimePoint(uint64_t tick) const;
+
+    private:
+        Dispatcher m_dispatcher;
+        std::chrono::milliseconds m_resolution;
+        Clock::time_point m_start;
+        uint64_t m_currentTick{0};
+        std::array<std::array<Slot, SlotCount>, LevelCount> m_levels;
+        std::atomic<size_t> m_pendingCount{0};
+        bool m_isStopping{false};
+        mutable std::mutex m_mtx;
+        std::condition_variable m_cv;
+        std::thread m_thread;
+    };
+
+    using TimerWheelPtr = std::unique_ptr<TimerWheel>;
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "../src/admission/admission_controller.h"
+
+using siren::cloud::AdmissionController;
+using siren::cloud::AdmissionPolicy;
+using siren::cloud::CancellationToken;
+using siren::cloud::TaskPriority;
+
+static AdmissionPolicy makePolicy(size_t limit, std::chrono::milliseconds budget)
+{
+    AdmissionPolicy policy;
+    policy.initialLimit = limit;
+    policy.minLimit = 2;
+    policy.maxLimit = 64;
+    policy.queueBudget = {budget, budget, budget};
+    return policy;
+}
+
+TEST(Admission, TestLimit)
+{
+    AdmissionController controller(makePolicy(4, std::chrono::milliseconds(0)));
+    for (size_t i = 0; i < 4; i++)
+    {
+        EXPECT_TRUE(controller.tryAcquire(TaskPriority::Interactive));
+    }
+    EXPECT_FALSE(controller.tryAcquire(TaskPriority::Interactive));
+    EXPECT_EQ(controller.getRejectedCount(), 1);
+
+    controller.release(TaskPriority::Background, std::chrono::milliseconds(1));
+    EXPECT_TRUE(controller.tryAcquire(TaskPriority::Background));
+    EXPECT_EQ(controller.getInFlightCount(), 4);
+}
+
+TEST(Admission, TestQueueBudget)
+{
+    AdmissionController controller(makePolicy(2, std::chrono::milliseconds(200)));
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_TRUE(controller.tryAcquire(TaskPriority::Interactive, {}, now - std::chrono::milliseconds(100)));
+
+    // a call that has been queued past its budget is refused even with slots to spare
+    EXPECT_FALSE(controller.tryAcquire(TaskPriority::Interactive, {}, now - std::chrono::milliseconds(300)));
+    EXPECT_EQ(controller.getInFlightCount(), 1);
+
+    // a full limit refuses right away instead of waiting out the budget
+    EXPECT_TRUE(controller.tryAcquire(TaskPriority::Interactive, {}, now));
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(controller.tryAcquire(TaskPriority::Interactive, {}, now));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+
+    // neither is a call whose client has gone away admitted
+    controller.release(TaskPriority::Background, std::chrono::milliseconds(1));
+    auto token = CancellationToken::create();
+    token.cancel();
+    EXPECT_FALSE(controller.tryAcquire(TaskPriority::Interactive, token, now));
+    EXPECT_EQ(controller.getRejectedCount(), 3);
+}
+
+TEST(Admission, TestAdaptiveLimit)
+{
+    AdmissionController controller(makePolicy(8, std::chrono::milliseconds(0)));
+    auto saturate = [&controller](std::chrono::milliseconds latency, size_t rounds) {
+        for (size_t i = 0; i < rounds; i++)
+        {
+            while (controller.tryAcquire(TaskPriority::Interactive))
+            {
+            }
+            controller.release(TaskPriority::Interactive, latency);
+        }
+    };
+
+    // steady latency under full load lets the limit grow
+    saturate(std::chrono::milliseconds(5), 200);
+    size_t grownLimit = controller.getLimit();
+    EXPECT_GT(grownLimit, 8);
+
+    // latency building up is taken as queueing downstream and the limit backs off
+    saturate(std::chrono::milliseconds(100), 100);
+    EXPECT_LT(controller.getLimit(), grownLimit / 2);
+    EXPECT_GE(controller.getLimit(), 2);
+
+    // background latency does not move the limit
+    size_t limit = controller.getLimit();
+    for (size_t i = 0; i < 50; i++)
+    {
+        controller.release(TaskPriority::Background, std::chrono::seconds(10));
+        EXPECT_TRUE(controller.tryAcquire(TaskPriority::Background));
+    }
+    EXPECT_EQ(controller.getLimit(), limit);
+}
+
+TEST(Admission, TestFallbackShedding)
+{
+    AdmissionPolicy policy = makePolicy(8, std::chrono::milliseconds(0));
+    policy.fallbackShare = 0.5;
+    AdmissionController controller(policy);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        EXPECT_TRUE(controller.tryAcquire(TaskPriority::Interactive));
+    }
+    EXPECT_FALSE(controller.isSheddingFallbacks());
+    EXPECT_TRUE(controller.tryAcquire(TaskPriority::Interactive));
+    EXPECT_TRUE(controller.isSheddingFallbacks());
+    controller.release(TaskPriority::Background, std::chrono::milliseconds(1));
+    EXPECT_FALSE(controller.isSheddingFallbacks());
+}
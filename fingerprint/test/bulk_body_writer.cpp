@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+#include "../src/storage/elastic/bulk_body_writer.h"
+
+using siren::cloud::Json;
+using siren::cloud::elastic::BulkBodyWriter;
+
+TEST(BulkBodyWriter, TestRows)
+{
+    BulkBodyWriter writer(1024);
+    writer.reserve(2);
+    writer.index(18446744073709551615ull, -1, 7);
+    writer.index(42, 2147483647, 18446744073709551615ull);
+    EXPECT_EQ(writer.getRowCount(), 2);
+
+    std::vector<std::string> bodies = writer.takeBodies();
+    ASSERT_EQ(bodies.size(), 1);
+    EXPECT_EQ(bodies[0],
+              "{\"index\":{\"_id\":\"7:18446744073709551615\",\"routing\":\"7\"}}\n"
+              "{\"hash\":18446744073709551615,\"song_id\":7,\"timestamp\":-1}\n"
+              "{\"index\":{\"_id\":\"18446744073709551615:42\",\"routing\":\"18446744073709551615\"}}\n"
+              "{\"hash\":42,\"song_id\":18446744073709551615,\"timestamp\":2147483647}\n");
+
+    // every line parses on its own
+    std::istringstream stream(bodies[0]);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        EXPECT_NO_THROW(Json::parse(line));
+    }
+
+    EXPECT_TRUE(writer.empty());
+    EXPECT_TRUE(writer.takeBodies().empty());
+}
+
+TEST(BulkBodyWriter, TestSplit)
+{
+    BulkBodyWriter writer(1024);
+    writer.reserve(1000);
+    for (size_t i = 0; i < 1000; i++)
+    {
+        writer.index(i, static_cast<siren::cloud::TimestampType>(i), 1);
+    }
+
+    // bodies end at a row boundary below the limit and hold every row once
+    std::vector<std::string> bodies = writer.takeBodies();
+    EXPECT_GT(bodies.size(), 1);
+    size_t lineCount = 0;
+    for (const auto& body: bodies)
+    {
+        EXPECT_LE(body.size(), 1024);
+        EXPECT_EQ(body.back(), '\n');
+        lineCount += std::count(body.begin(), body.end(), '\n');
+    }
+    EXPECT_EQ(lineCount, 2000);
+
+    // the writer starts over once taken
+    writer.index(1, 1, 1);
+    QueryCollection queries = writer.takeQueries("fingerprint/_bulk");
+    ASSERT_EQ(queries.size(), 1);
+    EXPECT_EQ(queries[0].get("lucene"), "fingerprint/_bulk");
+    EXPECT_EQ(queries[0].get("request_type"), "POST");
+    EXPECT_EQ(queries[0].get("header"), "");
+    EXPECT_EQ(queries[0].get("query"), "{\"index\":{\"_id\":\"1:1\",\"routing\":\"1\"}}\n{\"hash\":1,\"song_id\":1,\"timestamp\":1}\n");
+}
+
+TEST(BulkBodyWriter, TestIds)
+{
+    BulkBodyWriter writer(1024);
+
+    // a row written twice lands on the same document, and is deleted by the same id
+    writer.index(5, 10, 3);
+    writer.index(5, 10, 3);
+    writer.remove(5, 3);
+    std::vector<std::string> bodies = writer.takeBodies();
+    ASSERT_EQ(bodies.size(), 1);
+
+    std::istringstream stream(bodies[0]);
+    std::vector<Json> lines;
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        lines.push_back(Json::parse(line));
+    }
+    ASSERT_EQ(lines.size(), 5);
+    EXPECT_EQ(lines[0], lines[2]);
+    EXPECT_EQ(lines[0]["index"]["_id"], "3:5");
+    EXPECT_EQ(lines[4]["delete"]["_id"], "3:5");
+    EXPECT_EQ(lines[4]["delete"]["routing"], "3");
+}
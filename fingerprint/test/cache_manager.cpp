@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "../src/engine/cache_manager.h"
+
+using siren::cloud::CacheManager;
+using siren::cloud::CachePolicy;
+using siren::cloud::FrequencySketch;
+using siren::cloud::SongIdType;
+
+static CachePolicy makePolicy(size_t rowBudget)
+{
+    CachePolicy policy;
+    policy.rowBudget = rowBudget;
+    policy.sketchWidth = 1024;
+    policy.sampleSize = 0;
+    return policy;
+}
+
+TEST(CacheManager, TestSketch)
+{
+    FrequencySketch sketch(1024, 100);
+    for (size_t i = 0; i < 5; i++)
+    {
+        sketch.increment(1);
+    }
+    sketch.increment(2);
+    EXPECT_EQ(sketch.estimate(1), 5);
+    EXPECT_EQ(sketch.estimate(2), 1);
+    EXPECT_EQ(sketch.estimate(3), 0);
+
+    for (size_t i = 0; i < 40; i++)
+    {
+        sketch.increment(4);
+    }
+    EXPECT_EQ(sketch.estimate(4), FrequencySketch::MaxCount);
+
+    // once a sample is over every count is halved
+    for (uint64_t key = 100; key < 200; key++)
+    {
+        sketch.increment(key);
+    }
+    EXPECT_LE(sketch.estimate(1), 3);
+    EXPECT_LE(sketch.estimate(4), FrequencySketch::MaxCount / 2 + 1);
+}
+
+TEST(CacheManager, TestAdmission)
+{
+    CacheManager manager(makePolicy(300));
+    EXPECT_TRUE(manager.admit(1, 100));
+    EXPECT_TRUE(manager.admit(2, 100));
+    EXPECT_TRUE(manager.admit(3, 100));
+    EXPECT_EQ(manager.getUsedRows(), 300);
+    EXPECT_TRUE(manager.takeEvictions().empty());
+
+    // a song nobody has asked for does not push out one that is just as cold
+    EXPECT_FALSE(manager.admit(4, 100));
+    EXPECT_FALSE(manager.admit(5, 1000));
+
+    // the least recently used song goes, as long as it is asked for less often than the newcomer
+    manager.recordAccess(1);
+    manager.recordAccess(2);
+    manager.recordAccess(4);
+    manager.recordAccess(4);
+    EXPECT_TRUE(manager.admit(4, 100));
+    EXPECT_TRUE(manager.takeEvictions().empty());
+    manager.commit(4);
+    EXPECT_EQ(manager.takeEvictions(), std::vector<SongIdType>{3});
+    EXPECT_FALSE(manager.isResident(3));
+    EXPECT_TRUE(manager.isResident(4));
+    EXPECT_EQ(manager.getUsedRows(), 300);
+
+    // the coldest song is accessed as often as the newcomer, so nothing changes
+    manager.recordAccess(1);
+    manager.recordAccess(5);
+    EXPECT_FALSE(manager.admit(5, 100));
+    EXPECT_TRUE(manager.takeEvictions().empty());
+}
+
+TEST(CacheManager, TestRevoke)
+{
+    CacheManager manager(makePolicy(200));
+    EXPECT_TRUE(manager.admit(1, 100));
+    EXPECT_TRUE(manager.admit(2, 100));
+    manager.recordAccess(3);
+    manager.recordAccess(3);
+
+    // a newcomer that could not be written gives the songs it displaced their place back, cold as they were
+    EXPECT_TRUE(manager.admit(3, 150));
+    EXPECT_FALSE(manager.isResident(1));
+    manager.revoke(3);
+    EXPECT_TRUE(manager.isResident(1));
+    EXPECT_TRUE(manager.isResident(2));
+    EXPECT_FALSE(manager.isResident(3));
+    EXPECT_EQ(manager.getUsedRows(), 200);
+    EXPECT_EQ(manager.takeEvictions(), std::vector<SongIdType>{3});
+
+    // evictions taken while another admission is being written leave what it displaced alone
+    manager.recordAccess(4);
+    manager.recordAccess(4);
+    EXPECT_TRUE(manager.admit(3, 100));
+    EXPECT_TRUE(manager.admit(4, 100));
+    EXPECT_EQ(manager.getResidentCount(), 2);
+    manager.commit(3);
+    EXPECT_EQ(manager.takeEvictions(), std::vector<SongIdType>{1});
+    manager.revoke(4);
+    EXPECT_TRUE(manager.isResident(2));
+    EXPECT_TRUE(manager.isResident(3));
+    EXPECT_EQ(manager.takeEvictions(), std::vector<SongIdType>{4});
+
+    // once committed the displaced songs are on their way out for good
+    EXPECT_TRUE(manager.admit(4, 100));
+    manager.commit(4);
+    manager.revoke(4);
+    EXPECT_FALSE(manager.isResident(2));
+    EXPECT_EQ(manager.getUsedRows(), 100);
+    EXPECT_EQ(manager.takeEvictions(), (std::vector<SongIdType>{2, 4}));
+}
+
+TEST(CacheManager, TestRestore)
+{
+    CacheManager manager(makePolicy(250));
+    EXPECT_FALSE(manager.isComplete());
+    EXPECT_TRUE(manager.admit(1, 100));
+    manager.recordAccess(1);
+
+    // songs found in the tier after a restart are the first to go when it is over budget
+    manager.restore(2, 100);
+    manager.restore(3, 100);
+    manager.restore(1, 100);
+    EXPECT_EQ(manager.getResidentCount(), 3);
+    EXPECT_EQ(manager.takeEvictions(), std::vector<SongIdType>{3});
+    EXPECT_EQ(manager.getUsedRows(), 200);
+    manager.markComplete();
+    EXPECT_TRUE(manager.isComplete());
+    EXPECT_TRUE(manager.isResident(2));
+
+    // a deleted song frees its rows and is no longer evicted
+    manager.forget(2);
+    EXPECT_EQ(manager.getUsedRows(), 100);
+    EXPECT_FALSE(manager.isResident(2));
+    EXPECT_TRUE(manager.takeEvictions().empty());
+
+    CacheManager unbounded(makePolicy(0));
+    EXPECT_FALSE(unbounded.isBounded());
+    EXPECT_TRUE(unbounded.admit(1, 1000000));
+    EXPECT_TRUE(unbounded.takeEvictions().empty());
+}
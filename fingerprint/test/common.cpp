@@ -1,4 +1,8 @@
 #include "common.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 std::string initPostgresConnStr()
 {
@@ -14,4 +18,150 @@ std::string initElasticConnStr()
     std::stringstream elastic;
     elastic << "https://" << siren::getenv("ELASTIC_HOST") << ":" << siren::getenv("ES_PORT") << "/";
     return elastic.str();
-}
\ No newline at end of file
+}
+
+TestHttpServer::TestHttpServer(Handler handler)
+    : m_handler(std::move(handler))
+{
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(m_listenSocket, 512);
+
+    socklen_t length = sizeof(address);
+    getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+
+    m_acceptThread = std::thread([this] { acceptLoop(); });
+}
+
+TestHttpServer::~TestHttpServer()
+{
+    m_isStopping = true;
+    shutdown(m_listenSocket, SHUT_RDWR);
+    close(m_listenSocket);
+    m_acceptThread.join();
+
+    std::lock_guard lock(m_mtx);
+    for (auto&& thread: m_connections)
+    {
+        thread.join();
+    }
+}
+
+std::string TestHttpServer::getUrl() const
+{
+    return "http://127.0.0.1:" + std::to_string(m_port);
+}
+
+size_t TestHttpServer::getRequestCount() const
+{
+    return m_requestCount;
+}
+
+void TestHttpServer::acceptLoop()
+{
+    while (!m_isStopping)
+    {
+        int socket = accept(m_listenSocket, nullptr, nullptr);
+        if (socket < 0)
+        {
+            continue;
+        }
+        std::lock_guard lock(m_mtx);
+        m_connections.emplace_back([this, socket] { serve(socket); });
+    }
+}
+
+void TestHttpServer::serve(int socket)
+{
+    std::string data;
+    char buffer[4096];
+    size_t headerEnd = std::string::npos;
+    while (headerEnd == std::string::npos)
+    {
+        ssize_t count = recv(socket, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+        {
+            close(socket);
+            return;
+        }
+        data.append(buffer, count);
+        headerEnd = data.find("\r\n\r\n");
+    }
+
+    TestHttpRequest request;
+    std::istringstream head(data.substr(0, headerEnd));
+    std::string line;
+    std::getline(head, line);
+    std::istringstream requestLine(line);
+    requestLine >> request.method >> request.path;
+    while (std::getline(head, line))
+    {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            continue;
+        }
+        std::string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if (!value.empty() && value.back() == '\r')
+        {
+            value.pop_back();
+        }
+        std::string name = line.substr(0, colon);
+        for (auto& c: name)
+        {
+            c = static_cast<char>(std::tolower(c));
+        }
+        request.headers[name] = value;
+    }
+
+    size_t contentLength = request.headers.count("content-length") ? std::stoul(request.headers["content-length"]) : 0;
+    request.body = data.substr(headerEnd + 4);
+    while (request.body.size() < contentLength)
+    {
+        ssize_t count = recv(socket, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+        {
+            break;
+        }
+        request.body.append(buffer, count);
+    }
+    m_requestCount++;
+
+    TestHttpResponse response = m_handler(request);
+    if (response.delay.count() > 0)
+    {
+        std::this_thread::sleep_for(response.delay);
+    }
+
+    std::stringstream out;
+    out << "HTTP/1.1 " << response.status << " Status\r\n";
+    out << "Content-Length: " << response.body.size() << "\r\n";
+    out << "Connection: close\r\n";
+    for (const auto& [name, value]: response.headers)
+    {
+        out << name << ": " << value << "\r\n";
+    }
+    out << "\r\n" << response.body;
+
+    std::string raw = out.str();
+    size_t sent = 0;
+    while (sent < raw.size())
+    {
+        ssize_t count = send(socket, raw.data() + sent, raw.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0)
+        {
+            break;
+        }
+        sent += count;
+    }
+    close(socket);
+}
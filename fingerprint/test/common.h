@@ -1,7 +1,56 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
 #include "../src/common/common.h"
 
 std::string initPostgresConnStr();
-std::string initElasticConnStr();
\ No newline at end of file
+std::string initElasticConnStr();
+
+struct TestHttpRequest
+{
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers;
+    std::string body;
+};
+
+struct TestHttpResponse
+{
+    int status{200};
+    std::string body;
+    std::map<std::string, std::string> headers;
+    std::chrono::milliseconds delay{0};
+};
+
+// minimal HTTP/1.1 server on 127.0.0.1 for tests that must not depend on external services
+class TestHttpServer
+{
+public:
+    using Handler = std::function<TestHttpResponse(const TestHttpRequest&)>;
+
+    explicit TestHttpServer(Handler handler);
+    ~TestHttpServer();
+
+    std::string getUrl() const;
+    size_t getRequestCount() const;
+
+private:
+    void acceptLoop();
+    void serve(int socket);
+
+    Handler m_handler;
+    int m_listenSocket{-1};
+    uint16_t m_port{0};
+    std::atomic<bool> m_isStopping{false};
+    std::atomic<size_t> m_requestCount{0};
+    std::mutex m_mtx;
+    std::vector<std::thread> m_connections;
+    std::thread m_acceptThread;
+};
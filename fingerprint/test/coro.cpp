@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include "../src/thread_pool/async_manager.h"
+#include "../src/thread_pool/coro/async_scope.h"
+#include "../src/thread_pool/coro/timed_event.h"
+
+namespace coro = siren::cloud::coro;
+using siren::cloud::TaskPriority;
+
+static coro::Task<int> square(int value)
+{
+    co_return value * value;
+}
+
+static coro::Task<int> squareOnPool(int value, TaskPriority priority = TaskPriority::Interactive)
+{
+    co_await siren::cloud::AsyncManager::instance().schedule(priority);
+    co_return value * value;
+}
+
+static coro::Task<int> sumOfSquares(int count)
+{
+    int sum = 0;
+    for (int i = 0; i < count; i++)
+    {
+        sum += co_await square(i);
+    }
+    co_return sum;
+}
+
+static coro::Task<void> fail()
+{
+    co_await siren::cloud::AsyncManager::instance().schedule();
+    throw std::runtime_error("failure");
+}
+
+TEST(Coro, TestSyncWait)
+{
+    EXPECT_EQ(coro::syncWait(square(7)), 49);
+    EXPECT_EQ(coro::syncWait(squareOnPool(8)), 64);
+    EXPECT_THROW(coro::syncWait(fail()), std::runtime_error);
+}
+
+TEST(Coro, TestSymmetricTransfer)
+{
+    // a deep chain of synchronously completing awaits must not exhaust the stack
+    EXPECT_EQ(coro::syncWait(sumOfSquares(100000)), [] {
+        int sum = 0;
+        for (int i = 0; i < 100000; i++)
+        {
+            sum += i * i;
+        }
+        return sum;
+    }());
+}
+
+TEST(Coro, TestSchedule)
+{
+    auto callerId = std::this_thread::get_id();
+    auto task = [](std::thread::id callerId) -> coro::Task<bool> {
+        co_await siren::cloud::AsyncManager::instance().schedule(TaskPriority::Background);
+        co_return std::this_thread::get_id() != callerId;
+    };
+    EXPECT_TRUE(coro::syncWait(task(callerId)));
+}
+
+TEST(Coro, TestWhenAll)
+{
+    std::vector<coro::Task<int>> tasks;
+    for (int i = 0; i < 64; i++)
+    {
+        tasks.emplace_back(squareOnPool(i));
+    }
+    auto results = coro::syncWait(coro::whenAll(std::move(tasks)));
+    ASSERT_EQ(results.size(), 64);
+    for (int i = 0; i < 64; i++)
+    {
+        EXPECT_EQ(results[i], i * i);
+    }
+
+    EXPECT_TRUE(coro::syncWait(coro::whenAll(std::vector<coro::Task<int>>{})).empty());
+
+    std::vector<coro::Task<void>> failing;
+    failing.emplace_back(fail());
+    failing.emplace_back(fail());
+    EXPECT_THROW(coro::syncWait(coro::whenAll(std::move(failing))), std::runtime_error);
+}
+
+TEST(Coro, TestWhenAny)
+{
+    // the loser keeps running after whenAny resumes, so it must not refer to the test's stack
+    // it is suspended rather than spinning, so a pool of a single thread still has room for the winner
+    coro::TimedEvent release;
+    auto slow = [](coro::TimedEvent release) -> coro::Task<int> {
+        co_await release.wait(std::chrono::seconds(30));
+        co_return 1;
+    };
+
+    std::vector<coro::Task<int>> tasks;
+    tasks.emplace_back(slow(release));
+    tasks.emplace_back(squareOnPool(5));
+    auto [index, value] = coro::syncWait(coro::whenAny(std::move(tasks)));
+    EXPECT_EQ(index, 1);
+    EXPECT_EQ(value, 25);
+    release.set();
+}
+
+TEST(Coro, TestWhenAnyAccept)
+{
+    auto delayed = [](int value, int delayMs) -> coro::Task<int> {
+        co_await siren::cloud::AsyncManager::instance().scheduleAfter(std::chrono::milliseconds(delayMs));
+        co_return value;
+    };
+    auto isEven = [](const int& value) { return value % 2 == 0; };
+
+    // the quicker odd result is passed over in favour of the first even one
+    std::vector<coro::Task<int>> tasks;
+    tasks.emplace_back(delayed(1, 0));
+    tasks.emplace_back(delayed(4, 50));
+    tasks.emplace_back(delayed(6, 2000));
+    auto start = std::chrono::steady_clock::now();
+    auto [index, value] = coro::syncWait(coro::whenAny(std::move(tasks), isEven));
+    EXPECT_EQ(index, 1);
+    EXPECT_EQ(value, 4);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+    // without an accepted result the last one to complete wins
+    tasks.clear();
+    tasks.emplace_back(delayed(3, 50));
+    tasks.emplace_back(delayed(5, 0));
+    auto [lastIndex, lastValue] = coro::syncWait(coro::whenAny(std::move(tasks), isEven));
+    EXPECT_EQ(lastIndex, 0);
+    EXPECT_EQ(lastValue, 3);
+}
+
+TEST(Coro, TestTimedEvent)
+{
+    auto waitFor = [](coro::TimedEvent event, int delayMs) -> coro::Task<bool> {
+        co_await event.wait(std::chrono::milliseconds(delayMs));
+        co_return event.isSet();
+    };
+
+    // the delay runs out when nobody sets the event
+    coro::TimedEvent idle;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(coro::syncWait(waitFor(idle, 50)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(40));
+
+    // setting the event cuts the wait short
+    coro::TimedEvent early;
+    auto setter = siren::cloud::AsyncManager::instance().submitAfter(std::chrono::milliseconds(20), [early] { early.set(); });
+    start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(coro::syncWait(waitFor(early, 5000)));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+    // an event set beforehand is not waited on at all
+    start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(coro::syncWait(waitFor(early, 5000)));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+}
+
+TEST(Coro, TestAsyncScopeTrack)
+{
+    auto completed = std::make_shared<std::atomic<size_t>>(0);
+    auto slow = [](std::shared_ptr<std::atomic<size_t>> completed) -> coro::Task<int> {
+        co_await siren::cloud::AsyncManager::instance().scheduleAfter(std::chrono::milliseconds(100));
+        (*completed)++;
+        co_return 1;
+    };
+
+    coro::AsyncScope scope;
+    std::vector<coro::Task<int>> tasks;
+    tasks.emplace_back(scope.track(slow(completed)));
+    tasks.emplace_back(scope.track(squareOnPool(3)));
+    auto [index, value] = coro::syncWait(coro::whenAny(std::move(tasks)));
+    EXPECT_EQ(value, 9);
+
+    // the loser is still running but the scope knows about it
+    scope.join();
+    EXPECT_EQ(*completed, 1);
+    EXPECT_EQ(scope.getActiveCount(), 0);
+
+    // a tracked task dropped before it runs does not hold the scope up
+    {
+        auto dropped = scope.track(squareOnPool(4));
+        EXPECT_EQ(scope.getActiveCount(), 1);
+    }
+    EXPECT_EQ(scope.getActiveCount(), 0);
+}
+
+TEST(Coro, TestAsyncScope)
+{
+    std::atomic<size_t> completed{0};
+    {
+        coro::AsyncScope scope;
+        for (size_t i = 0; i < 32; i++)
+        {
+            scope.spawn([](std::atomic<size_t>& completed) -> coro::Task<void> {
+                co_await siren::cloud::AsyncManager::instance().schedule(TaskPriority::Maintenance);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                completed++;
+            }(completed));
+        }
+        scope.spawn(fail());
+        scope.join();
+        EXPECT_EQ(scope.getActiveCount(), 0);
+    }
+    EXPECT_EQ(completed, 32);
+}
@@ -164,10 +164,16 @@ TEST(ElasticSearch, TestBulk)
         }
     }
 
+    // the same searches awaited on the reactor instead of a blocked thread
+    QueryCollection asyncCollection = msearchCollection;
     auto mSearchCommand = connection->createCommand(std::move(msearchCollection));
     ASSERT_TRUE(mSearchCommand->execute());
     EXPECT_EQ(mSearchCommand->getSize(), range);
 
+    auto asyncCommand = connection->createCommand(std::move(asyncCollection));
+    ASSERT_TRUE(siren::cloud::coro::syncWait(asyncCommand->executeAsync()));
+    EXPECT_EQ(asyncCommand->getSize(), range);
+
     deleteIndex(connection);
     std::this_thread::sleep_for(std::chrono::seconds(1));
 }
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <map>
+#include "../src/engine/find_result_cache.h"
+#include "../src/thread_pool/async_manager.h"
+#include "../src/thread_pool/coro/task.h"
+
+namespace coro = siren::cloud::coro;
+using siren::cloud::FindCachePolicy;
+using siren::cloud::FindResult;
+using siren::cloud::FindResultCache;
+using siren::cloud::FingerprintType;
+using siren::cloud::HistReturnType;
+using siren::cloud::HistStatus;
+
+static FindResult makeHit(siren::cloud::SongIdType songId)
+{
+    return FindResult{true, HistReturnType{HistStatus::OK, songId, 0, 0.f}};
+}
+
+static FindResult makeMiss()
+{
+    return FindResult{false, HistReturnType{HistStatus::Uncertain}};
+}
+
+static FindCachePolicy makePolicy(size_t capacity)
+{
+    FindCachePolicy policy;
+    policy.capacity = capacity;
+    policy.ttl = std::chrono::milliseconds(10000);
+    policy.uncertainTtl = std::chrono::milliseconds(50);
+    return policy;
+}
+
+TEST(FindResultCache, TestDigest)
+{
+    std::map<uint64_t, uint32_t> hashes{{11, 1}, {42, 2}, {7, 3}};
+    std::multimap<uint64_t, uint32_t> shifted{{7, 10}, {11, 20}, {42, 30}, {42, 40}};
+    std::map<uint64_t, uint32_t> other{{11, 1}, {42, 2}, {8, 3}};
+
+    // timestamps and repeated hashes do not change what the snippet is looked up by
+    FindResultCache::Digest digest = FindResultCache::makeDigest(FingerprintType(hashes.begin(), hashes.end()));
+    EXPECT_EQ(digest, FindResultCache::makeDigest(FingerprintType(shifted.begin(), shifted.end())));
+    EXPECT_NE(digest, FindResultCache::makeDigest(FingerprintType(other.begin(), other.end())));
+}
+
+TEST(FindResultCache, TestEviction)
+{
+    FindResultCache cache(makePolicy(2));
+    for (FindResultCache::Digest digest = 1; digest <= 2; digest++)
+    {
+        bool isLeader = false;
+        auto flight = cache.join(digest, isLeader);
+        EXPECT_TRUE(isLeader);
+        cache.complete(digest, flight, makeHit(digest), true);
+    }
+
+    // touching the first entry makes the second one the least recently used
+    EXPECT_TRUE(cache.lookup(1));
+    bool isLeader = false;
+    cache.complete(3, cache.join(3, isLeader), makeHit(3), true);
+    EXPECT_EQ(cache.getSize(), 2);
+    EXPECT_FALSE(cache.lookup(2));
+    EXPECT_EQ(cache.lookup(1)->hist.getSongId(), 1);
+    EXPECT_EQ(cache.lookup(3)->hist.getSongId(), 3);
+
+    // uncertain outcomes expire sooner, uncacheable ones are not kept at all
+    cache.complete(4, cache.join(4, isLeader), makeMiss(), true);
+    cache.complete(5, cache.join(5, isLeader), makeMiss(), false);
+    EXPECT_TRUE(cache.lookup(4));
+    EXPECT_FALSE(cache.lookup(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_FALSE(cache.lookup(4));
+}
+
+TEST(FindResultCache, TestEvictSong)
+{
+    FindResultCache cache(makePolicy(16));
+    bool isLeader = false;
+    cache.complete(1, cache.join(1, isLeader), makeHit(7), true);
+    cache.complete(2, cache.join(2, isLeader), makeHit(7), true);
+    cache.complete(3, cache.join(3, isLeader), makeHit(8), true);
+    cache.complete(4, cache.join(4, isLeader), makeMiss(), true);
+
+    // every snippet that matched the deleted song is forgotten, the rest stays
+    cache.evictSong(7);
+    EXPECT_FALSE(cache.lookup(1));
+    EXPECT_FALSE(cache.lookup(2));
+    EXPECT_EQ(cache.lookup(3)->hist.getSongId(), 8);
+    EXPECT_TRUE(cache.lookup(4));
+    EXPECT_EQ(cache.getSize(), 2);
+}
+
+TEST(FindResultCache, TestSingleFlight)
+{
+    FindResultCache cache(makePolicy(16));
+    bool isLeader = false;
+    auto flight = cache.join(9, isLeader);
+    ASSERT_TRUE(isLeader);
+
+    auto follow = [](FindResultCache& cache) -> coro::Task<FindResult> {
+        co_await siren::cloud::AsyncManager::instance().schedule();
+        bool isLeader = false;
+        auto flight = cache.join(9, isLeader);
+        EXPECT_FALSE(isLeader);
+        co_return co_await cache.wait(std::move(flight));
+    };
+
+    size_t followerCount = 16;
+    std::vector<std::future<FindResult>> followers;
+    for (size_t i = 0; i < followerCount; i++)
+    {
+        followers.emplace_back(std::async(std::launch::async, [&cache, &follow] { return coro::syncWait(follow(cache)); }));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(cache.getInFlightCount(), 1);
+
+    cache.complete(9, flight, makeHit(77), true);
+    for (auto& follower: followers)
+    {
+        FindResult result = follower.get();
+        EXPECT_TRUE(result.isSuccess);
+        EXPECT_EQ(result.hist.getSongId(), 77);
+    }
+    EXPECT_EQ(cache.getInFlightCount(), 0);
+
+    // a waiter arriving after completion does not suspend
+    EXPECT_EQ(coro::syncWait([](FindResultCache& cache, FindResultCache::FlightPtr flight) -> coro::Task<FindResult> {
+        co_return co_await cache.wait(std::move(flight));
+    }(cache, flight)).hist.getSongId(), 77);
+}
+
+TEST(FindResultCache, TestCancelledJoin)
+{
+    FindCachePolicy policy = makePolicy(16);
+    policy.joinPollInterval = std::chrono::milliseconds(5);
+    FindResultCache cache(policy);
+    bool isLeader = false;
+    auto flight = cache.join(9, isLeader);
+    ASSERT_TRUE(isLeader);
+
+    auto follow = [](FindResultCache& cache, siren::cloud::CancellationToken cancellation) -> coro::Task<FindResult> {
+        bool isLeader = false;
+        co_return co_await cache.wait(cache.join(9, isLeader), std::move(cancellation));
+    };
+
+    // a joiner gives up on its own deadline or cancellation while the flight goes on
+    auto start = std::chrono::steady_clock::now();
+    auto expired = siren::cloud::CancellationToken::create(start + std::chrono::milliseconds(30));
+    EXPECT_FALSE(coro::syncWait(follow(cache, expired)).isSuccess);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+    auto cancelled = siren::cloud::CancellationToken::create();
+    auto cancelling = std::async(std::launch::async, [cancelled] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cancelled.cancel();
+    });
+    EXPECT_FALSE(coro::syncWait(follow(cache, cancelled)).isSuccess);
+    EXPECT_EQ(cache.getInFlightCount(), 1);
+
+    // completing the flight afterwards leaves the joiners that gave up alone
+    auto patient = std::async(std::launch::async, [&cache, &follow] {
+        return coro::syncWait(follow(cache, siren::cloud::CancellationToken::create()));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    cache.complete(9, flight, makeHit(77), true);
+    EXPECT_EQ(patient.get().hist.getSongId(), 77);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "../src/common/request_manager.h"
+#include "common.h"
+
+using siren::cloud::HttpClient;
+using siren::cloud::HttpRequest;
+using siren::cloud::HttpResponse;
+
+static TestHttpResponse echo(const TestHttpRequest& request)
+{
+    TestHttpResponse response;
+    response.body = request.method + ' ' + request.path + ' ' + request.body;
+    if (request.path == "/slow")
+    {
+        response.delay = std::chrono::milliseconds(300);
+    }
+    if (request.path == "/missing")
+    {
+        response.status = 404;
+    }
+    return response;
+}
+
+TEST(HttpClient, TestMethods)
+{
+    TestHttpServer server(echo);
+    HttpClient client(1, 8);
+
+    for (std::string method: {"GET", "POST", "PUT", "DELETE"})
+    {
+        HttpRequest request;
+        request.method = method;
+        request.url = server.getUrl() + "/path";
+        request.body = "payload";
+        request.headers.emplace_back("Content-Type: application/json");
+
+        HttpResponse response = client.send(std::move(request)).get();
+        EXPECT_EQ(response.status_code, 200);
+        EXPECT_EQ(response.text, method + " /path payload");
+    }
+
+    HttpRequest missing;
+    missing.url = server.getUrl() + "/missing";
+    EXPECT_EQ(client.send(std::move(missing)).get().status_code, 404);
+}
+
+TEST(HttpClient, TestMultiplexing)
+{
+    TestHttpServer server(echo);
+    HttpClient client(2, 256);
+
+    // every request is delayed by the server, running them one at a time would take a minute
+    size_t requestCount = 200;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<HttpResponse>> futures;
+    for (size_t i = 0; i < requestCount; i++)
+    {
+        HttpRequest request;
+        request.method = "POST";
+        request.url = server.getUrl() + "/slow";
+        request.body = std::to_string(i);
+        futures.emplace_back(client.send(std::move(request)));
+    }
+    for (size_t i = 0; i < requestCount; i++)
+    {
+        HttpResponse response = futures[i].get();
+        EXPECT_EQ(response.status_code, 200);
+        EXPECT_EQ(response.text, "POST /slow " + std::to_string(i));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+    EXPECT_EQ(client.getInFlightCount(), 0);
+}
+
+TEST(HttpClient, TestErrors)
+{
+    HttpClient client(1, 8);
+    {
+        TestHttpServer server(echo);
+
+        HttpRequest request;
+        request.url = server.getUrl() + "/slow";
+        request.timeout = std::chrono::milliseconds(50);
+        HttpResponse response = client.send(std::move(request)).get();
+        EXPECT_EQ(response.status_code, 0);
+        EXPECT_FALSE(response.error.message.empty());
+
+        std::string streamed;
+        HttpRequest streaming;
+        streaming.url = server.getUrl() + "/stream";
+        streaming.onData = [&streamed](long, std::string_view chunk) {
+            streamed.append(chunk);
+            return true;
+        };
+        response = client.send(std::move(streaming)).get();
+        EXPECT_EQ(response.status_code, 200);
+        EXPECT_TRUE(response.text.empty());
+        EXPECT_EQ(streamed, "GET /stream ");
+    }
+
+    HttpRequest refused;
+    refused.url = "http://127.0.0.1:1/";
+    HttpResponse response = client.send(std::move(refused)).get();
+    EXPECT_EQ(response.status_code, 0);
+    EXPECT_FALSE(response.error.message.empty());
+}
+
+TEST(HttpClient, TestCoroutine)
+{
+    TestHttpServer server(echo);
+    auto fetch = [](std::string url) -> siren::cloud::coro::Task<std::string> {
+        HttpRequest request;
+        request.url = std::move(url);
+        HttpResponse response = co_await siren::cloud::RequestManager::SendAsync(std::move(request));
+        co_return response.text;
+    };
+    EXPECT_EQ(siren::cloud::coro::syncWait(fetch(server.getUrl() + "/coro")), "GET /coro ");
+}
+
+TEST(HttpClient, TestCancellation)
+{
+    TestHttpServer server(echo);
+    HttpClient client(1, 8);
+
+    HttpRequest expired;
+    expired.url = server.getUrl() + "/slow";
+    expired.cancellation = siren::cloud::CancellationToken::create(std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+    HttpResponse response = client.send(std::move(expired)).get();
+    EXPECT_EQ(response.status_code, 0);
+
+    auto token = siren::cloud::CancellationToken::create();
+    HttpRequest cancelled;
+    cancelled.url = server.getUrl() + "/slow";
+    cancelled.cancellation = token;
+    auto start = std::chrono::steady_clock::now();
+    auto future = client.send(std::move(cancelled));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    token.cancel();
+    EXPECT_EQ(future.get().status_code, 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(300));
+
+    HttpRequest late;
+    late.url = server.getUrl() + "/path";
+    late.cancellation = token;
+    EXPECT_EQ(client.send(std::move(late)).get().status_code, 0);
+    EXPECT_EQ(server.getRequestCount(), 2);
+}
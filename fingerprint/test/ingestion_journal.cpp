@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include "../src/ingestion/ingestion_journal.h"
+
+using siren::cloud::FingerprintType;
+using siren::cloud::IngestionJournal;
+using siren::cloud::JournalEntry;
+
+static std::string makePath(const std::string& name)
+{
+    std::string path = "/tmp/" + name + '-' + std::to_string(getpid()) + ".journal";
+    std::filesystem::remove(path);
+    return path;
+}
+
+static JournalEntry makeEntry(siren::cloud::SongIdType songId, size_t size)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> rows;
+    for (size_t i = 0; i < size; i++)
+    {
+        rows.emplace_back(songId * 1000 + i, static_cast<uint32_t>(i));
+    }
+    return JournalEntry{songId, songId % 2 == 0, std::make_shared<const FingerprintType>(rows.begin(), rows.end())};
+}
+
+TEST(IngestionJournal, TestReplay)
+{
+    std::string path = makePath("replay");
+    {
+        IngestionJournal journal;
+        std::vector<JournalEntry> recovered;
+        ASSERT_TRUE(journal.open(path, recovered));
+        EXPECT_TRUE(recovered.empty());
+
+        ASSERT_TRUE(journal.appendPending({makeEntry(1, 10), makeEntry(2, 20), makeEntry(3, 0)}));
+        ASSERT_TRUE(journal.appendDone({1}));
+        EXPECT_EQ(journal.getPendingCount(), 2);
+    }
+
+    // the process died with songs 2 and 3 unwritten
+    IngestionJournal journal;
+    std::vector<JournalEntry> recovered;
+    ASSERT_TRUE(journal.open(path, recovered));
+    ASSERT_EQ(recovered.size(), 2);
+    EXPECT_EQ(recovered[0].songId, 2);
+    EXPECT_TRUE(recovered[0].isCaching);
+    ASSERT_EQ(recovered[0].fingerprint->get_size(), 20);
+    EXPECT_EQ(recovered[0].fingerprint->cbegin()->first, 2000);
+    EXPECT_EQ(recovered[1].songId, 3);
+    EXPECT_EQ(recovered[1].fingerprint->get_size(), 0);
+
+    // once nothing is pending the file is emptied
+    ASSERT_TRUE(journal.appendDone({2, 3}));
+    EXPECT_EQ(journal.getPendingCount(), 0);
+    EXPECT_EQ(std::filesystem::file_size(path), 0);
+    std::filesystem::remove(path);
+}
+
+TEST(IngestionJournal, TestTornTail)
+{
+    std::string path = makePath("torn");
+    {
+        IngestionJournal journal;
+        std::vector<JournalEntry> recovered;
+        ASSERT_TRUE(journal.open(path, recovered));
+        ASSERT_TRUE(journal.appendPending({makeEntry(1, 10)}));
+        ASSERT_TRUE(journal.appendPending({makeEntry(2, 10)}));
+    }
+    // a crash halfway through the last record
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 7);
+
+    {
+        IngestionJournal journal;
+        std::vector<JournalEntry> recovered;
+        ASSERT_TRUE(journal.open(path, recovered));
+        ASSERT_EQ(recovered.size(), 1);
+        EXPECT_EQ(recovered[0].songId, 1);
+
+        // records appended after the torn one are not hidden by it
+        ASSERT_TRUE(journal.appendPending({makeEntry(4, 5)}));
+    }
+
+    IngestionJournal journal;
+    std::vector<JournalEntry> recovered;
+    ASSERT_TRUE(journal.open(path, recovered));
+    ASSERT_EQ(recovered.size(), 2);
+    EXPECT_EQ(recovered[1].songId, 4);
+    std::filesystem::remove(path);
+}
+
+TEST(IngestionJournal, TestCompaction)
+{
+    std::string path = makePath("compaction");
+    {
+        IngestionJournal journal(1024);
+        std::vector<JournalEntry> recovered;
+        ASSERT_TRUE(journal.open(path, recovered));
+        ASSERT_TRUE(journal.appendPending({makeEntry(1, 200), makeEntry(2, 5)}));
+        ASSERT_TRUE(journal.appendPending({makeEntry(3, 5)}));
+        size_t grownSize = journal.getFileSize();
+
+        // song 1 is done while the others are still in flight, so the file is rewritten rather than emptied
+        ASSERT_TRUE(journal.appendDone({1}));
+        EXPECT_LT(journal.getFileSize(), grownSize / 4);
+        EXPECT_EQ(std::filesystem::file_size(path), journal.getFileSize());
+
+        // appends go to the rewritten file
+        ASSERT_TRUE(journal.appendPending({makeEntry(4, 5)}));
+        EXPECT_EQ(std::filesystem::file_size(path), journal.getFileSize());
+    }
+
+    IngestionJournal journal;
+    std::vector<JournalEntry> recovered;
+    ASSERT_TRUE(journal.open(path, recovered));
+    ASSERT_EQ(recovered.size(), 3);
+    std::vector<siren::cloud::SongIdType> songIds;
+    for (const auto& entry: recovered)
+    {
+        songIds.push_back(entry.songId);
+        EXPECT_EQ(entry.fingerprint->get_size(), 5);
+    }
+    std::sort(songIds.begin(), songIds.end());
+    EXPECT_EQ(songIds, (std::vector<siren::cloud::SongIdType>{2, 3, 4}));
+    EXPECT_FALSE(std::filesystem::exists(path + ".compact"));
+    std::filesystem::remove(path);
+}
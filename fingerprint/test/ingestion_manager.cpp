@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include "../src/ingestion/ingestion_manager.h"
+
+using siren::cloud::IngestionJob;
+using siren::cloud::IngestionManager;
+using siren::cloud::IngestionPolicy;
+using siren::cloud::JobState;
+
+static IngestionPolicy makePolicy(size_t capacity, size_t parallelism)
+{
+    IngestionPolicy policy;
+    policy.capacity = capacity;
+    policy.parallelism = {parallelism, parallelism, parallelism};
+    policy.retainedCount = 4;
+    return policy;
+}
+
+// counts how many jobs are inside a stage at once
+struct ConcurrencyProbe
+{
+    bool operator()(IngestionJob& job)
+    {
+        size_t current = ++running;
+        size_t seen = maxRunning.load();
+        while (current > seen && !maxRunning.compare_exchange_weak(seen, current))
+        {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        running--;
+        return true;
+    }
+
+    std::atomic<size_t> running{0};
+    std::atomic<size_t> maxRunning{0};
+};
+
+TEST(IngestionManager, TestPipeline)
+{
+    IngestionManager manager({
+        [](IngestionJob& job) { return job.track.open("track") && job.track.append(std::to_string(job.songId)); },
+        [](IngestionJob& job) { return job.track.getSize() == std::to_string(job.songId).size(); },
+        [](IngestionJob& job) { return job.url == "https://example.com/track"; }
+    }, makePolicy(8, 2));
+
+    auto jobId = manager.submit("https://example.com/track", 42, true);
+    ASSERT_TRUE(jobId);
+    manager.join();
+
+    auto status = manager.getStatus(*jobId);
+    ASSERT_TRUE(status);
+    EXPECT_EQ(status->state, JobState::Done);
+    EXPECT_EQ(status->songId, 42);
+    EXPECT_EQ(manager.getActiveCount(), 0);
+    EXPECT_FALSE(manager.getStatus(*jobId + 1));
+}
+
+TEST(IngestionManager, TestParallelism)
+{
+    ConcurrencyProbe download;
+    ConcurrencyProbe fingerprint;
+    IngestionPolicy policy = makePolicy(16, 4);
+    policy.parallelism[1] = 1;
+    IngestionManager manager({
+        [&download](IngestionJob& job) { return download(job); },
+        [&fingerprint](IngestionJob& job) { return fingerprint(job); },
+        [](IngestionJob&) { return true; }
+    }, policy);
+
+    for (size_t i = 0; i < 6; i++)
+    {
+        ASSERT_TRUE(manager.submit("url", i, false));
+    }
+    manager.join();
+
+    // downloads overlap, the fingerprinting stage takes one job at a time
+    EXPECT_GT(download.maxRunning, 1);
+    EXPECT_LE(download.maxRunning, 4);
+    EXPECT_EQ(fingerprint.maxRunning, 1);
+}
+
+TEST(IngestionManager, TestCapacityAndFailure)
+{
+    std::atomic<bool> isReleased{false};
+    IngestionManager manager({
+        [&isReleased](IngestionJob&) {
+            while (!isReleased)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        },
+        [](IngestionJob& job) {
+            if (job.songId == 2)
+            {
+                job.error = "could not fingerprint";
+                return false;
+            }
+            return true;
+        },
+        [](IngestionJob&) { return true; }
+    }, makePolicy(2, 2));
+
+    auto first = manager.submit("url", 1, false);
+    auto second = manager.submit("url", 2, false);
+    ASSERT_TRUE(first && second);
+    // a full queue refuses the load instead of growing without bound
+    EXPECT_FALSE(manager.submit("url", 3, false));
+
+    isReleased = true;
+    manager.join();
+    EXPECT_EQ(manager.getStatus(*first)->state, JobState::Done);
+    EXPECT_EQ(manager.getStatus(*second)->state, JobState::Failed);
+    EXPECT_EQ(manager.getStatus(*second)->error, "could not fingerprint");
+
+    // only the most recently finished jobs are remembered
+    for (size_t i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(manager.submit("url", 10 + i, false));
+        manager.join();
+    }
+    EXPECT_FALSE(manager.getStatus(*first));
+}
+
+TEST(IngestionManager, TestThrowingStage)
+{
+    IngestionManager manager({
+        [](IngestionJob& job) {
+            if (job.songId == 1)
+            {
+                throw std::runtime_error("download broke");
+            }
+            return true;
+        },
+        [](IngestionJob& job) -> bool {
+            if (job.songId == 2)
+            {
+                throw 2;
+            }
+            return true;
+        },
+        [](IngestionJob&) { return true; }
+    }, makePolicy(4, 2));
+
+    // a stage that throws fails its jobs instead of leaving them running forever
+    auto first = manager.submit("url", 1, false);
+    auto second = manager.submit("url", 2, false);
+    auto third = manager.submit("url", 3, false);
+    ASSERT_TRUE(first && second && third);
+    manager.join();
+    EXPECT_EQ(manager.getStatus(*first)->state, JobState::Failed);
+    EXPECT_EQ(manager.getStatus(*first)->error, "download broke");
+    EXPECT_EQ(manager.getStatus(*second)->state, JobState::Failed);
+    EXPECT_EQ(manager.getStatus(*third)->state, JobState::Done);
+    EXPECT_EQ(manager.getActiveCount(), 0);
+}
+
+TEST(IngestionManager, TestLongTracks)
+{
+    IngestionPolicy policy = makePolicy(16, 2);
+    policy.longTrackSize = 100;
+    policy.longTrackParallelism = 1;
+
+    ConcurrencyProbe longTracks;
+    std::mutex mtx;
+    std::vector<siren::cloud::SongIdType> finished;
+    IngestionManager manager({
+        [](IngestionJob& job) { return job.track.open("track") && job.track.append(std::string(job.songId < 10 ? 200 : 1, 'x')); },
+        [&](IngestionJob& job) {
+            if (job.track.getSize() >= 100)
+            {
+                longTracks(job);
+            }
+            // the buffer is gone once a track has been fingerprinted
+            job.track.close();
+            std::lock_guard lock(mtx);
+            finished.push_back(job.songId);
+            return true;
+        },
+        [](IngestionJob&) { return true; }
+    }, policy);
+
+    ASSERT_TRUE(manager.submit("url", 1, false));
+    ASSERT_TRUE(manager.submit("url", 2, false));
+    for (size_t i = 10; i < 13; i++)
+    {
+        ASSERT_TRUE(manager.submit("url", i, false));
+    }
+    manager.join();
+
+    // one long track at a time, the short ones go past the long one that waits instead of queueing behind it
+    EXPECT_EQ(longTracks.maxRunning, 1);
+    ASSERT_EQ(finished.size(), 5);
+    EXPECT_LT(finished[3], 10);
+    EXPECT_LT(finished[4], 10);
+}
+
+TEST(IngestionManager, TestBatches)
+{
+    IngestionPolicy policy = makePolicy(16, 1);
+    policy.batchSize[static_cast<size_t>(siren::cloud::IngestionStage::Store)] = 4;
+    policy.retainedCount = 16;
+
+    std::mutex mtx;
+    std::vector<size_t> batchSizes;
+    IngestionManager manager(std::array<IngestionManager::BatchStage, siren::cloud::IngestionStageCount>{
+        IngestionManager::forEachJob([](IngestionJob&) { return true; }),
+        IngestionManager::forEachJob([](IngestionJob&) { return true; }),
+        [&](const std::vector<IngestionJob*>& jobs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            std::lock_guard lock(mtx);
+            batchSizes.push_back(jobs.size());
+            std::vector<bool> results;
+            for (IngestionJob* job: jobs)
+            {
+                results.push_back(job->songId != 3);
+            }
+            return results;
+        }
+    }, policy);
+
+    std::vector<siren::cloud::JobIdType> jobIds;
+    for (size_t i = 0; i < 8; i++)
+    {
+        jobIds.push_back(*manager.submit("url", i, false));
+    }
+    // a job an earlier run left behind goes straight to storing
+    IngestionJob recovered{0, {}, 100, false};
+    recovered.isRecovered = true;
+    auto recoveredId = manager.resume(std::move(recovered), siren::cloud::IngestionStage::Store);
+    manager.join();
+
+    // jobs piling up behind the busy store stage are written together, each keeps its own outcome
+    EXPECT_GT(*std::max_element(batchSizes.begin(), batchSizes.end()), 1);
+    EXPECT_LE(*std::max_element(batchSizes.begin(), batchSizes.end()), 4);
+    EXPECT_EQ(std::accumulate(batchSizes.begin(), batchSizes.end(), size_t{0}), 9);
+    EXPECT_EQ(manager.getStatus(jobIds[3])->state, JobState::Failed);
+    EXPECT_EQ(manager.getStatus(jobIds[4])->state, JobState::Done);
+    EXPECT_EQ(manager.getStatus(recoveredId)->state, JobState::Done);
+
+    // a changed batch size applies to the runs that follow
+    manager.setBatchSize(siren::cloud::IngestionStage::Store, 0);
+    EXPECT_EQ(manager.getBatchSize(siren::cloud::IngestionStage::Store), 1);
+    batchSizes.clear();
+    for (size_t i = 0; i < 4; i++)
+    {
+        manager.submit("url", 10 + i, false);
+    }
+    manager.join();
+    EXPECT_EQ(batchSizes, std::vector<size_t>(4, 1));
+}
@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+#include "../src/common/latency_tracker.h"
+
+using siren::cloud::LatencyTracker;
+
+TEST(LatencyTracker, TestPercentile)
+{
+    LatencyTracker tracker(100, 10);
+    EXPECT_EQ(tracker.getPercentile(0.95, std::chrono::milliseconds(7)), std::chrono::milliseconds(7));
+
+    for (int i = 1; i <= 100; i++)
+    {
+        tracker.record(std::chrono::milliseconds(i));
+    }
+    EXPECT_EQ(tracker.getPercentile(0.5, {}), std::chrono::milliseconds(50));
+    EXPECT_EQ(tracker.getPercentile(0.95, {}), std::chrono::milliseconds(95));
+    EXPECT_EQ(tracker.getPercentile(1.0, {}), std::chrono::milliseconds(100));
+}
+
+TEST(LatencyTracker, TestWindow)
+{
+    LatencyTracker tracker(50, 10);
+    for (int i = 0; i < 50; i++)
+    {
+        tracker.record(std::chrono::milliseconds(500));
+    }
+    // the old samples are overwritten once the backend speeds up
+    for (int i = 0; i < 50; i++)
+    {
+        tracker.record(std::chrono::microseconds(1500));
+    }
+    EXPECT_EQ(tracker.getSampleCount(), 50);
+    EXPECT_EQ(tracker.getPercentile(0.95, {}), std::chrono::milliseconds(2));
+}
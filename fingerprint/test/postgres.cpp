@@ -138,4 +138,69 @@ TEST(PostgresCommand, TestSingleLargeResult)
     }
 
     ASSERT_TRUE(dropPostgresTestTable(connection));
-}
\ No newline at end of file
+}
+
+TEST(PostgresCommand, TestAsync)
+{
+    std::string connStr = initPostgresConnStr();
+    auto postgresConnector = std::make_shared<siren::cloud::postgres::PostgresConnector>(connStr);
+    auto connection = postgresConnector->createConnection();
+
+    ASSERT_TRUE(initPostgresTestTable(connection));
+
+    size_t range = 100;
+    QueryCollection insertCollection;
+    for (size_t i = 0; i < range; i++)
+    {
+        Query insertQuery;
+        std::stringstream insertStream;
+        insertStream << "INSERT INTO postgres_test (id, test) VALUES (" << i << ',' << i << ')';
+        insertQuery.emplace("query", insertStream.str());
+        insertCollection.insertQuery(std::move(insertQuery));
+    }
+    auto insertCommand = connection->createCommand(std::move(insertCollection));
+    ASSERT_TRUE(siren::cloud::coro::syncWait(insertCommand->executeAsync()));
+
+    QueryCollection selectCollection;
+    for (size_t i = 0; i < range; i++)
+    {
+        Query selectQuery;
+        std::stringstream selectStream;
+        selectStream << "SELECT * FROM postgres_test WHERE id =" << i;
+        selectQuery.emplace("query", selectStream.str());
+        selectCollection.insertQuery(std::move(selectQuery));
+    }
+    auto selectCommand = connection->createCommand(std::move(selectCollection));
+    ASSERT_TRUE(siren::cloud::coro::syncWait(selectCommand->executeAsync()));
+    EXPECT_EQ(selectCommand->getSize(), range);
+
+    int expected = 0;
+    while (selectCommand->fetchNext())
+    {
+        int val;
+        ASSERT_TRUE(selectCommand->asInt32("id", val));
+        EXPECT_EQ(val, expected++);
+    }
+    EXPECT_EQ(expected, range);
+
+    // a failing statement aborts the whole pipeline and leaves the connection usable
+    QueryCollection failingCollection;
+    Query failingQuery;
+    failingQuery.emplace("query", "SELECT * FROM postgres_missing_table");
+    failingCollection.insertQuery(std::move(failingQuery));
+    Query skippedQuery;
+    skippedQuery.emplace("query", "INSERT INTO postgres_test (id, test) VALUES (-1, -1)");
+    failingCollection.insertQuery(std::move(skippedQuery));
+    auto failingCommand = connection->createCommand(std::move(failingCollection));
+    EXPECT_FALSE(siren::cloud::coro::syncWait(failingCommand->executeAsync()));
+
+    Query countQuery;
+    countQuery.emplace("query", "SELECT COUNT(*) AS count FROM postgres_test WHERE id = -1");
+    auto countCommand = connection->createCommand(std::move(countQuery));
+    ASSERT_TRUE(siren::cloud::coro::syncWait(countCommand->executeAsync()));
+    int64_t count;
+    ASSERT_TRUE(countCommand->asInt64("count", count));
+    EXPECT_EQ(count, 0);
+
+    ASSERT_TRUE(dropPostgresTestTable(connection));
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <set>
+#include "../src/engine/promotion_manager.h"
+
+using siren::cloud::PromotionManager;
+using siren::cloud::PromotionPolicy;
+using siren::cloud::SongIdType;
+
+struct RecordingPromoter
+{
+    bool operator()(const std::vector<SongIdType>& songIds)
+    {
+        std::this_thread::sleep_for(delay);
+        std::lock_guard lock(mtx);
+        batches.push_back(songIds);
+        return isSucceeding;
+    }
+
+    std::mutex mtx;
+    std::vector<std::vector<SongIdType>> batches;
+    std::chrono::milliseconds delay{0};
+    bool isSucceeding{true};
+};
+
+static PromotionPolicy makePolicy(size_t batchSize, std::chrono::milliseconds batchDelay)
+{
+    PromotionPolicy policy;
+    policy.batchSize = batchSize;
+    policy.batchDelay = batchDelay;
+    policy.cooldown = std::chrono::milliseconds(200);
+    return policy;
+}
+
+TEST(Promotion, TestDeduplication)
+{
+    RecordingPromoter promoter;
+    promoter.delay = std::chrono::milliseconds(50);
+    PromotionManager manager([&promoter](const auto& songIds) { return promoter(songIds); }, makePolicy(8, std::chrono::milliseconds(20)));
+
+    // a trending song missed by many requests at once is copied a single time
+    std::vector<std::thread> threads;
+    std::atomic<size_t> acceptedCount{0};
+    for (size_t i = 0; i < 16; i++)
+    {
+        threads.emplace_back([&manager, &acceptedCount] {
+            if (manager.request(42))
+            {
+                acceptedCount++;
+            }
+        });
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    EXPECT_EQ(acceptedCount, 1);
+    EXPECT_EQ(manager.getPendingCount(), 1);
+
+    manager.join();
+    ASSERT_EQ(promoter.batches.size(), 1);
+    EXPECT_EQ(promoter.batches[0], std::vector<SongIdType>{42});
+    EXPECT_EQ(manager.getPendingCount(), 0);
+
+    // the cache may not have made it searchable yet
+    EXPECT_FALSE(manager.request(42));
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    EXPECT_TRUE(manager.request(42));
+}
+
+TEST(Promotion, TestBatching)
+{
+    RecordingPromoter promoter;
+    PromotionManager manager([&promoter](const auto& songIds) { return promoter(songIds); }, makePolicy(4, std::chrono::milliseconds(500)));
+
+    // a full batch goes out right away instead of waiting for the delay
+    auto start = std::chrono::steady_clock::now();
+    for (SongIdType songId = 1; songId <= 4; songId++)
+    {
+        EXPECT_TRUE(manager.request(songId));
+    }
+    while (manager.getPendingCount() != 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(2))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(manager.getPendingCount(), 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(400));
+    ASSERT_EQ(promoter.batches.size(), 1);
+    EXPECT_EQ(std::set<SongIdType>(promoter.batches[0].begin(), promoter.batches[0].end()), (std::set<SongIdType>{1, 2, 3, 4}));
+}
+
+TEST(Promotion, TestFailure)
+{
+    RecordingPromoter promoter;
+    promoter.isSucceeding = false;
+    PromotionPolicy policy = makePolicy(4, std::chrono::milliseconds(10));
+    policy.failureBackoff = std::chrono::milliseconds(100);
+    policy.maxFailureBackoff = std::chrono::milliseconds(150);
+    PromotionManager manager([&promoter](const auto& songIds) { return promoter(songIds); }, policy);
+
+    // a failed copy is retried by a later miss, but not before it has backed off
+    EXPECT_TRUE(manager.request(7));
+    manager.join();
+    EXPECT_FALSE(manager.request(7));
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    EXPECT_TRUE(manager.request(7));
+    manager.join();
+    EXPECT_EQ(promoter.batches.size(), 2);
+
+    // every further failure backs off longer, up to the limit
+    EXPECT_FALSE(manager.request(7));
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    EXPECT_FALSE(manager.request(7));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    promoter.isSucceeding = true;
+    EXPECT_TRUE(manager.request(7));
+    manager.join();
+    EXPECT_EQ(promoter.batches.size(), 3);
+
+    // success starts the usual cooldown and forgets the failures
+    EXPECT_FALSE(manager.request(7));
+}
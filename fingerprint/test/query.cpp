@@ -29,4 +29,14 @@ TEST(Query, TestCompatibility)
     third.emplace("second", "...");
     third.emplace("third", "...");
     ASSERT_TRUE(queryCollection.insertQuery(std::move(third)));
+}
+
+TEST(Query, TestAccess)
+{
+    Query query;
+    query.emplace("query", "body");
+    EXPECT_EQ(query.view("query"), "body");
+    EXPECT_TRUE(query.view("missing").empty());
+    EXPECT_EQ(query.take("query"), "body");
+    EXPECT_TRUE(query.view("query").empty());
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include <mutex>
+#include <set>
+#include "../src/common/ranged_downloader.h"
+#include "common.h"
+
+using siren::cloud::DownloadPolicy;
+using siren::cloud::DownloadSink;
+using siren::cloud::HttpResponse;
+using siren::cloud::RangedDownloader;
+
+static std::string makeFile(size_t size)
+{
+    std::string file(size, '\0');
+    for (size_t i = 0; i < size; i++)
+    {
+        file[i] = static_cast<char>('a' + i % 26);
+    }
+    return file;
+}
+
+// answers "Range: bytes=a-b" the way a static file server does
+static TestHttpResponse serveRange(const std::string& file, const TestHttpRequest& request)
+{
+    TestHttpResponse response;
+    auto range = request.headers.find("range");
+    if (range == request.headers.end())
+    {
+        response.body = file;
+        return response;
+    }
+    size_t begin = std::stoul(range->second.substr(range->second.find('=') + 1));
+    size_t end = std::min<size_t>(std::stoul(range->second.substr(range->second.find('-') + 1)) + 1, file.size());
+    response.status = 206;
+    response.body = file.substr(begin, end - begin);
+    response.headers["Content-Range"] = "bytes " + std::to_string(begin) + '-' + std::to_string(end - 1) + '/' + std::to_string(file.size());
+    return response;
+}
+
+struct StringSink
+{
+    DownloadSink get()
+    {
+        return DownloadSink{
+            [this](size_t size) {
+                std::lock_guard lock(mtx);
+                content.resize(size);
+                return true;
+            },
+            [this](size_t offset, std::string_view chunk) {
+                std::lock_guard lock(mtx);
+                content.resize(std::max(content.size(), offset + chunk.size()));
+                content.replace(offset, chunk.size(), chunk);
+                return true;
+            }
+        };
+    }
+
+    std::mutex mtx;
+    std::string content;
+};
+
+static DownloadPolicy makePolicy(size_t rangeSize, size_t maxRetries)
+{
+    DownloadPolicy policy;
+    policy.parallelism = 4;
+    policy.rangeSize = rangeSize;
+    policy.maxRetries = maxRetries;
+    policy.minThroughput = 0;
+    policy.isVerifying = false;
+    return policy;
+}
+
+TEST(RangedDownloader, TestRanges)
+{
+    std::string file = makeFile(1000003);
+    TestHttpServer server([&file](const TestHttpRequest& request) { return serveRange(file, request); });
+
+    StringSink sink;
+    HttpResponse response = RangedDownloader(makePolicy(65536, 0)).download(server.getUrl() + "/track", sink.get());
+    EXPECT_EQ(response.status_code, 200);
+    EXPECT_EQ(sink.content, file);
+    // the probe is the first of the ranges, no request is spent on asking for the size alone
+    EXPECT_EQ(server.getRequestCount(), 16);
+}
+
+TEST(RangedDownloader, TestWithoutRangeSupport)
+{
+    std::string file = makeFile(200000);
+    TestHttpServer server([&file](const TestHttpRequest&) {
+        TestHttpResponse response;
+        response.body = file;
+        return response;
+    });
+
+    StringSink sink;
+    HttpResponse response = RangedDownloader(makePolicy(65536, 0)).download(server.getUrl() + "/track", sink.get());
+    EXPECT_EQ(response.status_code, 200);
+    EXPECT_EQ(sink.content, file);
+    EXPECT_EQ(server.getRequestCount(), 1);
+}
+
+TEST(RangedDownloader, TestIgnoredRange)
+{
+    std::string file = makeFile(200000);
+    TestHttpServer server([&file](const TestHttpRequest& request) {
+        // the probe is ranged, every later range gets the whole file
+        if (request.headers.at("range").rfind("bytes=0-", 0) == 0)
+        {
+            return serveRange(file, request);
+        }
+        TestHttpResponse response;
+        response.body = file;
+        return response;
+    });
+
+    StringSink sink;
+    HttpResponse response = RangedDownloader(makePolicy(65536, 2)).download(server.getUrl() + "/track", sink.get());
+    EXPECT_NE(response.status_code, 200);
+    // nothing of the misplaced bodies reaches the file
+    EXPECT_EQ(sink.content.substr(0, 65536), file.substr(0, 65536));
+    EXPECT_EQ(sink.content.find_first_not_of('\0', 65536), std::string::npos);
+    // a range ignored by the server is not asked for again
+    EXPECT_LE(server.getRequestCount(), 4);
+}
+
+TEST(RangedDownloader, TestRetries)
+{
+    std::string file = makeFile(300000);
+    std::mutex mtx;
+    std::set<std::string> failedRanges;
+    TestHttpServer server([&](const TestHttpRequest& request) {
+        // every range past the probe fails once with an error page that must not end up in the file
+        std::string range = request.headers.at("range");
+        std::lock_guard lock(mtx);
+        if (range.rfind("bytes=0-", 0) != 0 && failedRanges.insert(range).second)
+        {
+            TestHttpResponse response;
+            response.status = 503;
+            response.body = std::string(1000, '!');
+            return response;
+        }
+        return serveRange(file, request);
+    });
+
+    StringSink failed;
+    HttpResponse response = RangedDownloader(makePolicy(65536, 0)).download(server.getUrl() + "/track", failed.get());
+    EXPECT_EQ(response.status_code, 503);
+
+    failedRanges.clear();
+    StringSink sink;
+    response = RangedDownloader(makePolicy(65536, 1)).download(server.getUrl() + "/track", sink.get());
+    EXPECT_EQ(response.status_code, 200);
+    EXPECT_EQ(sink.content, file);
+}
+
+TEST(RangedDownloader, TestThroughputFloor)
+{
+    std::string file = makeFile(100000);
+    TestHttpServer server([&file](const TestHttpRequest& request) {
+        TestHttpResponse response = serveRange(file, request);
+        response.delay = std::chrono::milliseconds(500);
+        return response;
+    });
+
+    DownloadPolicy policy = makePolicy(10000, 0);
+    policy.minThroughput = 1024 * 1024;
+    policy.throughputGrace = std::chrono::milliseconds(100);
+
+    StringSink sink;
+    auto start = std::chrono::steady_clock::now();
+    HttpResponse response = RangedDownloader(policy).download(server.getUrl() + "/track", sink.get());
+    EXPECT_EQ(response.status_code, 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(450));
+
+    policy.minThroughput = 0;
+    policy.deadline = std::chrono::milliseconds(200);
+    response = RangedDownloader(policy).download(server.getUrl() + "/track", sink.get());
+    EXPECT_EQ(response.status_code, 0);
+}
@@ -39,4 +39,69 @@ TEST(SafeQueue, TestParallel)
         }, true);
     }
     EXPECT_EQ(queue.getCurrentSize(), offset);
-}
\ No newline at end of file
+}
+
+TEST(SafePriorityQueue, TestStrictOrder)
+{
+    siren::cloud::SchedulingPolicy policy;
+    policy.mode = siren::cloud::SchedulingPolicy::Mode::Strict;
+    policy.starvationThreshold = std::chrono::milliseconds(0);
+
+    siren::cloud::SafePriorityQueue<siren::cloud::Task> queue{0, policy};
+    std::vector<int> order;
+    queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{order.push_back(2);}, 0}, siren::cloud::TaskPriority::Maintenance});
+    queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{order.push_back(1);}, 0}, siren::cloud::TaskPriority::Background});
+    queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{order.push_back(0);}, 0}, siren::cloud::TaskPriority::Interactive});
+
+    EXPECT_EQ(queue.getCurrentSize(), 3);
+    EXPECT_EQ(queue.getCurrentSize(siren::cloud::TaskPriority::Background), 1);
+
+    siren::cloud::Task task;
+    while (!queue.isEmpty())
+    {
+        ASSERT_TRUE(queue.pop(task));
+        task();
+    }
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+}
+
+TEST(SafePriorityQueue, TestWeightedFair)
+{
+    siren::cloud::SchedulingPolicy policy;
+    policy.weights = {3, 1, 1};
+    policy.starvationThreshold = std::chrono::milliseconds(0);
+
+    siren::cloud::SafePriorityQueue<siren::cloud::Task> queue{0, policy};
+    std::vector<int> order;
+    for (int i = 0; i < 6; i++)
+    {
+        queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{order.push_back(0);}, 0}, siren::cloud::TaskPriority::Interactive});
+        queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{order.push_back(1);}, 0}, siren::cloud::TaskPriority::Background});
+    }
+
+    siren::cloud::Task task;
+    for (int i = 0; i < 8; i++)
+    {
+        ASSERT_TRUE(queue.pop(task));
+        task();
+    }
+    EXPECT_EQ(order, (std::vector<int>{0, 0, 0, 1, 0, 0, 0, 1}));
+}
+
+TEST(SafePriorityQueue, TestStarvationProtection)
+{
+    siren::cloud::SchedulingPolicy policy;
+    policy.mode = siren::cloud::SchedulingPolicy::Mode::Strict;
+    policy.starvationThreshold = std::chrono::milliseconds(20);
+
+    siren::cloud::SafePriorityQueue<siren::cloud::Task> queue{0, policy};
+    int lastServed = -1;
+    queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{lastServed = 2;}, 0}, siren::cloud::TaskPriority::Maintenance});
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    queue.push(siren::cloud::Task{siren::cloud::CallBack{[&]{lastServed = 0;}, 0}, siren::cloud::TaskPriority::Interactive});
+
+    siren::cloud::Task task;
+    ASSERT_TRUE(queue.pop(task));
+    task();
+    EXPECT_EQ(lastServed, 2);
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include "../src/ingestion/siren_core_pool.h"
+
+using siren::cloud::SirenCorePool;
+using siren::cloud::SirenCorePtr;
+
+static SirenCorePtr makeCore()
+{
+    return std::make_shared<siren::SirenCore>(siren::CoreSpecification{});
+}
+
+TEST(SirenCorePool, TestLease)
+{
+    SirenCorePool pool(makeCore, 2);
+    EXPECT_EQ(pool.getSize(), 2);
+    {
+        SirenCorePool::Lease first = pool.acquire();
+        SirenCorePool::Lease second = pool.acquire();
+        // no two workers share a core
+        EXPECT_NE(&*first, &*second);
+        EXPECT_EQ(pool.getIdleCount(), 0);
+    }
+    EXPECT_EQ(pool.getIdleCount(), 2);
+
+    // the core returned last is handed out first
+    siren::SirenCore* returned;
+    {
+        SirenCorePool::Lease lease = pool.acquire();
+        returned = &*lease;
+    }
+    EXPECT_EQ(&*pool.acquire(), returned);
+}
+
+TEST(SirenCorePool, TestWaitsForFreeCore)
+{
+    SirenCorePool pool(makeCore, 1);
+    std::atomic<bool> isAcquired{false};
+    std::thread waiter;
+    {
+        SirenCorePool::Lease lease = pool.acquire();
+        waiter = std::thread([&pool, &isAcquired] {
+            SirenCorePool::Lease other = pool.acquire();
+            isAcquired = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_FALSE(isAcquired);
+    }
+    waiter.join();
+    EXPECT_TRUE(isAcquired);
+    EXPECT_EQ(pool.getIdleCount(), 1);
+}
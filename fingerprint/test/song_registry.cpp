@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "common.h"
+#include "../src/engine/song_registry.h"
+#include "../src/storage/postgres/postgres_connector.h"
+
+using siren::cloud::SongRegistry;
+using siren::cloud::SongRegistryPolicy;
+using siren::cloud::SongState;
+
+static siren::cloud::DBConnectionPoolPtr initRegistryPool()
+{
+    auto postgresConnector = std::make_shared<siren::cloud::postgres::PostgresConnector>(initPostgresConnStr());
+    auto connectionPool = std::make_shared<siren::cloud::DBConnectionPool>(postgresConnector, 2);
+
+    Query tableQuery;
+    tableQuery.emplace("query", "CREATE TABLE IF NOT EXISTS song_registry(song_id BIGINT PRIMARY KEY, state SMALLINT NOT NULL,"
+                                " updated_at TIMESTAMPTZ NOT NULL DEFAULT now());");
+    Query cleanUpQuery;
+    cleanUpQuery.emplace("query", "DELETE FROM song_registry WHERE song_id >= 900000000;");
+
+    auto connection = connectionPool->getConnection();
+    EXPECT_TRUE(connection->createCommand(std::move(tableQuery))->execute());
+    EXPECT_TRUE(connection->createCommand(std::move(cleanUpQuery))->execute());
+    connectionPool->releaseConnection(std::move(connection));
+    return connectionPool;
+}
+
+TEST(SongRegistry, TestLifecycle)
+{
+    auto connectionPool = initRegistryPool();
+    SongRegistry registry(connectionPool);
+    SongRegistry otherRegistry(connectionPool);
+
+    bool isClaimed = false;
+    ASSERT_TRUE(registry.claim(isClaimed, 900000001));
+    EXPECT_TRUE(isClaimed);
+    EXPECT_EQ(registry.getMirroredState(900000001), SongState::Claimed);
+
+    // the second claim is turned down by the mirror, the one from another process by the table
+    ASSERT_TRUE(registry.claim(isClaimed, 900000001));
+    EXPECT_FALSE(isClaimed);
+    ASSERT_TRUE(otherRegistry.claim(isClaimed, 900000001));
+    EXPECT_FALSE(isClaimed);
+
+    EXPECT_TRUE(registry.advance(900000001, SongState::Claimed, SongState::Loading));
+    EXPECT_FALSE(registry.advance(900000001, SongState::Claimed, SongState::Loading));
+    EXPECT_TRUE(registry.advance(900000001, SongState::Loading, SongState::Ready));
+
+    EXPECT_TRUE(registry.markDeleting(900000001));
+    EXPECT_TRUE(registry.release(900000001));
+    EXPECT_FALSE(registry.getMirroredState(900000001));
+    ASSERT_TRUE(otherRegistry.claim(isClaimed, 900000001));
+    EXPECT_TRUE(isClaimed);
+}
+
+TEST(SongRegistry, TestAbandonedClaim)
+{
+    auto connectionPool = initRegistryPool();
+    SongRegistry registry(connectionPool);
+
+    SongRegistryPolicy policy;
+    policy.claimTimeout = std::chrono::milliseconds(0);
+    SongRegistry impatientRegistry(connectionPool, policy);
+
+    bool isClaimed = false;
+    ASSERT_TRUE(registry.claim(isClaimed, 900000002));
+    EXPECT_TRUE(isClaimed);
+
+    // a load that has stalled for longer than the timeout no longer holds the id
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_TRUE(impatientRegistry.claim(isClaimed, 900000002));
+    EXPECT_TRUE(isClaimed);
+
+    // a finished song is never taken over
+    EXPECT_TRUE(impatientRegistry.advance(900000002, SongState::Claimed, SongState::Ready));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    SongRegistry laterRegistry(connectionPool, policy);
+    ASSERT_TRUE(laterRegistry.claim(isClaimed, 900000002));
+    EXPECT_FALSE(isClaimed);
+
+    EXPECT_TRUE(impatientRegistry.release(900000002));
+}
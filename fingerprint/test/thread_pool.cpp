@@ -1,4 +1,6 @@
 #include "../src/thread_pool/async_manager.h"
+#include "../src/thread_pool/primitives/cancellation.h"
+#include "../src/thread_pool/coro/task.h"
 #include <gtest/gtest.h>
 #include <cmath>
 #include <numeric>
@@ -79,4 +81,224 @@ TEST(AsyncManager, TestWait)
         futures.emplace_back(siren::cloud::AsyncManager::instance().submitTask(job, true));
     }
     std::cout << "waiting for completion" << std::endl;
-}
\ No newline at end of file
+}
+TEST(Pool, TestPriorities)
+{
+    auto pool = std::make_shared<siren::cloud::ThreadPool>(1, 1, true);
+    std::mutex mtx;
+    std::vector<siren::cloud::TaskPriority> completed;
+    {
+        std::vector<siren::cloud::WaitableFuture> futures;
+        pool->pause();
+        for (int i = 0; i < 10; i++)
+        {
+            auto priority = i % 2 ? siren::cloud::TaskPriority::Background : siren::cloud::TaskPriority::Interactive;
+            futures.emplace_back(pool->submitTask([&, priority] {
+                std::lock_guard lock(mtx);
+                completed.push_back(priority);
+            }, priority, true));
+        }
+        pool->resume();
+    }
+    ASSERT_EQ(completed.size(), 10);
+    size_t interactiveCount = std::count(completed.begin(), completed.begin() + 5, siren::cloud::TaskPriority::Interactive);
+    EXPECT_GE(interactiveCount, 4);
+}
+
+TEST(Pool, TestBackpressure)
+{
+    siren::cloud::BackpressurePolicy backpressure;
+    backpressure.capacity = {1, 1, 1};
+    backpressure.overflow = {siren::cloud::OverflowPolicy::Reject, siren::cloud::OverflowPolicy::CallerRuns, siren::cloud::OverflowPolicy::BlockWithTimeout};
+    backpressure.blockTimeout = std::chrono::milliseconds(10);
+
+    auto pool = std::make_shared<siren::cloud::ThreadPool>(1, 1, true, siren::cloud::SchedulingPolicy{}, backpressure);
+    std::atomic<bool> release{false};
+    auto blocker = [&release] {
+        while (!release)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+
+    // occupies the only worker, then fills every level
+    auto running = pool->submitTask(blocker, true);
+    while (!pool->areAllThreadsBusy())
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(pool->submitTask([]{}, siren::cloud::TaskPriority::Interactive).valid());
+    EXPECT_TRUE(pool->submitTask([]{}, siren::cloud::TaskPriority::Background).valid());
+    EXPECT_TRUE(pool->submitTask([]{}, siren::cloud::TaskPriority::Maintenance).valid());
+
+    EXPECT_FALSE(pool->submitTask([]{}, siren::cloud::TaskPriority::Interactive).valid());
+
+    auto callerThreadId = std::this_thread::get_id();
+    std::thread::id executorId;
+    EXPECT_TRUE(pool->submitTask([&executorId]{ executorId = std::this_thread::get_id(); }, siren::cloud::TaskPriority::Background).valid());
+    EXPECT_EQ(executorId, callerThreadId);
+
+    EXPECT_FALSE(pool->submitTask([]{}, siren::cloud::TaskPriority::Maintenance).valid());
+
+    auto stats = pool->getStats();
+    EXPECT_EQ(stats.queueDepth, 3);
+    EXPECT_EQ(stats.rejectedCount, 2);
+    EXPECT_EQ(stats.timedOutCount, 1);
+    EXPECT_EQ(stats.callerRunsCount, 1);
+
+    // post never runs the task on the caller, a full queue rejects it
+    bool isRun = false;
+    EXPECT_FALSE(pool->post([&isRun] { isRun = true; }, siren::cloud::TaskPriority::Background));
+    EXPECT_FALSE(isRun);
+    stats = pool->getStats();
+    EXPECT_EQ(stats.rejectedCount, 3);
+    EXPECT_EQ(stats.callerRunsCount, 1);
+
+    release = true;
+}
+
+TEST(Pool, TestDroppedTimers)
+{
+    siren::cloud::SchedulingPolicy policy;
+    policy.timerResolution = std::chrono::milliseconds(1);
+    siren::cloud::BackpressurePolicy backpressure;
+    backpressure.capacity = {1, 1, 1};
+    backpressure.overflow = {siren::cloud::OverflowPolicy::BlockWithTimeout, siren::cloud::OverflowPolicy::CallerRuns, siren::cloud::OverflowPolicy::CallerRuns};
+    backpressure.blockTimeout = std::chrono::milliseconds(5000);
+
+    auto pool = std::make_shared<siren::cloud::ThreadPool>(1, 1, true, policy, backpressure);
+    std::atomic<bool> release{false};
+    auto running = pool->submitTask([&release] {
+        while (!release)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    while (!pool->areAllThreadsBusy())
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(pool->submitTask([]{}, siren::cloud::TaskPriority::Interactive).valid());
+    EXPECT_TRUE(pool->submitTask([]{}, siren::cloud::TaskPriority::Background).valid());
+
+    // due timers facing a full queue are dropped at once, neither blocking the timer thread nor running on it
+    std::atomic<bool> isRunInline{false};
+    auto start = std::chrono::steady_clock::now();
+    pool->submitAfter(std::chrono::milliseconds(1), [] {}, siren::cloud::TaskPriority::Interactive);
+    pool->submitAfter(std::chrono::milliseconds(2), [&] { isRunInline = true; }, siren::cloud::TaskPriority::Background);
+    while (pool->getStats().droppedTimerCount < 2 && std::chrono::steady_clock::now() - start < std::chrono::seconds(3))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    auto stats = pool->getStats();
+    EXPECT_EQ(stats.droppedTimerCount, 2);
+    EXPECT_EQ(stats.callerRunsCount, 0);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_FALSE(isRunInline);
+
+    // a coroutine whose delayed resume is dropped still completes, on the worker once it is free rather than lost
+    auto delayed = [](siren::cloud::ThreadPool* pool) -> siren::cloud::coro::Task<std::thread::id> {
+        co_await pool->scheduleAfter(std::chrono::milliseconds(1), siren::cloud::TaskPriority::Interactive);
+        co_return std::this_thread::get_id();
+    };
+    std::thread::id waiterId, resumedId;
+    std::thread waiter([&] {
+        waiterId = std::this_thread::get_id();
+        resumedId = siren::cloud::coro::syncWait(delayed(pool.get()));
+    });
+    while (pool->getStats().droppedTimerCount < 3 && std::chrono::steady_clock::now() - start < std::chrono::seconds(3))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(pool->getStats().droppedTimerCount, 3);
+
+    release = true;
+    waiter.join();
+    EXPECT_NE(resumedId, waiterId);
+    EXPECT_NE(resumedId, std::this_thread::get_id());
+}
+
+TEST(Pool, TestDelayedTasks)
+{
+    siren::cloud::SchedulingPolicy policy;
+    policy.timerResolution = std::chrono::milliseconds(1);
+    auto pool = std::make_shared<siren::cloud::ThreadPool>(1, 2, true, policy);
+
+    using Clock = std::chrono::steady_clock;
+    std::atomic<bool> isFired{false};
+    std::atomic<bool> isCancelledFired{false};
+    std::atomic<int64_t> firedAfterMs{0};
+
+    auto start = Clock::now();
+    pool->submitAfter(std::chrono::milliseconds(50), [&] {
+        firedAfterMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        isFired = true;
+    }, siren::cloud::TaskPriority::Background);
+    auto cancelled = pool->submitAfter(std::chrono::milliseconds(20), [&] { isCancelledFired = true; });
+    cancelled.cancel();
+
+    // lands on the second level of the wheel and has to be cascaded down
+    std::atomic<bool> isLateFired{false};
+    pool->submitAt(start + std::chrono::milliseconds(300), [&] { isLateFired = true; });
+
+    std::atomic<size_t> ticks{0};
+    auto periodic = pool->submitEvery(std::chrono::milliseconds(10), [&] { ticks++; });
+
+    while (!isLateFired && Clock::now() - start < std::chrono::seconds(5))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    periodic.cancel();
+    size_t ticksAtCancel = ticks;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    EXPECT_TRUE(isFired);
+    EXPECT_GE(firedAfterMs, 50);
+    EXPECT_TRUE(isLateFired);
+    EXPECT_FALSE(isCancelledFired);
+    EXPECT_TRUE(cancelled.isCancelled());
+    EXPECT_GE(ticksAtCancel, 5);
+    EXPECT_LE(ticks, ticksAtCancel + 1);
+}
+
+TEST(Pool, TestCancellationToken)
+{
+    using siren::cloud::CancellationToken;
+
+    CancellationToken never;
+    never.cancel();
+    EXPECT_FALSE(never.isCancellable());
+    EXPECT_FALSE(never.isCancelled());
+    EXPECT_EQ(never.getRemaining(std::chrono::milliseconds(42)), std::chrono::milliseconds(42));
+
+    auto token = CancellationToken::create();
+    auto copy = token;
+    EXPECT_FALSE(copy.isCancelled());
+    token.cancel();
+    EXPECT_TRUE(copy.isCancelled());
+
+    auto timed = CancellationToken::create(CancellationToken::Clock::now() + std::chrono::milliseconds(30));
+    EXPECT_TRUE(timed.hasDeadline());
+    EXPECT_FALSE(timed.isCancelled());
+    EXPECT_LE(timed.getRemaining({}), std::chrono::milliseconds(30));
+
+    // a looser deadline must not extend the one already set
+    timed.setDeadline(CancellationToken::Clock::now() + std::chrono::seconds(10));
+    EXPECT_LE(timed.getRemaining({}), std::chrono::milliseconds(30));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_TRUE(timed.isCancelled());
+    EXPECT_EQ(timed.getRemaining({}), std::chrono::milliseconds(0));
+
+    auto parent = CancellationToken::create(CancellationToken::Clock::now() + std::chrono::seconds(10));
+    auto child = parent.createChild();
+    EXPECT_TRUE(child.hasDeadline());
+    child.cancel();
+    EXPECT_TRUE(child.isCancelled());
+    EXPECT_FALSE(parent.isCancelled());
+
+    auto sibling = parent.createChild();
+    parent.cancel();
+    EXPECT_TRUE(sibling.isCancelled());
+}
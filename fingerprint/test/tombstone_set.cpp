@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include "../src/engine/tombstone_set.h"
+
+using siren::cloud::SongIdType;
+using siren::cloud::TombstoneSet;
+
+TEST(TombstoneSet, TestSnapshot)
+{
+    TombstoneSet tombstones;
+    tombstones.add(1);
+    TombstoneSet::Snapshot snapshot = tombstones.getSnapshot();
+
+    // a lookup keeps the set it started with while deletes go on
+    tombstones.add(2);
+    tombstones.remove(1);
+    EXPECT_TRUE(snapshot->contains(1));
+    EXPECT_FALSE(snapshot->contains(2));
+    EXPECT_FALSE(tombstones.contains(1));
+    EXPECT_TRUE(tombstones.contains(2));
+}
+
+TEST(TombstoneSet, TestRefresh)
+{
+    TombstoneSet tombstones;
+    tombstones.add(1);
+    tombstones.add(2);
+
+    // song 2 was compacted by another process, song 3 was deleted by one, song 4 is deleted while the registry is read
+    uint64_t generation = tombstones.beginRefresh();
+    tombstones.add(4);
+    tombstones.completeRefresh(generation, std::unordered_set<SongIdType>{1, 3});
+    EXPECT_TRUE(tombstones.contains(1));
+    EXPECT_FALSE(tombstones.contains(2));
+    EXPECT_TRUE(tombstones.contains(3));
+    EXPECT_TRUE(tombstones.contains(4));
+
+    // once the registry has been read after the delete it alone decides
+    generation = tombstones.beginRefresh();
+    tombstones.completeRefresh(generation, std::unordered_set<SongIdType>{1});
+    EXPECT_EQ(*tombstones.getSnapshot(), std::unordered_set<SongIdType>{1});
+}
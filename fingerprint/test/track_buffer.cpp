@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iterator>
+#include "../src/ingestion/track_buffer.h"
+
+using siren::cloud::TrackBuffer;
+
+static std::string readAll(const std::string& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+TEST(TrackBuffer, TestReadBackByPath)
+{
+    TrackBuffer track;
+    ASSERT_TRUE(track.open("track"));
+    ASSERT_TRUE(track.append("RIFF"));
+    ASSERT_TRUE(track.append(std::string(1 << 16, 'x')));
+    EXPECT_EQ(track.getSize(), 4 + (1 << 16));
+
+    // the core opens the path itself and must see every chunk appended so far
+    std::string content = readAll(track.getPath());
+    EXPECT_EQ(content.size(), track.getSize());
+    EXPECT_EQ(content.substr(0, 4), "RIFF");
+}
+
+TEST(TrackBuffer, TestClose)
+{
+    TrackBuffer track;
+    ASSERT_TRUE(track.open("track"));
+    ASSERT_TRUE(track.append("data"));
+    std::string path = track.getPath();
+
+    TrackBuffer moved = std::move(track);
+    EXPECT_FALSE(track.isOpen());
+    EXPECT_EQ(readAll(moved.getPath()), "data");
+
+    // nothing outlives the buffer
+    moved.close();
+    EXPECT_FALSE(moved.isOpen());
+    EXPECT_FALSE(std::ifstream(path).is_open());
+}
+
+TEST(TrackBuffer, TestWriteAt)
+{
+    TrackBuffer track;
+    ASSERT_TRUE(track.open("track"));
+    ASSERT_TRUE(track.reserve(8));
+    EXPECT_EQ(track.getSize(), 8);
+
+    // ranges land wherever they belong, whatever order they arrive in
+    ASSERT_TRUE(track.writeAt(4, "5678"));
+    ASSERT_TRUE(track.writeAt(0, "1234"));
+    EXPECT_EQ(readAll(track.getPath()), "12345678");
+    EXPECT_EQ(track.getSize(), 8);
+}
@@ -2,6 +2,9 @@ defmodule FingerprintComm do
 
   def fingerprint_addr, do: Enum.join(["http://", System.get_env("FINGERPRINT_ADDRESS"), ":", System.get_env("GRPC_PROXY_PORT")], "")
   def expected_response, do: "{\"success\":true}"
+  # a queued load is polled for this long before it is given up on
+  def load_poll_interval_ms, do: 1_000
+  def load_poll_attempts, do: 180
 
   def post_record(id, audio_url, is_caching) do
     url = Enum.join([FingerprintComm.fingerprint_addr, "/v1/loadTrack"], "")
@@ -13,8 +16,34 @@ defmodule FingerprintComm do
     headers = [{"Content-type", "application/json"}]
     HTTPoison.post(url, body, headers, timeout: 180_000, recv_timeout: 180_000)
     |> case do
+      # the load is only queued here, it has succeeded once its job is done
       {:ok, res} ->
-        Map.get(res, :body) == FingerprintComm.expected_response
+        case Jason.decode(Map.get(res, :body)) do
+          {:ok, %{"success" => true, "job_id" => job_id}} -> await_load(job_id, FingerprintComm.load_poll_attempts)
+          _ -> false
+        end
+      {:error, _} ->
+        false
+    end
+  end
+
+  def await_load(_job_id, 0), do: false
+
+  def await_load(job_id, attempts_left) do
+    url = Enum.join([FingerprintComm.fingerprint_addr, "/v1/loadJob/", to_string(job_id)], "")
+    HTTPoison.get(url, [], timeout: 180_000, recv_timeout: 180_000)
+    |> case do
+      {:ok, res} ->
+        case Jason.decode(Map.get(res, :body)) do
+          {:ok, %{"state" => "LOAD_JOB_STATE_DONE"}} ->
+            true
+          {:ok, %{"state" => state}} when state in ["LOAD_JOB_STATE_QUEUED", "LOAD_JOB_STATE_DOWNLOADING", "LOAD_JOB_STATE_FINGERPRINTING", "LOAD_JOB_STATE_STORING"] ->
+            Process.sleep(FingerprintComm.load_poll_interval_ms)
+            await_load(job_id, attempts_left - 1)
+          # failed, or finished so long ago that its status is gone
+          _ ->
+            false
+        end
       {:error, _} ->
         false
     end